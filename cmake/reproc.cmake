@@ -8,6 +8,7 @@ include(GNUInstallDirs)
 option(REPROC_DEVELOP "Enable all developer options" $ENV{REPROC_DEVELOP})
 option(REPROC_TEST "Build tests" ${REPROC_DEVELOP})
 option(REPROC_EXAMPLES "Build examples" ${REPROC_DEVELOP})
+option(REPROC_BENCHMARKS "Build benchmarks" ${REPROC_DEVELOP})
 option(REPROC_WARNINGS "Enable compiler warnings" ${REPROC_DEVELOP})
 option(REPROC_TIDY "Run clang-tidy when building" ${REPROC_DEVELOP})
 
@@ -363,3 +364,20 @@ function(reproc_example TARGET NAME LANGUAGE)
   reproc_common(${TARGET}-example-${NAME} ${LANGUAGE} ${NAME} examples)
   target_link_libraries(${TARGET}-example-${NAME} PRIVATE ${TARGET} ${ARGN})
 endfunction()
+
+function(reproc_benchmark TARGET NAME LANGUAGE)
+  if(NOT REPROC_BENCHMARKS)
+    return()
+  endif()
+
+  if(LANGUAGE STREQUAL C)
+    set(EXTENSION c)
+  else()
+    set(EXTENSION cpp)
+  endif()
+
+  add_executable(${TARGET}-benchmark-${NAME} benchmarks/${NAME}.${EXTENSION})
+
+  reproc_common(${TARGET}-benchmark-${NAME} ${LANGUAGE} ${NAME} benchmarks)
+  target_link_libraries(${TARGET}-benchmark-${NAME} PRIVATE ${TARGET} ${ARGN})
+endfunction()
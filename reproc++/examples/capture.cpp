@@ -0,0 +1,52 @@
+#include <reproc++/reproc.hpp>
+
+#include <iostream>
+
+static int fail(std::error_code ec)
+{
+  std::cerr << ec.message();
+  return ec.value();
+}
+
+// Runs a command, waits for it to exit and prints how many lines it wrote to
+// stdout. The output goes straight to memory instead of through a pipe.
+int main(int argc, const char *argv[])
+{
+  if (argc <= 1) {
+    std::cerr << "No arguments provided. Example usage: "
+              << "./capture cmake --help";
+    return 1;
+  }
+
+  reproc::process process;
+
+  reproc::options options;
+  options.redirect.out.type = reproc::redirect::memfd;
+
+  std::error_code ec = process.start(argv + 1, options);
+  if (ec) {
+    return fail(ec);
+  }
+
+  int status = 0;
+  std::tie(status, ec) = process.wait(reproc::infinite);
+  if (ec) {
+    return fail(ec);
+  }
+
+  reproc::view output;
+  std::tie(output, ec) = process.capture(reproc::stream::out);
+  if (ec) {
+    return fail(ec);
+  }
+
+  size_t lines = 0;
+
+  for (uint8_t byte : output) {
+    lines += byte == '\n';
+  }
+
+  std::cout << output.size() << " bytes, " << lines << " lines" << std::endl;
+
+  return status;
+}
@@ -0,0 +1,117 @@
+#include <reproc++/reproc.hpp>
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int fail(std::error_code ec)
+{
+  std::cerr << ec.message();
+  return 1;
+}
+
+// Runs the given commands at the same time and lets the poller read their
+// output for us. Output is printed as soon as it arrives, prefixed with the
+// index of the command that wrote it, followed by the exit status of each
+// command. Commands are separated by a "," argument.
+//
+// Example: "./complete cmake --help , cmake --version" will print the output of
+// both commands interleaved.
+int main(int argc, const char *argv[])
+{
+  if (argc <= 1) {
+    std::cerr << "No arguments provided. Example usage: "
+              << "./complete cmake --help , cmake --version";
+    return 1;
+  }
+
+  std::vector<std::vector<std::string>> commands(1);
+
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == ",") {
+      commands.emplace_back();
+    } else {
+      commands.back().emplace_back(argv[i]);
+    }
+  }
+
+  std::vector<reproc::process> processes(commands.size());
+  std::vector<size_t> indices(commands.size());
+  reproc::poller poller;
+  std::error_code ec;
+
+  // stderr goes to our stderr unless we ask for a pipe.
+  reproc::options options;
+  options.redirect.err.type = reproc::redirect::pipe;
+
+  for (size_t i = 0; i < commands.size(); i++) {
+    ec = processes[i].start(commands[i], options);
+    if (ec) {
+      return fail(ec);
+    }
+
+    ec = processes[i].close(reproc::stream::in);
+    if (ec) {
+      return fail(ec);
+    }
+
+    indices[i] = i;
+    ec = poller.add(processes[i],
+                    reproc::event::out | reproc::event::err |
+                        reproc::event::exit,
+                    &indices[i]);
+    if (ec) {
+      return fail(ec);
+    }
+  }
+
+  int status = 0;
+
+  // Instead of reporting that output is available, `complete` reports the
+  // output itself. On Linux, the reads are done by io_uring if available.
+  while (true) {
+    std::array<reproc::poller::completion, 16> completions = {};
+    size_t count = 0;
+
+    std::tie(count, ec) = poller.complete(completions.data(),
+                                          completions.size());
+    if (ec == reproc::error::broken_pipe) {
+      break;
+    }
+
+    if (ec) {
+      return fail(ec);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      const reproc::poller::completion &completion = completions[i];
+      size_t index = *static_cast<size_t *>(completion.context);
+
+      // The poller stops reading from a stream once it is closed.
+      if (completion.error == reproc::error::broken_pipe) {
+        continue;
+      }
+
+      if (completion.error) {
+        return fail(completion.error);
+      }
+
+      if (completion.events == reproc::event::exit) {
+        std::cout << "[" << index << "] exited with " << completion.result
+                  << std::endl;
+        status = status == 0 ? completion.result : status;
+        continue;
+      }
+
+      std::ostream &os = completion.events == reproc::event::out ? std::cout
+                                                                 : std::cerr;
+      os << "[" << index << "] ";
+      os.write(reinterpret_cast<const char *>(completion.data),
+               static_cast<std::streamsize>(completion.result));
+      os << std::flush;
+    }
+  }
+
+  return status;
+}
@@ -0,0 +1,158 @@
+#include <reproc++/reproc.hpp>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <iostream>
+
+static int fail(std::error_code ec)
+{
+  std::cerr << ec.message();
+  return 1;
+}
+
+// Reads from `stream` until the pipe is drained. An edge-triggered epoll
+// instance only notifies us again once new output arrives so we can't stop
+// before `read` reports `would_block`.
+static std::error_code read_all(reproc::process &process, reproc::stream stream)
+{
+  while (true) {
+    std::array<uint8_t, 4096> buffer = {};
+    size_t size = 0;
+    std::error_code ec;
+
+    std::tie(size, ec) = process.read(stream, buffer.data(), buffer.size());
+    if (ec) {
+      return ec;
+    }
+
+    std::ostream &os = stream == reproc::stream::out ? std::cout : std::cerr;
+    os.write(reinterpret_cast<const char *>(buffer.data()),
+             static_cast<std::streamsize>(size));
+    os << std::flush;
+  }
+}
+
+// Runs the given command and forwards its output from an edge-triggered epoll
+// event loop that we manage ourselves instead of `reproc::process::poll`. The
+// same approach works for libuv, asio or any other event loop that accepts
+// native handles.
+//
+// Example: "./epoll cmake --help" will print CMake's help output.
+int main(int argc, const char *argv[])
+{
+  if (argc <= 1) {
+    std::cerr << "No arguments provided. Example usage: ./epoll cmake --help";
+    return 1;
+  }
+
+  reproc::process process;
+
+  // Edge-triggered notifications require nonblocking pipes.
+  reproc::options options;
+  options.nonblocking = true;
+
+  std::error_code ec = process.start(argv + 1, options);
+  if (ec == std::errc::no_such_file_or_directory) {
+    std::cerr << "Program not found. Make sure it's available from the PATH.";
+    return 1;
+  } else if (ec) {
+    return fail(ec);
+  }
+
+  ec = process.close(reproc::stream::in);
+  if (ec) {
+    return fail(ec);
+  }
+
+  int epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll < 0) {
+    return fail({ errno, std::system_category() });
+  }
+
+  std::array<reproc::stream, 3> streams = { reproc::stream::out,
+                                            reproc::stream::err,
+                                            reproc::stream::exit };
+  int registered = 0;
+
+  for (size_t i = 0; i < streams.size(); i++) {
+    reproc::handle handle = {};
+    std::tie(handle, ec) = process.handle_of(streams[i]);
+    // The exit handle isn't available when the reaper is used.
+    if (ec == reproc::error::broken_pipe) {
+      continue;
+    }
+
+    if (ec) {
+      return fail(ec);
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLET;
+    event.data.u64 = i;
+
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, handle, &event) < 0) {
+      return fail({ errno, std::system_category() });
+    }
+
+    registered++;
+  }
+
+  while (registered > 0) {
+    std::array<epoll_event, 3> events = {};
+
+    int count = epoll_wait(epoll, events.data(), events.size(), -1);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (count < 0) {
+      return fail({ errno, std::system_category() });
+    }
+
+    for (size_t i = 0; i < static_cast<size_t>(count); i++) {
+      reproc::stream stream = streams[events[i].data.u64];
+
+      if (stream == reproc::stream::exit) {
+        reproc::handle handle = {};
+        std::tie(handle, ec) = process.handle_of(stream);
+        if (ec) {
+          return fail(ec);
+        }
+
+        // `process::wait` closes the exit handle so we stop watching it first.
+        if (epoll_ctl(epoll, EPOLL_CTL_DEL, handle, nullptr) < 0) {
+          return fail({ errno, std::system_category() });
+        }
+
+        registered--;
+        continue;
+      }
+
+      ec = read_all(process, stream);
+      if (ec == reproc::error::resource_unavailable_try_again) {
+        continue;
+      }
+
+      // `read` closes the pipe once it reaches the end of the output, which
+      // also removes it from the epoll instance.
+      if (ec != reproc::error::broken_pipe) {
+        return fail(ec);
+      }
+
+      registered--;
+    }
+  }
+
+  close(epoll);
+
+  int status = 0;
+  std::tie(status, ec) = process.wait(reproc::infinite);
+  if (ec) {
+    return fail(ec);
+  }
+
+  return status;
+}
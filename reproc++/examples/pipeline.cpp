@@ -0,0 +1,73 @@
+#include <reproc++/drain.hpp>
+#include <reproc++/reproc.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int fail(std::error_code ec)
+{
+  std::cerr << ec.message();
+  return 1;
+}
+
+// Runs the given commands as a pipeline and prints the output of the last
+// command. Commands are separated by a "|" argument (which has to be quoted to
+// keep the shell from interpreting it).
+//
+// Example: "./pipeline cmake --help '|' grep Generators" will print the line of
+// CMake's help output that contains "Generators".
+int main(int argc, const char *argv[])
+{
+  if (argc <= 1) {
+    std::cerr << "No arguments provided. Example usage: "
+              << "./pipeline cmake --help '|' grep Generators";
+    return 1;
+  }
+
+  std::vector<std::vector<std::string>> commands(1);
+
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "|") {
+      commands.emplace_back();
+    } else {
+      commands.back().emplace_back(argv[i]);
+    }
+  }
+
+  std::vector<reproc::arguments> arguments;
+
+  for (const auto &command : commands) {
+    arguments.emplace_back(command);
+  }
+
+  reproc::pipeline pipeline(arguments.size());
+
+  // The stdout of each command is connected directly to the stdin of the next
+  // command so the output of intermediate commands never passes through this
+  // process. We only read the output of the last command. The stdin of the
+  // first command is inherited so it can read from our stdin.
+  reproc::options options;
+  options.redirect.in.type = reproc::redirect::parent;
+
+  std::error_code ec = pipeline.start(arguments, options);
+  if (ec) {
+    return fail(ec);
+  }
+
+  // stderr isn't redirected to a pipe so the sink only receives stdout.
+  reproc::sink::ostream sink(std::cout);
+  ec = reproc::drain(pipeline[pipeline.size() - 1], sink, sink);
+  if (ec) {
+    return fail(ec);
+  }
+
+  std::vector<int> statuses;
+  std::tie(statuses, ec) = pipeline.wait(reproc::infinite);
+  if (ec) {
+    return fail(ec);
+  }
+
+  // Like a shell, we exit with the exit status of the last command.
+  return statuses.back();
+}
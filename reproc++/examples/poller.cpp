@@ -0,0 +1,119 @@
+#include <reproc++/reproc.hpp>
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int fail(std::error_code ec)
+{
+  std::cerr << ec.message();
+  return 1;
+}
+
+// Runs the given commands at the same time and prints their output as soon as
+// it arrives, prefixed with the index of the command that wrote it. Commands
+// are separated by a "," argument.
+//
+// Example: "./poller cmake --help , cmake --version" will print the output of
+// both commands interleaved.
+int main(int argc, const char *argv[])
+{
+  if (argc <= 1) {
+    std::cerr << "No arguments provided. Example usage: "
+              << "./poller cmake --help , cmake --version";
+    return 1;
+  }
+
+  std::vector<std::vector<std::string>> commands(1);
+
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == ",") {
+      commands.emplace_back();
+    } else {
+      commands.back().emplace_back(argv[i]);
+    }
+  }
+
+  std::vector<reproc::process> processes(commands.size());
+  std::vector<size_t> indices(commands.size());
+  reproc::poller poller;
+  std::error_code ec;
+
+  // Only stdout is polled so stderr goes straight to our stderr.
+  reproc::options options;
+  options.redirect.err.type = reproc::redirect::parent;
+
+  for (size_t i = 0; i < commands.size(); i++) {
+    ec = processes[i].start(commands[i], options);
+    if (ec) {
+      return fail(ec);
+    }
+
+    // None of the commands get any input.
+    ec = processes[i].close(reproc::stream::in);
+    if (ec) {
+      return fail(ec);
+    }
+
+    // The poller reports the context we pass here so we know which process
+    // the events belong to.
+    indices[i] = i;
+    ec = poller.add(processes[i], reproc::event::out, &indices[i]);
+    if (ec) {
+      return fail(ec);
+    }
+  }
+
+  // Each call to `wait` only reports the processes that have output available
+  // instead of making us check all of them.
+  while (true) {
+    std::array<reproc::poller::event, 16> events = {};
+    size_t count = 0;
+
+    std::tie(count, ec) = poller.wait(events.data(), events.size());
+    if (ec == reproc::error::broken_pipe) {
+      break;
+    }
+
+    if (ec) {
+      return fail(ec);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      size_t index = *static_cast<size_t *>(events[i].context);
+      std::array<uint8_t, 4096> buffer = {};
+      size_t size = 0;
+
+      std::tie(size, ec) = processes[index].read(reproc::stream::out,
+                                                 buffer.data(), buffer.size());
+      // The poller stops watching stdout once it is closed.
+      if (ec == reproc::error::broken_pipe) {
+        continue;
+      }
+
+      if (ec) {
+        return fail(ec);
+      }
+
+      std::cout << "[" << index << "] ";
+      std::cout.write(reinterpret_cast<const char *>(buffer.data()),
+                      static_cast<std::streamsize>(size));
+      std::cout << std::flush;
+    }
+  }
+
+  int status = 0;
+
+  for (reproc::process &process : processes) {
+    int r = 0;
+    std::tie(r, ec) = process.wait(reproc::infinite);
+    if (ec) {
+      return fail(ec);
+    }
+
+    status = status == 0 ? r : status;
+  }
+
+  return status;
+}
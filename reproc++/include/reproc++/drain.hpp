@@ -36,12 +36,21 @@ std::error_code drain(process &process, Out &&out, Err &&err)
     return ec;
   }
 
+  // Part of `options.input` might not have fit in the stdin pipe.
+  bool input = false;
+  std::tie(input, ec) = process.write_input();
+  if (ec) {
+    return ec;
+  }
+
   static constexpr size_t BUFFER_SIZE = 4096;
   uint8_t buffer[BUFFER_SIZE] = {};
 
   while (true) {
+    int interests = event::out | event::err | (input ? event::in : 0);
+
     int events = 0;
-    std::tie(events, ec) = process.poll(event::out | event::err, infinite);
+    std::tie(events, ec) = process.poll(interests, infinite);
     if (ec) {
       ec = ec == error::broken_pipe ? std::error_code() : ec;
       break;
@@ -52,6 +61,17 @@ std::error_code drain(process &process, Out &&out, Err &&err)
       break;
     }
 
+    if (events & event::in) {
+      std::tie(input, ec) = process.write_input();
+      if (ec) {
+        break;
+      }
+
+      if (!(events & (event::out | event::err))) {
+        continue;
+      }
+    }
+
     stream stream = events & event::out ? stream::out : stream::err;
 
     size_t bytes_read = 0;
@@ -121,6 +141,22 @@ public:
 
 constexpr discard null = discard();
 
+/*! Writes all output to the file descriptor (POSIX) or handle (Windows)
+`handle`. When passed as both the `out` and `err` sink, `drain` calls
+`reproc_drain_to_fd` which moves the output with `splice` on Linux instead of
+reading it into a buffer first. */
+class fd {
+  reproc::handle handle_;
+
+public:
+  explicit fd(reproc::handle handle) noexcept : handle_(handle) {}
+
+  reproc::handle handle() const noexcept
+  {
+    return handle_;
+  }
+};
+
 namespace thread_safe {
 
 /*! `sink::string` but locks the given mutex before invoking the sink. */
@@ -143,4 +179,10 @@ public:
 }
 
 }
+
+/*! `reproc_drain_to_fd`. Preferred over the `drain` template when both sinks
+are `sink::fd` instances. */
+REPROCXX_EXPORT std::error_code
+drain(process &process, sink::fd out, sink::fd err);
+
 }
@@ -8,13 +8,21 @@
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <initializer_list>
 #include <memory>
 #include <system_error>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
-// Forward declare `reproc_t` so we don't have to include reproc.h in the
+// Forward declare reproc's types so we don't have to include reproc.h in the
 // header.
 struct reproc_t;
+struct reproc_cache_t;
+struct reproc_command_t;
+struct reproc_poller_t;
+struct reproc_poller_event;
+struct reproc_completion;
 
 /*! The `reproc` namespace wraps all reproc++ declarations. `process` wraps
 reproc's API inside a C++ class. To avoid exposing reproc's API when using
@@ -61,11 +69,67 @@ using handle = int;
 #endif
 
 struct redirect {
-  enum type { pipe = 1, parent, discard };
+  enum type { pipe = 1, parent, discard, memfd = 7, socket };
 
   enum type type;
   reproc::handle handle;
   FILE *file;
+  size_t pipe_size;
+  bool adaptive;
+};
+
+/*! `reproc_extra_stream` */
+struct extra_stream {
+  int fd;
+  bool input;
+  struct redirect redirect;
+};
+
+/*! `fork`, `vfork` and `helper` map to `REPROC_SPAWN_FORK`,
+`REPROC_SPAWN_VFORK` and `REPROC_SPAWN_HELPER` respectively. */
+enum class spawn { fork = 1, vfork, helper };
+
+/*! `reproc_helper_start` */
+REPROCXX_EXPORT std::error_code helper_start() noexcept;
+
+/*! `reproc_helper_stop` */
+REPROCXX_EXPORT std::error_code helper_stop() noexcept;
+
+/*! `reproc_reaper_start` */
+REPROCXX_EXPORT std::error_code reaper_start() noexcept;
+
+/*! `reproc_reaper_stop` */
+REPROCXX_EXPORT std::error_code reaper_stop() noexcept;
+
+/*! `reproc_memfd_new` but returns a pair of (handle, error). */
+REPROCXX_EXPORT std::pair<handle, std::error_code>
+memfd_new(const uint8_t *data, size_t size) noexcept;
+
+class process;
+
+namespace sink {
+
+class fd;
+
+}
+
+/*! RAII wrapper around `reproc_cache_t`. Pass a pointer to a `cache` instance
+in `options` to cache the location of programs searched for in `PATH` across
+calls to `process::start`. */
+class cache {
+
+public:
+  REPROCXX_EXPORT cache();
+  REPROCXX_EXPORT ~cache() noexcept;
+
+  REPROCXX_EXPORT cache(cache &&other) noexcept;
+  REPROCXX_EXPORT cache &operator=(cache &&other) noexcept;
+
+private:
+  friend class process;
+  friend class pipeline;
+
+  std::unique_ptr<reproc_cache_t, void (*)(reproc_cache_t *)> cache_;
 };
 
 struct options {
@@ -89,7 +153,12 @@ struct options {
   /*! Implicitly converts from string literals to the pointer size pair expected
   by `reproc_start`. */
   class input input;
+  enum spawn spawn = {};
   bool nonblocking = false;
+  bool async = false;
+  class cache *cache = nullptr;
+  const extra_stream *extra_streams = nullptr;
+  size_t num_extra_streams = 0;
 
   /*! Make a shallow copy of `options`. */
   static options clone(const options &other)
@@ -103,14 +172,25 @@ struct options {
     clone.timeout = other.timeout;
     clone.deadline = other.deadline;
     clone.input = other.input;
+    clone.spawn = other.spawn;
+    clone.nonblocking = other.nonblocking;
+    clone.async = other.async;
+    clone.cache = other.cache;
+    clone.extra_streams = other.extra_streams;
+    clone.num_extra_streams = other.num_extra_streams;
 
     return clone;
   }
 };
 
-enum class stream { in, out, err };
+/*! `exit` is `REPROC_STREAM_EXIT`. */
+enum class stream { in, out, err, exit = 18 };
 
-class process;
+/*! `REPROC_STREAM_EXTRA` */
+constexpr stream extra(size_t index) noexcept
+{
+  return static_cast<stream>(3 + index);
+}
 
 namespace event {
 
@@ -119,9 +199,16 @@ enum {
   out = 1 << 1,
   err = 1 << 2,
   exit = 1 << 3,
-  deadline = 1 << 4
+  deadline = 1 << 4,
+  start = 1 << 5
 };
 
+/*! `REPROC_EVENT_EXTRA` */
+constexpr int extra(size_t index) noexcept
+{
+  return 1 << (16 + index);
+}
+
 struct source {
   class process &process;
   int interests;
@@ -134,8 +221,73 @@ REPROCXX_EXPORT std::error_code poll(event::source *sources,
                                      size_t num_sources,
                                      milliseconds timeout = infinite);
 
+/*! RAII wrapper around `reproc_command_t`. `arguments` and `options` are
+converted to the format expected by reproc only once when the command is
+created. If `reproc_command_new` fails, the error is reported by
+`process::start`. */
+class command {
+
+public:
+  REPROCXX_EXPORT command(const arguments &arguments,
+                          const options &options = {}) noexcept;
+  REPROCXX_EXPORT ~command() noexcept;
+
+  REPROCXX_EXPORT command(command &&other) noexcept;
+  REPROCXX_EXPORT command &operator=(command &&other) noexcept;
+
+  /*! Returns `false` if the command could not be created. */
+  REPROCXX_EXPORT explicit operator bool() const noexcept;
+
+private:
+  friend class process;
+
+  std::unique_ptr<reproc_command_t, void (*)(reproc_command_t *)> command_;
+};
+
 /*! Improves on reproc's API by adding RAII and changing the API of some
 functions to be more idiomatic C++. */
+/*! Read-only view of the output captured by `process::capture`. */
+class view {
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+
+public:
+  view() = default;
+
+  view(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+  const uint8_t *data() const noexcept
+  {
+    return data_;
+  }
+
+  size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  bool empty() const noexcept
+  {
+    return size_ == 0;
+  }
+
+  const uint8_t *begin() const noexcept
+  {
+    return data_;
+  }
+
+  const uint8_t *end() const noexcept
+  {
+    return data_ + size_;
+  }
+};
+
+/*! `reproc_iovec` */
+struct buffer {
+  uint8_t *data;
+  size_t size;
+};
+
 class process {
 
 public:
@@ -151,6 +303,9 @@ public:
   REPROCXX_EXPORT std::error_code start(const arguments &arguments,
                                         const options &options = {}) noexcept;
 
+  /*! `reproc_command_start` */
+  REPROCXX_EXPORT std::error_code start(const command &command) noexcept;
+
   /*! Sets the `fork` option in `reproc_options` and calls `start`. Returns
   `true` in the child process and `false` in the parent process. */
   REPROCXX_EXPORT std::pair<bool, std::error_code>
@@ -165,10 +320,71 @@ public:
   REPROCXX_EXPORT std::pair<size_t, std::error_code>
   read(stream stream, uint8_t *buffer, size_t size) noexcept;
 
+  /*! `reproc_readv` but returns a pair of (bytes read, error). */
+  REPROCXX_EXPORT std::pair<size_t, std::error_code>
+  read(stream stream, const buffer *buffers, size_t num_buffers) noexcept;
+
+  std::pair<size_t, std::error_code>
+  read(stream stream, std::initializer_list<buffer> buffers) noexcept
+  {
+    return read(stream, buffers.begin(), buffers.size());
+  }
+
   /*! reproc_write` but returns a pair of (bytes_written, error). */
   REPROCXX_EXPORT std::pair<size_t, std::error_code>
   write(const uint8_t *buffer, size_t size) noexcept;
 
+  /*! `reproc_writev` but returns a pair of (bytes written, error). */
+  REPROCXX_EXPORT std::pair<size_t, std::error_code>
+  write(const buffer *buffers, size_t num_buffers) noexcept;
+
+  std::pair<size_t, std::error_code>
+  write(std::initializer_list<buffer> buffers) noexcept
+  {
+    return write(buffers.begin(), buffers.size());
+  }
+
+  /*! `reproc_write_to` but returns a pair of (bytes written, error). */
+  REPROCXX_EXPORT std::pair<size_t, std::error_code>
+  write(stream stream, const uint8_t *buffer, size_t size) noexcept;
+
+  /*!
+  `reproc_write_gift` but takes ownership of `buffer` and keeps writing until
+  all `size` bytes of it have been written or an error occurs. Returns a pair of
+  (bytes written, error).
+
+  `buffer` is destroyed with its deleter before this function returns. The
+  stdin pipe might still reference its pages at that point so the deleter may
+  not return the memory to an allocator that hands it out again (`delete[]` and
+  `free` do). Unmapping it with `munmap` is fine.
+  */
+  template <typename Deleter>
+  std::pair<size_t, std::error_code>
+  write(std::unique_ptr<uint8_t[], Deleter> buffer, size_t size) noexcept
+  {
+    static_assert(
+        !std::is_same<Deleter, std::default_delete<uint8_t[]>>::value,
+        "`delete[]` hands the memory out again while the pipe references it");
+
+    return write_gift(buffer.get(), size);
+  }
+
+  /*! `reproc_write_input` but returns a pair of (input remaining, error). */
+  REPROCXX_EXPORT std::pair<bool, std::error_code> write_input() noexcept;
+
+  /*! `reproc_pipe_size` but returns a pair of (capacity, error). */
+  REPROCXX_EXPORT std::pair<size_t, std::error_code>
+  pipe_size(stream stream) const noexcept;
+
+  /*! `reproc_handle_of` but returns a pair of (handle, error). */
+  REPROCXX_EXPORT std::pair<handle, std::error_code>
+  handle_of(stream stream) const noexcept;
+
+  /*! `reproc_capture` but returns a pair of (output, error). The view stays
+  valid until the process is destroyed. */
+  REPROCXX_EXPORT std::pair<view, std::error_code>
+  capture(stream stream) noexcept;
+
   REPROCXX_EXPORT std::error_code close(stream stream) noexcept;
 
   /*! `reproc_wait` but returns a pair of (status, error). */
@@ -187,7 +403,118 @@ private:
   REPROCXX_EXPORT friend std::error_code
   poll(event::source *sources, size_t num_sources, milliseconds timeout);
 
+  REPROCXX_EXPORT std::pair<size_t, std::error_code>
+  write_gift(const uint8_t *buffer, size_t size) noexcept;
+
+  REPROCXX_EXPORT friend std::error_code
+  drain(process &process, sink::fd out, sink::fd err);
+
+  friend class pipeline;
+  friend class poller;
+
   std::unique_ptr<reproc_t, void (*)(reproc_t *)> process_;
 };
 
+/*! RAII wrapper around `reproc_poller_t`. Processes are removed from the poller
+when they're destroyed. */
+class poller {
+
+public:
+  /*! An event reported by `poller::wait`. */
+  struct event {
+    /*! Pointer passed to `poller::add` when the process was added. */
+    void *context;
+    int events;
+  };
+
+  /*! A completion reported by `poller::complete`. */
+  struct completion {
+    /*! Pointer passed to `poller::add` when the process was added. */
+    void *context;
+    int events;
+    /*! Amount of bytes written or read or the exit status of the process. */
+    int result;
+    std::error_code error;
+    /*! Output read from the process. Stays valid until the next call to
+    `poller::complete`. */
+    const uint8_t *data;
+  };
+
+  REPROCXX_EXPORT poller();
+  REPROCXX_EXPORT ~poller() noexcept;
+
+  REPROCXX_EXPORT poller(poller &&other) noexcept;
+  REPROCXX_EXPORT poller &operator=(poller &&other) noexcept;
+
+  /*! `reproc_poller_add` */
+  REPROCXX_EXPORT std::error_code
+  add(process &process, int interests, void *context = nullptr) noexcept;
+
+  /*! `reproc_poller_modify` */
+  REPROCXX_EXPORT std::error_code modify(process &process,
+                                         int interests) noexcept;
+
+  /*! `reproc_poller_remove` */
+  REPROCXX_EXPORT std::error_code remove(process &process) noexcept;
+
+  /*! `reproc_poller_wait` but returns a pair of (number of events, error). */
+  REPROCXX_EXPORT std::pair<size_t, std::error_code>
+  wait(event *events, size_t num_events, milliseconds timeout = infinite);
+
+  /*! `reproc_poller_write` */
+  REPROCXX_EXPORT std::error_code
+  write(process &process, const uint8_t *buffer, size_t size) noexcept;
+
+  /*! `reproc_poller_complete` but returns a pair of (number of completions,
+  error). */
+  REPROCXX_EXPORT std::pair<size_t, std::error_code>
+  complete(completion *completions,
+           size_t num_completions,
+           milliseconds timeout = infinite);
+
+private:
+  std::unique_ptr<reproc_poller_t, void (*)(reproc_poller_t *)> poller_;
+  // Reused by every call to `wait`.
+  std::unique_ptr<reproc_poller_event[]> events_;
+  size_t num_events_ = 0;
+  // Reused by every call to `complete`.
+  std::unique_ptr<reproc_completion[]> completions_;
+  size_t num_completions_ = 0;
+};
+
+/*! Owns the stages of a pipeline started with `reproc_pipeline_start`. Use
+`operator[]` to access individual stages, for example to write to the stdin of
+the first stage or to read from the stdout of the last stage. */
+class pipeline {
+
+public:
+  REPROCXX_EXPORT explicit pipeline(size_t num_stages);
+  REPROCXX_EXPORT ~pipeline() noexcept;
+
+  REPROCXX_EXPORT pipeline(pipeline &&other) noexcept;
+  REPROCXX_EXPORT pipeline &operator=(pipeline &&other) noexcept;
+
+  /*! `reproc_pipeline_start`. `arguments` must contain the arguments of each
+  stage. */
+  REPROCXX_EXPORT std::error_code start(const std::vector<arguments> &arguments,
+                                        const options &options = {});
+
+  REPROCXX_EXPORT process &operator[](size_t stage) noexcept;
+
+  REPROCXX_EXPORT size_t size() const noexcept;
+
+  /*! `reproc_pipeline_wait` but returns a pair of (statuses, error) where
+  `statuses` contains the result of waiting for each stage. */
+  REPROCXX_EXPORT std::pair<std::vector<int>, std::error_code>
+  wait(milliseconds timeout);
+
+  /*! `reproc_pipeline_stop` but returns a pair of (statuses, error) where
+  `statuses` contains the result of stopping each stage. */
+  REPROCXX_EXPORT std::pair<std::vector<int>, std::error_code>
+  stop(stop_actions stop);
+
+private:
+  std::vector<process> stages_;
+};
+
 }
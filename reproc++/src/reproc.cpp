@@ -1,7 +1,12 @@
+#include <reproc++/drain.hpp>
 #include <reproc++/reproc.hpp>
 
+#include <reproc/drain.h>
+#include <reproc/pipeline.h>
 #include <reproc/reproc.h>
 
+#include <cstddef>
+
 namespace reproc {
 
 namespace signal {
@@ -39,13 +44,44 @@ static reproc_stop_actions reproc_stop_actions_from(stop_actions stop)
   };
 }
 
+static_assert(static_cast<int>(redirect::memfd) == REPROC_REDIRECT_MEMFD,
+              "`redirect::memfd` doesn't match `REPROC_REDIRECT_MEMFD`");
+static_assert(static_cast<int>(redirect::socket) == REPROC_REDIRECT_SOCKET,
+              "`redirect::socket` doesn't match `REPROC_REDIRECT_SOCKET`");
+
 static reproc_redirect reproc_redirect_from(redirect redirect)
 {
   return { static_cast<REPROC_REDIRECT>(redirect.type), redirect.handle,
-           redirect.file };
+           redirect.file, redirect.pipe_size, redirect.adaptive };
 }
 
-static reproc_options reproc_options_from(const options &options, bool fork)
+// `reproc::extra_stream` is passed to reproc as is so it has to match
+// `reproc_extra_stream`.
+static_assert(
+    sizeof(redirect) == sizeof(reproc_redirect) &&
+        sizeof(redirect::type) == sizeof(REPROC_REDIRECT) &&
+        offsetof(redirect, handle) == offsetof(reproc_redirect, handle) &&
+        offsetof(redirect, file) == offsetof(reproc_redirect, file) &&
+        offsetof(redirect, pipe_size) == offsetof(reproc_redirect, pipe_size) &&
+        offsetof(redirect, adaptive) == offsetof(reproc_redirect, adaptive),
+    "`reproc::redirect` doesn't match `reproc_redirect`");
+static_assert(
+    sizeof(extra_stream) == sizeof(reproc_extra_stream) &&
+        offsetof(extra_stream, fd) == offsetof(reproc_extra_stream, fd) &&
+        offsetof(extra_stream, input) == offsetof(reproc_extra_stream, input) &&
+        offsetof(extra_stream, redirect) ==
+            offsetof(reproc_extra_stream, redirect),
+    "`reproc::extra_stream` doesn't match `reproc_extra_stream`");
+
+// `REPROC_STREAM_EXIT` is outside the range of `REPROC_STREAM` so we compare
+// the underlying values instead.
+static_assert(static_cast<int>(stream::exit) ==
+                  REPROC_STREAM_ERR + 1 + REPROC_EXTRA_STREAMS_MAX,
+              "`reproc::stream::exit` doesn't match `REPROC_STREAM_EXIT`");
+
+static reproc_options reproc_options_from(const options &options,
+                                          bool fork,
+                                          reproc_cache_t *cache)
 {
   return { options.environment.data(),
            options.working_directory,
@@ -60,8 +96,73 @@ static reproc_options reproc_options_from(const options &options, bool fork)
            reproc_stop_actions_from(options.stop),
            options.deadline.count(),
            { options.input.data(), options.input.size() },
+           fork,
+           static_cast<REPROC_SPAWN>(options.spawn),
            options.nonblocking,
-           fork };
+           options.async,
+           cache,
+           reinterpret_cast<const reproc_extra_stream *>(options.extra_streams),
+           options.num_extra_streams };
+}
+
+std::error_code helper_start() noexcept
+{
+  int r = reproc_helper_start();
+  return error_code_from(r);
+}
+
+std::error_code helper_stop() noexcept
+{
+  int r = reproc_helper_stop();
+  return error_code_from(r);
+}
+
+std::error_code reaper_start() noexcept
+{
+  int r = reproc_reaper_start();
+  return error_code_from(r);
+}
+
+std::error_code reaper_stop() noexcept
+{
+  int r = reproc_reaper_stop();
+  return error_code_from(r);
+}
+
+std::pair<handle, std::error_code> memfd_new(const uint8_t *data,
+                                             size_t size) noexcept
+{
+  handle memfd = {};
+  int r = reproc_memfd_new(data, size, &memfd);
+  return { memfd, error_code_from(r) };
+}
+
+auto cache_deleter = [](reproc_cache_t *cache) { reproc_cache_destroy(cache); };
+
+cache::cache() : cache_(reproc_cache_new(), cache_deleter) {}
+cache::~cache() noexcept = default;
+
+cache::cache(cache &&other) noexcept = default;
+cache &cache::operator=(cache &&other) noexcept = default;
+
+auto command_deleter = [](reproc_command_t *command) {
+  reproc_command_destroy(command);
+};
+
+command::command(const arguments &arguments, const options &options) noexcept
+    : command_(reproc_command_new(arguments.data(),
+                                  reproc_options_from(options, false, nullptr)),
+               command_deleter)
+{}
+
+command::~command() noexcept = default;
+
+command::command(command &&other) noexcept = default;
+command &command::operator=(command &&other) noexcept = default;
+
+command::operator bool() const noexcept
+{
+  return command_ != nullptr;
 }
 
 auto deleter = [](reproc_t *process) { reproc_destroy(process); };
@@ -75,14 +176,22 @@ process &process::operator=(process &&other) noexcept = default;
 std::error_code process::start(const arguments &arguments,
                                const options &options) noexcept
 {
-  reproc_options reproc_options = reproc_options_from(options, false);
+  reproc_cache_t *cache = options.cache != nullptr ? options.cache->cache_.get()
+                                                   : nullptr;
+  reproc_options reproc_options = reproc_options_from(options, false, cache);
   int r = reproc_start(process_.get(), arguments.data(), reproc_options);
   return error_code_from(r);
 }
 
+std::error_code process::start(const command &command) noexcept
+{
+  int r = reproc_command_start(command.command_.get(), process_.get());
+  return error_code_from(r);
+}
+
 std::pair<bool, std::error_code> process::fork(const options &options) noexcept
 {
-  reproc_options reproc_options = reproc_options_from(options, true);
+  reproc_options reproc_options = reproc_options_from(options, true, nullptr);
   int r = reproc_start(process_.get(), nullptr, reproc_options);
   return { r == 0, error_code_from(r) };
 }
@@ -110,6 +219,103 @@ std::pair<size_t, std::error_code> process::write(const uint8_t *buffer,
   return { r, error_code_from(r) };
 }
 
+std::pair<size_t, std::error_code>
+process::write(stream stream, const uint8_t *buffer, size_t size) noexcept
+{
+  int r = reproc_write_to(process_.get(), static_cast<REPROC_STREAM>(stream),
+                          buffer, size);
+  return { r, error_code_from(r) };
+}
+
+// `reproc::buffer` is passed to reproc as is so it has to match `reproc_iovec`.
+static_assert(sizeof(buffer) == sizeof(reproc_iovec) &&
+                  offsetof(buffer, data) == offsetof(reproc_iovec, data) &&
+                  offsetof(buffer, size) == offsetof(reproc_iovec, size),
+              "`reproc::buffer` doesn't match `reproc_iovec`");
+
+std::pair<size_t, std::error_code>
+process::read(stream stream, const buffer *buffers, size_t num_buffers) noexcept
+{
+  int r = reproc_readv(process_.get(), static_cast<REPROC_STREAM>(stream),
+                       reinterpret_cast<const reproc_iovec *>(buffers),
+                       num_buffers);
+  return { r, error_code_from(r) };
+}
+
+std::pair<size_t, std::error_code> process::write(const buffer *buffers,
+                                                  size_t num_buffers) noexcept
+{
+  int r = reproc_writev(process_.get(),
+                        reinterpret_cast<const reproc_iovec *>(buffers),
+                        num_buffers);
+  return { r, error_code_from(r) };
+}
+
+std::pair<size_t, std::error_code>
+process::write_gift(const uint8_t *buffer, size_t size) noexcept
+{
+  size_t written = 0;
+
+  while (written < size) {
+    int r = reproc_write_gift(process_.get(), buffer + written, size - written);
+
+    if (r == REPROC_EWOULDBLOCK) {
+      reproc_event_source source = { process_.get(), REPROC_EVENT_IN, 0 };
+
+      r = reproc_poll(&source, 1, REPROC_INFINITE);
+      if (r < 0) {
+        return { written, error_code_from(r) };
+      }
+
+      if (source.events & REPROC_EVENT_DEADLINE) {
+        return { written, std::make_error_code(std::errc::timed_out) };
+      }
+
+      continue;
+    }
+
+    if (r < 0) {
+      return { written, error_code_from(r) };
+    }
+
+    written += static_cast<size_t>(r);
+  }
+
+  return { written, {} };
+}
+
+std::pair<bool, std::error_code> process::write_input() noexcept
+{
+  int r = reproc_write_input(process_.get());
+  return { r > 0, error_code_from(r) };
+}
+
+std::pair<size_t, std::error_code>
+process::pipe_size(stream stream) const noexcept
+{
+  int r = reproc_pipe_size(process_.get(), static_cast<REPROC_STREAM>(stream));
+  return { r, error_code_from(r) };
+}
+
+std::pair<handle, std::error_code>
+process::handle_of(stream stream) const noexcept
+{
+  handle handle = {};
+  int r = reproc_handle_of(process_.get(), static_cast<REPROC_STREAM>(stream),
+                           &handle);
+  return { handle, error_code_from(r) };
+}
+
+std::pair<view, std::error_code> process::capture(stream stream) noexcept
+{
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+
+  int r = reproc_capture(process_.get(), static_cast<REPROC_STREAM>(stream),
+                         &data, &size);
+  return { view(data, size), error_code_from(r) };
+}
+
 std::error_code process::close(stream stream) noexcept
 {
   int r = reproc_close(process_.get(), static_cast<REPROC_STREAM>(stream));
@@ -140,6 +346,167 @@ std::pair<int, std::error_code> process::stop(stop_actions stop) noexcept
   return { r, error_code_from(r) };
 }
 
+std::error_code drain(process &process, sink::fd out, sink::fd err)
+{
+  int r = reproc_drain_to_fd(process.process_.get(), out.handle(),
+                             err.handle());
+  return error_code_from(r);
+}
+
+auto poller_deleter = [](reproc_poller_t *poller) {
+  reproc_poller_destroy(poller);
+};
+
+poller::poller() : poller_(reproc_poller_new(), poller_deleter) {}
+poller::~poller() noexcept = default;
+
+poller::poller(poller &&other) noexcept = default;
+poller &poller::operator=(poller &&other) noexcept = default;
+
+std::error_code
+poller::add(process &process, int interests, void *context) noexcept
+{
+  int r = reproc_poller_add(poller_.get(), process.process_.get(), interests,
+                            context);
+  return error_code_from(r);
+}
+
+std::error_code poller::modify(process &process, int interests) noexcept
+{
+  int r = reproc_poller_modify(poller_.get(), process.process_.get(),
+                               interests);
+  return error_code_from(r);
+}
+
+std::error_code poller::remove(process &process) noexcept
+{
+  int r = reproc_poller_remove(poller_.get(), process.process_.get());
+  return error_code_from(r);
+}
+
+std::pair<size_t, std::error_code>
+poller::wait(event *events, size_t num_events, milliseconds timeout)
+{
+  if (num_events > num_events_) {
+    events_.reset(new reproc_poller_event[num_events]);
+    num_events_ = num_events;
+  }
+
+  int r = reproc_poller_wait(poller_.get(), events_.get(), num_events,
+                             timeout.count());
+
+  size_t count = r < 0 ? 0 : static_cast<size_t>(r);
+
+  for (size_t i = 0; i < count; i++) {
+    events[i] = { events_[i].context, events_[i].events };
+  }
+
+  return { count, error_code_from(r) };
+}
+
+std::error_code
+poller::write(process &process, const uint8_t *buffer, size_t size) noexcept
+{
+  int r = reproc_poller_write(poller_.get(), process.process_.get(), buffer,
+                              size);
+  return error_code_from(r);
+}
+
+std::pair<size_t, std::error_code>
+poller::complete(completion *completions,
+                 size_t num_completions,
+                 milliseconds timeout)
+{
+  if (num_completions > num_completions_) {
+    completions_.reset(new reproc_completion[num_completions]);
+    num_completions_ = num_completions;
+  }
+
+  int r = reproc_poller_complete(poller_.get(), completions_.get(),
+                                 num_completions, timeout.count());
+
+  size_t count = r < 0 ? 0 : static_cast<size_t>(r);
+
+  for (size_t i = 0; i < count; i++) {
+    const reproc_completion &completion = completions_[i];
+    int result = completion.result;
+
+    completions[i] = { completion.context, completion.events,
+                       result < 0 ? 0 : result, error_code_from(result),
+                       completion.data };
+  }
+
+  return { count, error_code_from(r) };
+}
+
+pipeline::pipeline(size_t num_stages) : stages_(num_stages) {}
+pipeline::~pipeline() noexcept = default;
+
+pipeline::pipeline(pipeline &&other) noexcept = default;
+pipeline &pipeline::operator=(pipeline &&other) noexcept = default;
+
+std::error_code pipeline::start(const std::vector<arguments> &arguments,
+                                const options &options)
+{
+  if (arguments.size() != stages_.size() || stages_.empty()) {
+    return std::make_error_code(std::errc::invalid_argument);
+  }
+
+  std::vector<reproc_t *> stages;
+  std::vector<const char *const *> argvs;
+
+  for (size_t i = 0; i < stages_.size(); i++) {
+    stages.push_back(stages_[i].process_.get());
+    argvs.push_back(arguments[i].data());
+  }
+
+  reproc_cache_t *cache = options.cache != nullptr ? options.cache->cache_.get()
+                                                   : nullptr;
+  reproc_options reproc_options = reproc_options_from(options, false, cache);
+  int r = reproc_pipeline_start(stages.data(), argvs.data(), stages.size(),
+                                reproc_options);
+  return error_code_from(r);
+}
+
+process &pipeline::operator[](size_t stage) noexcept
+{
+  return stages_[stage];
+}
+
+size_t pipeline::size() const noexcept
+{
+  return stages_.size();
+}
+
+std::pair<std::vector<int>, std::error_code>
+pipeline::wait(milliseconds timeout)
+{
+  std::vector<reproc_t *> stages;
+  std::vector<int> statuses(stages_.size());
+
+  for (process &stage : stages_) {
+    stages.push_back(stage.process_.get());
+  }
+
+  int r = reproc_pipeline_wait(stages.data(), stages.size(), timeout.count(),
+                               statuses.data());
+  return { statuses, error_code_from(r) };
+}
+
+std::pair<std::vector<int>, std::error_code> pipeline::stop(stop_actions stop)
+{
+  std::vector<reproc_t *> stages;
+  std::vector<int> statuses(stages_.size());
+
+  for (process &stage : stages_) {
+    stages.push_back(stage.process_.get());
+  }
+
+  int r = reproc_pipeline_stop(stages.data(), stages.size(),
+                               reproc_stop_actions_from(stop), statuses.data());
+  return { statuses, error_code_from(r) };
+}
+
 std::error_code
 poll(event::source *sources, size_t num_sources, milliseconds timeout)
 {
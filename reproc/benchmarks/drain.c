@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { NUM_ROUNDS = 5 };
+
+static double now(void)
+{
+  struct timespec ts = { 0, 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1000 + (double) ts.tv_nsec / 1000000;
+}
+
+static int sink_fd(REPROC_STREAM stream,
+                   const uint8_t *buffer,
+                   size_t size,
+                   void *context)
+{
+  (void) stream;
+
+  int fd = *(int *) context;
+
+  while (size > 0) {
+    ssize_t r = write(fd, buffer, size);
+    if (r < 0) {
+      return -1;
+    }
+
+    buffer += r;
+    size -= (size_t) r;
+  }
+
+  return 0;
+}
+
+// Forwards the output of `argv` to `fd` with either `reproc_drain` and a sink
+// that writes to `fd` or with `reproc_drain_to_fd` and stores the time it took
+// in `elapsed` (in milliseconds).
+static int
+forward(const char *const *argv, int fd, bool splice, double *elapsed)
+{
+  reproc_t *process = NULL;
+  int r = REPROC_ENOMEM;
+
+  process = reproc_new();
+  if (process == NULL) {
+    goto finish;
+  }
+
+  double start = now();
+
+  r = reproc_start(process, argv, (reproc_options){ 0 });
+  if (r < 0) {
+    goto finish;
+  }
+
+  if (splice) {
+    r = reproc_drain_to_fd(process, fd, fd);
+  } else {
+    reproc_sink sink = { sink_fd, &fd };
+    r = reproc_drain(process, sink, sink);
+  }
+
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  if (r < 0) {
+    goto finish;
+  }
+
+  *elapsed = now() - start;
+
+finish:
+  reproc_destroy(process);
+
+  return r;
+}
+
+// Compares forwarding the output of a child process (1 GiB of zeroes by
+// default) to a file (`/dev/null` by default) with `reproc_drain` against
+// forwarding it with `reproc_drain_to_fd`.
+//
+// Example: "./drain output.bin cat large-file.bin"
+int main(int argc, const char *argv[])
+{
+  static const char *const DEFAULT[] = { "head", "-c", "1073741824",
+                                         "/dev/zero", NULL };
+  const char *path = argc > 1 ? argv[1] : "/dev/null";
+  const char *const *command = argc > 2 ? argv + 2 : DEFAULT;
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("open");
+    return EXIT_FAILURE;
+  }
+
+  printf("best of %d runs\n", NUM_ROUNDS);
+
+  for (int splice = 0; splice <= 1; splice++) {
+    double best = 0;
+
+    for (int i = 0; i < NUM_ROUNDS; i++) {
+      double elapsed = 0;
+
+      // Overwrite the output of the previous run if `path` is a regular file.
+      (void) lseek(fd, 0, SEEK_SET);
+
+      int r = forward(command, fd, splice, &elapsed);
+      if (r < 0) {
+        fprintf(stderr, "%s\n", reproc_strerror(r));
+        close(fd);
+        return EXIT_FAILURE;
+      }
+
+      if (i == 0 || elapsed < best) {
+        best = elapsed;
+      }
+    }
+
+    printf("%-18s %10.3f ms\n", splice ? "reproc_drain_to_fd" : "reproc_drain",
+           best);
+  }
+
+  close(fd);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <reproc/reproc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+enum { NUM_ROUNDS = 5, BUFFER_SIZE = 4096 };
+
+static double now(void)
+{
+  struct timespec ts = { 0, 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1000 + (double) ts.tv_nsec / 1000000;
+}
+
+// Starts `argv` with stdin and stdout redirected to pipes.
+static reproc_t *start(const char *const *argv)
+{
+  reproc_t *process = reproc_new();
+  if (process == NULL) {
+    return NULL;
+  }
+
+  reproc_options options = { 0 };
+  options.redirect.err.type = REPROC_REDIRECT_DISCARD;
+
+  int r = reproc_start(process, argv, options);
+  if (r < 0) {
+    fprintf(stderr, "%s: %s\n", argv[0], reproc_strerror(r));
+    return reproc_destroy(process);
+  }
+
+  return process;
+}
+
+// Reads the output of `processes[0]` until it closes stdout while the other
+// processes don't write anything. Waits for output with `reproc_poll` or with
+// `poller` if it isn't `NULL`.
+static int read_busy(reproc_t **processes,
+                     size_t num_processes,
+                     reproc_poller_t *poller)
+{
+  reproc_event_source *sources = NULL;
+  int r = REPROC_ENOMEM;
+
+  sources = calloc(num_processes, sizeof(reproc_event_source));
+  if (sources == NULL) {
+    goto finish;
+  }
+
+  for (size_t i = 0; i < num_processes; i++) {
+    sources[i] = (reproc_event_source){ processes[i], REPROC_EVENT_OUT, 0 };
+
+    if (poller != NULL) {
+      r = reproc_poller_add(poller, processes[i], REPROC_EVENT_OUT, NULL);
+      if (r < 0) {
+        goto finish;
+      }
+    }
+  }
+
+  uint8_t buffer[BUFFER_SIZE];
+
+  while (true) {
+    if (poller != NULL) {
+      reproc_poller_event events[16];
+      r = reproc_poller_wait(poller, events, 16, REPROC_INFINITE);
+    } else {
+      r = reproc_poll(sources, num_processes, REPROC_INFINITE);
+    }
+
+    if (r < 0) {
+      goto finish;
+    }
+
+    r = reproc_read(processes[0], REPROC_STREAM_OUT, buffer, sizeof(buffer));
+    if (r == REPROC_EPIPE) {
+      r = 0;
+      break;
+    }
+
+    if (r < 0) {
+      goto finish;
+    }
+  }
+
+finish:
+  if (poller != NULL) {
+    for (size_t i = 0; i < num_processes; i++) {
+      reproc_poller_remove(poller, processes[i]);
+    }
+  }
+
+  free(sources);
+
+  return r;
+}
+
+// Compares the time it takes to read the output of a child process (64 MiB of
+// zeroes by default) with `reproc_poll` against `reproc_poller_wait` while
+// `num_idle` other child processes (256 by default) are polled as well.
+//
+// Example: "./poller 512 cat large-file.bin"
+int main(int argc, const char *argv[])
+{
+  static const char *const BUSY[] = { "head", "-c", "67108864", "/dev/zero",
+                                      NULL };
+  static const char *const IDLE[] = { "cat", NULL };
+  size_t num_idle = argc > 1 ? strtoul(argv[1], NULL, 10) : 256;
+  const char *const *busy = argc > 2 ? argv + 2 : BUSY;
+  size_t num_processes = num_idle + 1;
+
+  reproc_t **processes = calloc(num_processes, sizeof(reproc_t *));
+  if (processes == NULL) {
+    return EXIT_FAILURE;
+  }
+
+  // Idle processes block reading stdin until we close it.
+  for (size_t i = 1; i < num_processes; i++) {
+    processes[i] = start(IDLE);
+    if (processes[i] == NULL) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  reproc_poller_t *poller = reproc_poller_new();
+  if (poller == NULL) {
+    return EXIT_FAILURE;
+  }
+
+  printf("best of %d runs with %zu idle processes\n", NUM_ROUNDS, num_idle);
+
+  const char *names[] = { "reproc_poll", "reproc_poller" };
+
+  for (size_t i = 0; i < 2; i++) {
+    double best = 0;
+
+    for (int j = 0; j < NUM_ROUNDS; j++) {
+      processes[0] = start(busy);
+      if (processes[0] == NULL) {
+        return EXIT_FAILURE;
+      }
+
+      double begin = now();
+
+      int r = read_busy(processes, num_processes, i == 0 ? NULL : poller);
+      if (r < 0) {
+        fprintf(stderr, "%s: %s\n", names[i], reproc_strerror(r));
+        return EXIT_FAILURE;
+      }
+
+      double elapsed = now() - begin;
+
+      reproc_wait(processes[0], REPROC_INFINITE);
+      processes[0] = reproc_destroy(processes[0]);
+
+      if (j == 0 || elapsed < best) {
+        best = elapsed;
+      }
+    }
+
+    printf("%-16s %10.3f ms\n", names[i], best);
+  }
+
+  for (size_t i = 1; i < num_processes; i++) {
+    reproc_close(processes[i], REPROC_STREAM_IN);
+    reproc_wait(processes[i], REPROC_INFINITE);
+    reproc_destroy(processes[i]);
+  }
+
+  reproc_poller_destroy(poller);
+  free(processes);
+
+  return EXIT_SUCCESS;
+}
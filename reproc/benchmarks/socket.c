@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+enum { NUM_ROUNDS = 5 };
+
+static double now(void)
+{
+  struct timespec ts = { 0, 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1000 + (double) ts.tv_nsec / 1000000;
+}
+
+static int sink_count(REPROC_STREAM stream,
+                      const uint8_t *buffer,
+                      size_t size,
+                      void *context)
+{
+  (void) stream;
+  (void) buffer;
+
+  *(size_t *) context += size;
+
+  return 0;
+}
+
+// Reads the output of `argv` from a stdout redirected to `redirect` with
+// `reproc_drain` and stores the time it took in `elapsed` (in milliseconds)
+// and the amount of output in `total`.
+static int read_all(const char *const *argv,
+                    reproc_redirect redirect,
+                    double *elapsed,
+                    size_t *total)
+{
+  reproc_t *process = NULL;
+  int r = REPROC_ENOMEM;
+
+  process = reproc_new();
+  if (process == NULL) {
+    goto finish;
+  }
+
+  double start = now();
+
+  reproc_options options = { 0 };
+  options.redirect.out = redirect;
+  options.redirect.err.type = REPROC_REDIRECT_DISCARD;
+
+  r = reproc_start(process, argv, options);
+  if (r < 0) {
+    goto finish;
+  }
+
+  *total = 0;
+  reproc_sink sink = { sink_count, total };
+
+  r = reproc_drain(process, sink, REPROC_SINK_NULL);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  if (r < 0) {
+    goto finish;
+  }
+
+  *elapsed = now() - start;
+
+finish:
+  reproc_destroy(process);
+
+  return r;
+}
+
+// Compares the throughput of reading the output of a child process (1 GiB of
+// zeroes by default) through a pipe against reading it through a socket, both
+// with the default buffer sizes and with `pipe_size` set to `size` (1M by
+// default).
+//
+// Example: "./socket 262144 cat large-file.bin"
+int main(int argc, const char *argv[])
+{
+  static const char *const DEFAULT[] = { "head", "-c", "1073741824",
+                                         "/dev/zero", NULL };
+  size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 1 << 20;
+  const char *const *command = argc > 2 ? argv + 2 : DEFAULT;
+
+  static const struct {
+    const char *name;
+    REPROC_REDIRECT type;
+    bool sized;
+  } CASES[] = { { "pipe", REPROC_REDIRECT_PIPE, false },
+                { "socket", REPROC_REDIRECT_SOCKET, false },
+                { "pipe (sized)", REPROC_REDIRECT_PIPE, true },
+                { "socket (sized)", REPROC_REDIRECT_SOCKET, true } };
+
+  printf("best of %d runs\n", NUM_ROUNDS);
+
+  for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+    reproc_redirect redirect = { 0 };
+    redirect.type = CASES[i].type;
+    redirect.pipe_size = CASES[i].sized ? size : 0;
+
+    double best = 0;
+    size_t total = 0;
+
+    for (int j = 0; j < NUM_ROUNDS; j++) {
+      double elapsed = 0;
+
+      int r = read_all(command, redirect, &elapsed, &total);
+      if (r < 0) {
+        fprintf(stderr, "%s: %s\n", CASES[i].name, reproc_strerror(r));
+        return EXIT_FAILURE;
+      }
+
+      if (j == 0 || elapsed < best) {
+        best = elapsed;
+      }
+    }
+
+    double throughput = best > 0 ? (double) total / (best * 1000) : 0;
+
+    printf("%-16s %10.3f ms %10.1f MB/s\n", CASES[i].name, best, throughput);
+  }
+
+  return EXIT_SUCCESS;
+}
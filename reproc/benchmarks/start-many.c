@@ -0,0 +1,113 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <reproc/reproc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+enum { NUM_PROCESSES = 64, NUM_ROUNDS = 20 };
+
+static double now(void)
+{
+  struct timespec ts = { 0, 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1000 + (double) ts.tv_nsec / 1000000;
+}
+
+// Starts `NUM_PROCESSES` processes either one after the other with
+// `reproc_start` or all at once with `reproc_start_many` and stores the time it
+// took to start them in `elapsed` (in milliseconds).
+static int batch(const char *const *argv,
+                 REPROC_SPAWN spawn,
+                 bool many,
+                 double *elapsed)
+{
+  reproc_t *processes[NUM_PROCESSES] = { 0 };
+  const char *const *argvs[NUM_PROCESSES] = { 0 };
+  int results[NUM_PROCESSES] = { 0 };
+  int r = -1;
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    processes[i] = reproc_new();
+    if (processes[i] == NULL) {
+      r = REPROC_ENOMEM;
+      goto finish;
+    }
+
+    argvs[i] = argv;
+  }
+
+  reproc_options options = { .spawn = spawn, .redirect.discard = true };
+
+  double start = now();
+
+  if (many) {
+    r = reproc_start_many(processes, argvs, NUM_PROCESSES, options, results);
+  } else {
+    for (size_t i = 0; i < NUM_PROCESSES; i++) {
+      results[i] = reproc_start(processes[i], argv, options);
+    }
+  }
+
+  *elapsed = now() - start;
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    if (results[i] < 0) {
+      r = results[i];
+      goto finish;
+    }
+  }
+
+  r = 0;
+
+finish:
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    reproc_destroy(processes[i]);
+  }
+
+  return r;
+}
+
+// Compares starting batches of the process given on the command line (`true` by
+// default) in a loop against starting them with `reproc_start_many`.
+int main(int argc, const char *argv[])
+{
+  static const char *const DEFAULT[] = { "true", NULL };
+  const char *const *command = argc > 1 ? argv + 1 : DEFAULT;
+
+  static const struct {
+    const char *name;
+    REPROC_SPAWN spawn;
+  } SPAWN[] = { { "fork", REPROC_SPAWN_FORK },
+                { "vfork", REPROC_SPAWN_VFORK } };
+
+  printf("%d processes per batch, best of %d batches\n", NUM_PROCESSES,
+         NUM_ROUNDS);
+
+  for (size_t i = 0; i < sizeof(SPAWN) / sizeof(SPAWN[0]); i++) {
+    for (int many = 0; many <= 1; many++) {
+      double best = 0;
+
+      for (int j = 0; j < NUM_ROUNDS; j++) {
+        double elapsed = 0;
+
+        int r = batch(command, SPAWN[i].spawn, many, &elapsed);
+        if (r < 0) {
+          fprintf(stderr, "%s\n", reproc_strerror(r));
+          return EXIT_FAILURE;
+        }
+
+        if (j == 0 || elapsed < best) {
+          best = elapsed;
+        }
+      }
+
+      printf("%-6s %-17s %8.3f ms (%6.1f us/process)\n", SPAWN[i].name,
+             many ? "reproc_start_many" : "reproc_start", best,
+             best * 1000 / NUM_PROCESSES);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
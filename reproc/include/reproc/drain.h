@@ -33,6 +33,10 @@ output from the previous call to `reproc_drain` one by one.
 When a stream is closed, its corresponding `sink` is called once with `size` set
 to zero.
 
+If part of `options.input` didn't fit in the stdin pipe when the child process
+was started, `reproc_drain` writes it with `reproc_write_input` whenever the
+stdin pipe becomes writable while reading the output of the child process.
+
 Note that his function returns 0 instead of `REPROC_EPIPE` when both output
 streams of the child process are closed.
 
@@ -69,7 +73,32 @@ REPROC_EXPORT reproc_sink reproc_sink_string(char **output);
 /*! Discards the output of a process. */
 REPROC_EXPORT reproc_sink reproc_sink_discard(void);
 
+/*!
+`reproc_drain` but writes the output from stdout and stderr directly to the
+file descriptors (POSIX) or handles (Windows) `out` and `err` instead of passing
+it to sinks. `out` and `err` may be the same and must be in blocking mode.
+`out` or `err` is ignored if the corresponding stream of the child process
+isn't redirected to a pipe.
+
+On Linux, the output is moved with `splice` which avoids copying it through a
+buffer in the parent process. If `out` or `err` doesn't support `splice` (for
+example, a file opened with `O_APPEND`), the output of that stream is copied
+with `read` and `write` instead. On other platforms, the output is always
+copied. When copying, output that was read from the child process but couldn't
+be written to `out` or `err` because of an error is lost.
+
+Like `reproc_drain`, writes the part of `options.input` that didn't fit in the
+stdin pipe when the child process was started and returns `REPROC_ETIMEDOUT` if
+the deadline of the child process expires.
+*/
+REPROC_EXPORT int
+reproc_drain_to_fd(reproc_t *process, reproc_handle out, reproc_handle err);
+
 /*! Calls `free` on `ptr` and returns `NULL`. Use this function to free memory
 allocated by `reproc_sink_string`. This avoids issues with allocating across
 module (DLL) boundaries on Windows. */
 REPROC_EXPORT void *reproc_free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <reproc/reproc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+Starts `num_stages` processes as a pipeline. `stages[i]` is started with
+`argvs[i]` as if by `reproc_start` and its stdout is connected to the stdin of
+`stages[i + 1]` with a pipe. Data flows directly from one child process to the
+next without passing through the parent process.
+
+`options` applies to every stage except that the stdin of all stages but the
+first and the stdout of all stages but the last are connected to the pipes
+between the stages. `options.input` is only written to the stdin of the first
+stage. If `options.redirect.file` is set, it receives the stderr of every
+stage and the stdout of the last stage. The stdin of the first stage and the stdout of the last stage can be
+written to and read from with `reproc_write` and `reproc_read` as usual.
+`options.fork` may not be set.
+
+`options.deadline` applies to each stage separately. Pass `REPROC_DEADLINE` to
+`reproc_pipeline_wait` to wait until the deadlines of all stages have expired.
+
+If a stage fails to start, the stages that were already started are killed and
+waited for and the error is returned.
+*/
+REPROC_EXPORT int reproc_pipeline_start(reproc_t *const *stages,
+                                        const char *const *const *argvs,
+                                        size_t num_stages,
+                                        reproc_options options);
+
+/*!
+Waits until all stages of a pipeline started with `reproc_pipeline_start` have
+exited. `timeout` applies to the pipeline as a whole.
+
+If `statuses` is not `NULL`, `statuses[i]` is set to the result of waiting for
+`stages[i]` which is either its exit status or a negative error code (for
+example, `REPROC_ETIMEDOUT` if it was still running when `timeout` expired).
+
+Returns the exit status of the last stage if all stages exited or the first
+error that occurred otherwise.
+*/
+REPROC_EXPORT int reproc_pipeline_wait(reproc_t *const *stages,
+                                       size_t num_stages,
+                                       int timeout,
+                                       int *statuses);
+
+/*!
+`reproc_stop` for a pipeline. Each stop action is applied to all stages before
+waiting for them with `reproc_pipeline_wait` with the timeout of the action so
+that all stages are stopped at the same time.
+
+`statuses` and the return value are the same as for `reproc_pipeline_wait`.
+*/
+REPROC_EXPORT int reproc_pipeline_stop(reproc_t *const *stages,
+                                       size_t num_stages,
+                                       reproc_stop_actions stop,
+                                       int *statuses);
+
+#ifdef __cplusplus
+}
+#endif
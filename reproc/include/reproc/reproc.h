@@ -16,6 +16,20 @@ type and can be allocated and released via `reproc_new` and `reproc_destroy`
 respectively. */
 typedef struct reproc_t reproc_t;
 
+/*! Caches the location of programs searched for in `PATH` (POSIX only). See
+the `cache` option of `reproc_options`. `reproc_cache_t` is an opaque type and
+can be allocated and released via `reproc_cache_new` and `reproc_cache_destroy`
+respectively. */
+typedef struct reproc_cache_t reproc_cache_t;
+
+/*! A prepared command that can be started many times. See
+`reproc_command_new`. */
+typedef struct reproc_command_t reproc_command_t;
+
+/*! A set of processes that are polled for events many times. See
+`reproc_poller_new`. */
+typedef struct reproc_poller_t reproc_poller_t;
+
 /*! reproc error naming follows POSIX errno naming prefixed with `REPROC`. */
 
 /*! An invalid argument was passed to an API function */
@@ -51,6 +65,20 @@ typedef enum {
   REPROC_STREAM_ERR
 } REPROC_STREAM;
 
+/*! Maximum amount of extra streams (see `reproc_extra_stream`). */
+#define REPROC_EXTRA_STREAMS_MAX 15
+
+/*! Identifies the extra stream at `index` of `options.extra_streams`. */
+#define REPROC_STREAM_EXTRA(index)                                             \
+  ((REPROC_STREAM) (REPROC_STREAM_ERR + 1 + (index)))
+
+/*!
+Identifies the handle that becomes readable when the child process exits (see
+`reproc_handle_of`). It can't be read from, written to or closed.
+*/
+#define REPROC_STREAM_EXIT                                                     \
+  ((REPROC_STREAM) (REPROC_STREAM_ERR + 1 + REPROC_EXTRA_STREAMS_MAX))
+
 /*! Used to tell reproc where to redirect the streams of the child process. */
 typedef enum {
   /*! Redirect to a pipe. */
@@ -64,9 +92,79 @@ typedef enum {
   /*! Redirect to a `FILE *`. */
   REPROC_REDIRECT_FILE,
   /*! Redirect to child process stdout. Only valid for stderr. */
-  REPROC_REDIRECT_STDOUT
+  REPROC_REDIRECT_STDOUT,
+  /*!
+  Redirect to an anonymous file in memory (`memfd_create` on Linux, a
+  temporary file that is deleted when it's closed elsewhere).
+
+  For stdout and stderr, use `reproc_capture` to access the output after the
+  child process exits. When the output is only needed after the child process
+  exits, this avoids the context switches and copies of reading the output
+  from a pipe while the child process runs.
+
+  For stdin, the child process reads from a sealed memfd that contains a copy
+  of `options.input` or from the memfd passed in `handle` (see
+  `reproc_memfd_new`). Either way, the input never passes through a pipe and
+  isn't limited by its capacity.
+  */
+  REPROC_REDIRECT_MEMFD,
+  /*!
+  Redirect to a socket pair (`AF_UNIX` on POSIX) instead of a pipe.
+  `reproc_read`, `reproc_write` and `reproc_poll` work the same as with
+  `REPROC_REDIRECT_PIPE`.
+
+  Writing to stdin never raises `SIGPIPE`. Once the child process closes
+  stdin, writes fail with `REPROC_EPIPE` regardless of how `SIGPIPE` is
+  handled. `pipe_size` sets the socket buffer sizes, which may go beyond
+  the capacity limits of pipes (up to /proc/sys/net/core/wmem_max on Linux).
+
+  When both stdin and stdout are redirected to sockets, they share a single
+  bidirectional socket in the child process and in the parent process.
+  Closing one of them with `reproc_close` shuts down its direction of the
+  socket. The shared socket uses the `pipe_size` of stdin. Because
+  `options.input` puts the parent's end of stdin in nonblocking mode, reading
+  from stdout may fail with `REPROC_EWOULDBLOCK` as well when both are used
+  together (`reproc_drain` and `reproc_run` handle this).
+
+  On Windows, pipes are already implemented with sockets, so this behaves the
+  same as `REPROC_REDIRECT_PIPE`, apart from the shared socket.
+  */
+  REPROC_REDIRECT_SOCKET
 } REPROC_REDIRECT;
 
+/*! Used to tell reproc how to create the child process (POSIX only). */
+typedef enum {
+  /*! Create a copy of the parent process with `fork` and call `exec` in the
+  copy. */
+  REPROC_SPAWN_FORK = 1,
+  /*!
+  Create the child process without copying the parent's address space (using
+  `clone(CLONE_VM | CLONE_VFORK)`). The cost of starting a child process does
+  not depend on the memory usage of the parent process and does not fail with
+  `ENOMEM` when the parent process uses a lot of memory.
+
+  Only supported on Linux. Other POSIX systems fall back to
+  `REPROC_SPAWN_FORK`.
+  */
+  REPROC_SPAWN_VFORK,
+  /*!
+  Ask the spawn helper process to create the child process (see
+  `reproc_helper_start`) or fall back to `REPROC_SPAWN_VFORK` if the helper
+  isn't running. The child process is created as a child of the
+  current process so it can be waited on, terminated and killed like any other
+  child process.
+
+  The child process inherits the environment and working directory of the
+  current process (unless overridden) but all other process attributes (umask,
+  resource limits, ...) are inherited from the helper which inherited them from
+  the current process when the helper was started.
+
+  Only supported on Linux. Other POSIX systems fall back to
+  `REPROC_SPAWN_FORK`.
+  */
+  REPROC_SPAWN_HELPER
+} REPROC_SPAWN;
+
 /*! Used to tell `reproc_stop` how to stop a child process. */
 typedef enum {
   /*! noop (no operation) */
@@ -130,8 +228,71 @@ typedef struct reproc_redirect {
   `handle` must be unset.
   */
   FILE *file;
+  /*!
+  Capacity of the pipe in bytes when `type` is `REPROC_REDIRECT_PIPE` or
+  `REPROC_REDIRECT_SOCKET`. When unset, the pipe gets the default capacity of
+  the operating system (64K on Linux).
+
+  Raising the capacity of the stdout and stderr pipes lets a child process that
+  produces a lot of output run longer before it blocks on a full pipe. Lowering
+  it reduces the kernel memory used by many idle child processes.
+
+  On Linux, the capacity is set with `F_SETPIPE_SZ` which rounds it up to a
+  power of two multiple of the page size. Unprivileged processes can't go above
+  /proc/sys/fs/pipe-max-size (1M by default) and `reproc_start` fails with
+  `EPERM` if `pipe_size` is larger. On Windows, the socket buffer sizes are
+  changed instead. On other POSIX systems, `pipe_size` is ignored unless `type`
+  is `REPROC_REDIRECT_SOCKET`, in which case the socket buffer sizes are
+  changed as well.
+
+  Setting `pipe_size` implies `REPROC_REDIRECT_PIPE` if `type` is unset.
+  Otherwise, `type` must be set to `REPROC_REDIRECT_PIPE` or
+  `REPROC_REDIRECT_SOCKET`.
+  */
+  size_t pipe_size;
+  /*!
+  Grow the stdout or stderr pipe while reading from it. When consecutive reads
+  completely fill the buffers passed to them until twice the capacity of the
+  pipe has been read, the child process is writing faster than the parent
+  process reads and reproc doubles the capacity of the pipe, up to 1M. Growing
+  stops early if the operating system refuses to grow the pipe any further.
+
+  This applies to `reproc_read`, `reproc_readv`, `reproc_drain` and
+  `reproc_drain_to_fd`. Use `reproc_pipe_size` to find out how large the pipe
+  has become. Adapting has no effect on POSIX systems other than Linux.
+
+  Setting `adaptive` implies `REPROC_REDIRECT_PIPE` so `type` must be unset or
+  set to `REPROC_REDIRECT_PIPE`. It may not be set for stdin.
+  */
+  bool adaptive;
 } reproc_redirect;
 
+/*!
+Describes a stream of the child process besides stdin, stdout and stderr. Extra
+streams are only supported on POSIX systems.
+
+Use `REPROC_STREAM_EXTRA(index)` with `reproc_read`, `reproc_readv`,
+`reproc_write_to`, `reproc_pipe_size` and `reproc_close` and
+`REPROC_EVENT_EXTRA(index)` with `reproc_poll` to address the extra stream at
+`index` of `options.extra_streams`.
+*/
+typedef struct reproc_extra_stream {
+  /*! File descriptor of the stream in the child process. Must be larger than 2
+  and may not be used by any other extra stream. */
+  int fd;
+  /*! If `true`, the child process reads from the stream and the parent process
+  writes to it with `reproc_write_to`. Otherwise, the child process writes to
+  the stream and the parent process reads from it with `reproc_read`. */
+  bool input;
+  /*!
+  Where to redirect the stream. `redirect.type` defaults to
+  `REPROC_REDIRECT_PIPE` and may be set to `REPROC_REDIRECT_PIPE`,
+  `REPROC_REDIRECT_SOCKET`, `REPROC_REDIRECT_DISCARD`, `REPROC_REDIRECT_HANDLE`
+  or `REPROC_REDIRECT_FILE`. `adaptive` may not be set.
+  */
+  reproc_redirect redirect;
+} reproc_extra_stream;
+
 typedef struct reproc_options {
   /*!
   `environment` is an array of UTF-8 encoded, NUL-terminated strings that
@@ -203,17 +364,27 @@ typedef struct reproc_options {
   `reproc_poll` return `REPROC_ETIMEDOUT`.
 
   When `deadline` is zero, no deadline is set for the process.
+
+  Deadlines are measured with a monotonic clock so changes to the system time
+  don't make them expire early or late.
   */
   int deadline;
   /*!
   `input` is written to the stdin pipe before the child process is started.
 
-  Because `input` is written to the stdin pipe before the process starts,
-  `input.size` must be smaller than the system's default pipe size (64KB).
+  If `input` doesn't fit in the stdin pipe (64KB by default on Linux), the
+  remainder is written by `reproc_write_input` which `reproc_drain` calls
+  whenever the stdin pipe becomes writable. In that case, `input.data` has to
+  stay valid until all of it has been written or the process is destroyed and
+  `reproc_write` may not be used.
 
   If `input` is set, the stdin pipe is closed after `input` is written to it.
 
-  If `redirect.in` is set, this option may not be set.
+  If `redirect.in.type` is set to `REPROC_REDIRECT_MEMFD`, `input` is copied
+  into a sealed memfd instead which the child process reads as its stdin. In
+  that case, `input.data` only has to stay valid until `reproc_start` returns.
+
+  If `redirect.in` is set to anything else, this option may not be set.
   */
   struct {
     const uint8_t *data;
@@ -232,11 +403,71 @@ typedef struct reproc_options {
   */
   bool fork;
   /*!
+  This option is ignored on Windows.
+
+  `spawn` specifies how the child process is created. When `spawn` is unset,
+  `REPROC_SPAWN_VFORK` is used unless `fork` is enabled, in which case
+  `REPROC_SPAWN_FORK` is used.
+
+  All methods behave the same with respect to redirection, the working
+  directory, the environment, resetting signal handlers and reporting errors
+  that occur before the child process calls `exec`.
+
+  When `fork` is enabled, `spawn` must be unset or `REPROC_SPAWN_FORK`.
+  */
+  REPROC_SPAWN spawn;
+  /*!
   Put pipes created by reproc in nonblocking mode. This makes `reproc_read` and
   `reproc_write` nonblocking operations. If needed, use `reproc_poll` to wait
   until streams becomes readable/writable.
   */
   bool nonblocking;
+  /*!
+  This option is ignored on Windows where `CreateProcess` reports errors
+  directly.
+
+  If `async` is enabled, `reproc_start` returns as soon as the child process has
+  been created instead of waiting until it has called `exec`. Pass
+  `REPROC_EVENT_START` to `reproc_poll` to find out when the child process has
+  called `exec` or failed to do so. If the child process fails to call `exec`,
+  `reproc_wait` returns the error instead of the exit status of the child
+  process.
+
+  When `async` is enabled, `fork` may not be enabled and `spawn` must be unset
+  or `REPROC_SPAWN_FORK`.
+  */
+  bool async;
+  /*!
+  Cache the location of the program specified by `argv[0]` in `cache` when it
+  is searched for in the `PATH` of the child process (i.e. it does not contain a
+  slash). Later calls to `reproc_start` with the same cache skip the search.
+  A cached location is discarded when `PATH` changes or when the file it refers
+  to is replaced or modified.
+
+  On Linux, reproc keeps an `O_PATH` file descriptor to the cached program open
+  and starts it with `execveat`. On other POSIX systems, only the search is
+  skipped. This option is ignored on Windows.
+
+  A cache may not be used by multiple threads at the same time. See
+  `reproc_cache_new`.
+  */
+  reproc_cache_t *cache;
+  /*!
+  This option can only be used on POSIX systems. If enabled on Windows, an error
+  will be returned.
+
+  The `num_extra_streams` streams in `extra_streams` are passed to the child
+  process in addition to its standard streams, for example to give it a data
+  channel on fd 3 that doesn't get mixed up with the logs it writes to stdout.
+  `num_extra_streams` may not exceed `REPROC_EXTRA_STREAMS_MAX`.
+
+  `extra_streams` only has to stay valid until `reproc_start` returns (see
+  `reproc_command_new` for the exception). When `extra_streams` is set, `fork`
+  may not be enabled and `REPROC_SPAWN_HELPER` falls back to
+  `REPROC_SPAWN_FORK`.
+  */
+  const reproc_extra_stream *extra_streams;
+  size_t num_extra_streams;
 } reproc_options;
 
 enum {
@@ -251,8 +482,16 @@ enum {
   /*! The deadline of the process expired. This event is added by default to the
   list of interested events. */
   REPROC_EVENT_DEADLINE = 1 << 4,
+  /*! The process was started with the `async` option and called `exec` or
+  failed to do so. If it failed to call `exec`, `REPROC_EVENT_EXIT` is reported
+  as well and `reproc_wait` returns the error. */
+  REPROC_EVENT_START = 1 << 5,
 };
 
+/*! Data can be written to or read from the extra stream at `index` (see
+`reproc_extra_stream`), depending on its direction. */
+#define REPROC_EVENT_EXTRA(index) (1 << (16 + (index)))
+
 typedef struct reproc_event_source {
   /*! Process to poll for events. */
   reproc_t *process;
@@ -296,6 +535,74 @@ REPROC_EXPORT int reproc_start(reproc_t *process,
                                const char *const *argv,
                                reproc_options options);
 
+/*!
+Starts `num_processes` processes with the same options. `processes[i]` is
+started with `argvs[i]` as if by `reproc_start`.
+
+`options` are only validated once and all child processes are created before
+waiting for any of them to report whether it managed to call `exec`. With
+`REPROC_SPAWN_FORK`, this allows the child processes to get to `exec` in
+parallel. Other spawn methods already wait for `exec` while creating the child
+process so they are started one after the other.
+
+`results[i]` is set to the result of starting `processes[i]`: 1 if it was
+started successfully or a negative error code if it wasn't. Processes that
+failed to start are left in the same state as they would be after a failed call
+to `reproc_start`. `options.fork` may not be set.
+
+Returns the number of processes that were started successfully or a negative
+error code if `options` or `argvs[0]` are invalid, in which case no processes
+are started and `results` is left untouched.
+*/
+REPROC_EXPORT int reproc_start_many(reproc_t *const *processes,
+                                    const char *const *const *argvs,
+                                    size_t num_processes,
+                                    reproc_options options,
+                                    int *results);
+
+/*!
+Prepares a command that can be started many times with `reproc_command_start`.
+
+`argv` and `options` are validated, `argv[0]` is searched for in `PATH` (POSIX
+only) and `argv`, `options.environment`, `options.working_directory` and
+`options.input` are copied once instead of every time the command is started.
+The caller's copies can be released as soon as this function returns. If
+`options.input` doesn't fit in the stdin pipe, the command may not be destroyed
+before all of it has been written to processes started with it. Handles
+and files passed in `options.redirect` and `options.extra_streams` are not
+copied and have to stay valid for as long as the command is used.
+
+Because `argv[0]` is only searched for once, changes to the files in `PATH`
+after the command is created are not picked up. If `options.environment` is
+`NULL`, child processes inherit the environment of the parent process at the
+time they are started. `options.cache` is ignored.
+
+`options.fork` may not be set.
+
+Returns `NULL` if `argv` or `options` are invalid or if not enough memory is
+available.
+*/
+REPROC_EXPORT reproc_command_t *reproc_command_new(const char *const *argv,
+                                                   reproc_options options);
+
+/*!
+`reproc_start` but starts the command prepared by `reproc_command_new`.
+
+A command is never modified after it is created so it can be started from
+multiple threads at the same time.
+*/
+REPROC_EXPORT int reproc_command_start(const reproc_command_t *command,
+                                       reproc_t *process);
+
+/*!
+Releases the memory allocated by `reproc_command_new`. Processes started from
+`command` are not affected.
+
+Does nothing if `command` is `NULL` and always returns `NULL`.
+*/
+REPROC_EXPORT reproc_command_t *
+reproc_command_destroy(reproc_command_t *command);
+
 /*!
 Polls each process in `sources` for its corresponding events in `interests` and
 stores events that occurred for each process in `events`.
@@ -303,6 +610,14 @@ stores events that occurred for each process in `events`.
 Pass `REPROC_INFINITE` to `timeout` to have `reproc_poll` wait forever for an
 event to occur.
 
+`REPROC_EVENT_START` is reported at most once for each process started with the
+`async` option. Polling for it doesn't block on the child process calling
+`exec` so many processes can be started by a single thread at the same time.
+
+If no other events occur before the earliest deadline of the processes in
+`sources` expires, `REPROC_EVENT_DEADLINE` is reported for every process whose
+deadline expired.
+
 Returns `REPROC_EPIPE` if none of the sources have valid pipes remaining that
 can be polled and `REPROC_ETIMEDOUT` if the given timeout expires.
 
@@ -313,9 +628,171 @@ Actionable errors:
 REPROC_EXPORT int
 reproc_poll(reproc_event_source *sources, size_t num_sources, int timeout);
 
+/*! An event reported by `reproc_poller_wait`. */
+typedef struct reproc_poller_event {
+  /*! Process that the events occurred for. */
+  reproc_t *process;
+  /*! Pointer passed to `reproc_poller_add` when `process` was added. */
+  void *context;
+  /*! Combo of `REPROC_EVENT` flags that indicate the events that occurred. */
+  int events;
+} reproc_poller_event;
+
+/*!
+Allocates a new poller on the heap.
+
+`reproc_poll` has to look at every process it's given each time it's called.
+A poller instead remembers the processes added to it, so waiting for events
+only costs time proportional to the amount of processes that have events to
+report. This makes it a better fit for event loops that manage many processes.
+On Linux, a poller is backed by epoll. Elsewhere, it avoids rebuilding the
+list of pipes to poll before every wait.
+
+A poller may only be used by one thread at a time.
+
+Returns `NULL` if not enough memory is available.
+*/
+REPROC_EXPORT reproc_poller_t *reproc_poller_new(void);
+
+/*!
+Adds `process` to `poller` with the events in `interests` (see `REPROC_EVENT`).
+`context` is reported along with the events of `process`.
+
+`process` must have been started and can be added to at most one poller at a
+time. Streams closed by `reproc_close` are removed from `poller` automatically
+and `process` is removed from `poller` when it is destroyed.
+*/
+REPROC_EXPORT int reproc_poller_add(reproc_poller_t *poller,
+                                    reproc_t *process,
+                                    int interests,
+                                    void *context);
+
+/*! Changes the events `poller` waits for on behalf of `process`. */
+REPROC_EXPORT int reproc_poller_modify(reproc_poller_t *poller,
+                                       reproc_t *process,
+                                       int interests);
+
+/*!
+Removes `process` from `poller`. A write queued by `reproc_poller_write` is
+cancelled.
+*/
+REPROC_EXPORT int reproc_poller_remove(reproc_poller_t *poller,
+                                       reproc_t *process);
+
+/*!
+Waits until events occur for the processes added to `poller` and stores up to
+`num_events` of them in `events`, one for each process that has events to
+report. Events are reported the same way as by `reproc_poll`: as long as the
+condition that caused them persists, they are reported again by the next call.
+
+The deadlines of the processes in `poller` are kept in a min-heap so the next
+one to expire is known without looking at every process. On Linux, a poller
+arms a timerfd for the earliest deadline so its expiry is reported like any
+other event. Elsewhere, the timeout of the wait is shortened instead.
+`REPROC_EVENT_DEADLINE` is reported for every process whose deadline expired,
+along with any other events, until the process has been waited for.
+
+Returns the number of events stored in `events`. Returns `REPROC_EPIPE` if
+none of the processes in `poller` have valid pipes remaining that can be polled
+and `REPROC_ETIMEDOUT` if the given timeout expires.
+
+Actionable errors:
+- `REPROC_EPIPE`
+- `REPROC_ETIMEDOUT`
+*/
+REPROC_EXPORT int reproc_poller_wait(reproc_poller_t *poller,
+                                     reproc_poller_event *events,
+                                     size_t num_events,
+                                     int timeout);
+
+/*! A completion reported by `reproc_poller_complete`. */
+typedef struct reproc_completion {
+  /*! Process that the completion belongs to. */
+  reproc_t *process;
+  /*! Pointer passed to `reproc_poller_add` when `process` was added. */
+  void *context;
+  /*!
+  `REPROC_EVENT_IN` for a write queued by `reproc_poller_write`,
+  `REPROC_EVENT_OUT` or `REPROC_EVENT_ERR` for a read and `REPROC_EVENT_EXIT`
+  for the exit of `process`. Any other events are reported as is.
+  */
+  int events;
+  /*!
+  Amount of bytes written or read, the exit status of `process` or a negative
+  error. A read fails with `REPROC_EPIPE` once the child process closes the
+  stream. Zero for other events.
+  */
+  int result;
+  /*!
+  Output read from `process` or `NULL`. Stays valid until the next call to
+  `reproc_poller_complete`.
+  */
+  const uint8_t *data;
+} reproc_completion;
+
+/*!
+Queues a write of up to `size` bytes from `buffer` to the stdin of `process`,
+which has to be in `poller`. `buffer` has to stay valid until the write
+completes. Only one write can be queued per process at a time. Its completion
+is reported by `reproc_poller_complete`.
+
+Returns `REPROC_EPIPE` if stdin of `process` has been closed.
+
+Actionable errors:
+- `REPROC_EPIPE`
+*/
+REPROC_EXPORT int reproc_poller_write(reproc_poller_t *poller,
+                                      reproc_t *process,
+                                      const uint8_t *buffer,
+                                      size_t size);
+
+/*!
+Waits until reads from, writes to or the exit of the processes in `poller`
+complete and stores up to `num_completions` of them in `completions`. Instead
+of reporting that a stream is ready, reproc reads from or writes to it on
+behalf of the caller and reports the result. The exit status of processes that
+are interested in `REPROC_EVENT_EXIT` is reported once they exit. Same as
+`reproc_read` and `reproc_write`, streams are closed once the child process
+closes its end.
+
+On Linux, if reproc is built with `REPROC_IO_URING` and the kernel supports
+it (6.0 or newer), reads and writes are submitted to an io_uring instance.
+Reads from stdout and stderr pick one of the buffers registered with the
+instance and keep reading until the stream is closed (multishot, Linux 6.7 or
+newer) so no system call is made for each chunk of output. Elsewhere, reproc
+falls back to reading from and writing to streams once they are ready, which
+can block on large writes unless `nonblocking` was enabled when `process` was
+started.
+
+Once this function or `reproc_poller_write` has been called, `poller` reports
+its events through this function and `reproc_poller_wait` fails with
+`REPROC_EINVAL`.
+
+Returns the number of completions stored in `completions`. Returns
+`REPROC_EPIPE` if none of the processes in `poller` have valid pipes remaining
+that can be polled and `REPROC_ETIMEDOUT` if the given timeout expires.
+
+Actionable errors:
+- `REPROC_EPIPE`
+- `REPROC_ETIMEDOUT`
+*/
+REPROC_EXPORT int reproc_poller_complete(reproc_poller_t *poller,
+                                         reproc_completion *completions,
+                                         size_t num_completions,
+                                         int timeout);
+
+/*!
+Releases the memory allocated by `reproc_poller_new`. Processes still in
+`poller` are removed from it but are not stopped or destroyed.
+
+Does nothing if `poller` is `NULL` and always returns `NULL`.
+*/
+REPROC_EXPORT reproc_poller_t *reproc_poller_destroy(reproc_poller_t *poller);
+
 /*!
 Reads up to `size` bytes into `buffer` from the child process output stream
-indicated by `stream`.
+indicated by `stream`. `stream` can be stdout, stderr or an extra stream that
+the child process writes to.
 
 Actionable errors:
 - `REPROC_EPIPE`
@@ -326,6 +803,29 @@ REPROC_EXPORT int reproc_read(reproc_t *process,
                               uint8_t *buffer,
                               size_t size);
 
+/*! A buffer used by `reproc_readv` and `reproc_writev`. */
+typedef struct reproc_iovec {
+  uint8_t *data;
+  size_t size;
+} reproc_iovec;
+
+/*!
+`reproc_read` but reads into the `num_buffers` buffers in `buffers` with a
+single system call. The first buffer is filled before data is read into the
+next buffer.
+
+Returns the total amount of bytes read. At most the first 64 buffers are used
+by a single call.
+
+Actionable errors:
+- `REPROC_EPIPE`
+- `REPROC_EWOULDBLOCK`
+*/
+REPROC_EXPORT int reproc_readv(reproc_t *process,
+                               REPROC_STREAM stream,
+                               const reproc_iovec *buffers,
+                               size_t num_buffers);
+
 /*!
 Writes up to `size` bytes from `buffer` to the standard input (stdin) of the
 child process.
@@ -349,7 +849,145 @@ REPROC_EXPORT int
 reproc_write(reproc_t *process, const uint8_t *buffer, size_t size);
 
 /*!
-Closes the child process standard stream indicated by `stream`.
+`reproc_write` but writes to the child process input stream indicated by
+`stream`, which can be stdin or an extra stream that the child process reads
+from (see `reproc_extra_stream`).
+
+Actionable errors:
+- `REPROC_EPIPE`
+- `REPROC_EWOULDBLOCK`
+*/
+REPROC_EXPORT int reproc_write_to(reproc_t *process,
+                                  REPROC_STREAM stream,
+                                  const uint8_t *buffer,
+                                  size_t size);
+
+/*!
+`reproc_write` but writes the `num_buffers` buffers in `buffers` one after the
+other with a single system call. `reproc_writev` only reads from the buffers.
+
+Returns the total amount of bytes written, which can be less than the sum of
+the sizes of the buffers. At most the first 64 buffers are used by a single
+call.
+
+Actionable errors:
+- `REPROC_EPIPE`
+- `REPROC_EWOULDBLOCK`
+*/
+REPROC_EXPORT int reproc_writev(reproc_t *process,
+                                const reproc_iovec *buffers,
+                                size_t num_buffers);
+
+/*!
+`reproc_write` but on Linux, the pages of `buffer` are gifted to the stdin pipe
+of the child process with `vmsplice` and `SPLICE_F_GIFT` instead of being copied
+into it. This avoids copying large buffers.
+
+Because the pipe references the pages of `buffer` until the child process has
+read the data, the bytes that were written (as indicated by the return value)
+belong to the kernel once this function returns. They may not be modified again
+and the memory they reside in may not be reused, which includes returning it to
+`malloc` with `free`. The memory may be unmapped with `munmap` right away since
+the pipe keeps its own reference to the pages. The easiest way to fulfill these
+requirements is to allocate the buffer with `mmap` and unmap it once all of it
+has been written. For best results, `buffer` and `size` should be page-aligned.
+
+On other platforms, `buffer` is copied like in `reproc_write` but the same rules
+should be followed to stay portable.
+
+Actionable errors:
+- `REPROC_EPIPE`
+- `REPROC_EWOULDBLOCK`
+*/
+REPROC_EXPORT int
+reproc_write_gift(reproc_t *process, const uint8_t *buffer, size_t size);
+
+/*!
+Writes as much of the part of `options.input` that didn't fit in the stdin pipe
+when the child process was started as the stdin pipe can take without blocking.
+The stdin pipe is closed once all of `options.input` has been written. If the
+child process closes stdin before reading all of `options.input`, the rest of it
+is discarded (see `reproc_write` for how `SIGPIPE` affects this).
+
+Returns 1 if part of `options.input` remains to be written and 0 otherwise. Call
+this function when `reproc_poll` reports `REPROC_EVENT_IN` while it returns 1.
+`reproc_drain` does this automatically.
+*/
+REPROC_EXPORT int reproc_write_input(reproc_t *process);
+
+/*!
+Returns the capacity in bytes of the pipe that `stream` of the child process is
+redirected to (see `reproc_redirect.pipe_size`).
+
+Returns 0 on POSIX systems other than Linux where the capacity of a pipe can't
+be queried.
+
+Actionable errors:
+- `REPROC_EPIPE`: `stream` isn't redirected to a pipe or was closed.
+*/
+REPROC_EXPORT int reproc_pipe_size(reproc_t *process, REPROC_STREAM stream);
+
+/*!
+Stores the parent's end of `stream` of the child process in `handle` so it can
+be registered with an external event loop (epoll, libuv, asio, ...) instead of
+waiting on it with `reproc_poll`. Pass `REPROC_STREAM_EXIT` to get the handle
+that becomes readable when the child process exits. On POSIX, this is a pidfd
+or the read end of a pipe. On Windows, all handles are sockets.
+
+The handle stays the same until reproc closes it. This happens when `stream`
+is closed with `reproc_close`, when `reproc_read` or `reproc_write` return
+`REPROC_EPIPE`, when `reproc_wait` collects the exit status and when the process
+is destroyed. The handle is owned by reproc: use `reproc_read` and
+`reproc_write` to transfer data and never close it yourself.
+
+To use an edge-triggered event loop, enable `options.nonblocking` and keep
+calling `reproc_read` or `reproc_write` after each notification until it
+returns `REPROC_EWOULDBLOCK`.
+
+Actionable errors:
+- `REPROC_EPIPE`: `stream` isn't redirected to a pipe or was closed. For
+  `REPROC_STREAM_EXIT`, this is also returned if the reaper tells reproc when
+  the child process exits (see `reproc_reaper_start`).
+*/
+REPROC_EXPORT int reproc_handle_of(reproc_t *process,
+                                   REPROC_STREAM stream,
+                                   reproc_handle *handle);
+
+/*!
+Creates an anonymous file that contains a copy of `data` and stores its handle
+in `handle`. On Linux, the file is a memfd that is sealed so its contents can't
+be changed anymore. Elsewhere, it's a temporary file that is deleted once all
+handles to it are closed.
+
+Pass the handle in `redirect.in.handle` together with `REPROC_REDIRECT_MEMFD`
+to give any number of child processes the same stdin while only copying it
+once. Each child process gets its own file offset and reads the file from the
+start. The handle may be closed (`close` on POSIX, `CloseHandle` on Windows)
+as soon as the child processes have been started.
+*/
+REPROC_EXPORT int
+reproc_memfd_new(const uint8_t *data, size_t size, reproc_handle *handle);
+
+/*!
+Maps the output written to `stream` of the child process into memory and
+stores its location and size in `data` and `size`. `stream` must have been
+redirected to `REPROC_REDIRECT_MEMFD` and the child process must have exited
+(`reproc_wait` returned its exit status).
+
+The memory is read-only and stays valid until `process` is destroyed with
+`reproc_destroy`. If the child process didn't write anything to `stream`,
+`data` is set to `NULL` and `size` to zero.
+
+Note that any process that inherited `stream` from the child process might
+still be writing to it.
+*/
+REPROC_EXPORT int reproc_capture(reproc_t *process,
+                                 REPROC_STREAM stream,
+                                 const uint8_t **data,
+                                 size_t *size);
+
+/*!
+Closes the child process standard or extra stream indicated by `stream`.
 
 This function is necessary when a child process reads from stdin until it is
 closed. After writing all the input to the child process using `reproc_write`,
@@ -443,6 +1081,87 @@ Example: `process = reproc_destroy(process)`.
 */
 REPROC_EXPORT reproc_t *reproc_destroy(reproc_t *process);
 
+/*!
+Starts the spawn helper process if it isn't running yet (Linux only).
+
+Creating a child process from a process that uses a lot of memory or runs many
+threads is expensive. The spawn helper is a process forked from the current
+process that creates child processes on its behalf when `REPROC_SPAWN_HELPER` is
+used. Because the helper is a copy of the current process, call this function
+at the start of `main`, before the current process allocates a lot of memory or
+starts other threads. Alternatively, build reproc with
+`REPROC_HELPER_CONSTRUCTOR` to start the helper when reproc is loaded.
+
+The helper is never started implicitly. If it isn't running (or was started by
+another process that the current process was forked from),
+`REPROC_SPAWN_HELPER` falls back to `REPROC_SPAWN_VFORK`.
+
+Does nothing on other platforms.
+*/
+REPROC_EXPORT int reproc_helper_start(void);
+
+/*!
+Stops the spawn helper process and waits for it to exit. Child processes started
+by the helper are not affected. The helper exits automatically when the current
+process exits.
+*/
+REPROC_EXPORT int reproc_helper_stop(void);
+
+/*!
+Starts the process-wide reaper (POSIX only).
+
+By default, reproc finds out when a child process exits through a pidfd (Linux
+5.3+) or an exit pipe, which costs one or two file descriptors per child
+process. When the reaper is running, child processes started afterwards don't
+get one. Instead, the reaper installs a `SIGCHLD` handler that writes to a
+single self-pipe. `reproc_poll` and `reproc_wait` poll the self-pipe, reap all
+exited child processes with `waitid(P_ALL)` when it becomes readable and
+dispatch the exit statuses to the corresponding `reproc_t` instances.
+
+Keep in mind that:
+- The previous `SIGCHLD` handler is replaced until `reproc_reaper_stop` is
+called.
+- All child processes of the current process are reaped, including ones that
+were not started by reproc while the reaper is running. The exit statuses of
+processes started by reproc without the reaper are kept until `reproc_wait`
+asks for them. The exit statuses of child processes not started by reproc are
+discarded and `waitpid` fails with `ECHILD` for them.
+- `SIGCHLD` interrupts blocking system calls that aren't restarted by
+`SA_RESTART` (e.g. `poll`) in other code running in the current process.
+
+If reproc is built with `REPROC_MULTITHREADED` (the default), the reaper's state
+is protected by a mutex and processes started while it is running can be
+started, polled, waited on and destroyed from multiple threads at the same time.
+A thread that collects exit statuses wakes up the other threads polling the
+self-pipe. Without `REPROC_MULTITHREADED`, the reaper may only be used from a
+single thread.
+
+Processes forked from the current process (e.g. using the `fork` option) don't
+inherit the reaper.
+*/
+REPROC_EXPORT int reproc_reaper_start(void);
+
+/*!
+Stops the reaper and restores the previous `SIGCHLD` handler. Returns
+`EBUSY` (negated) if processes started while the reaper was running haven't
+been waited on or destroyed yet.
+*/
+REPROC_EXPORT int reproc_reaper_stop(void);
+
+/*! Allocate a new, empty `reproc_cache_t` instance on the heap. */
+REPROC_EXPORT reproc_cache_t *reproc_cache_new(void);
+
+/*!
+Release all resources associated with `cache`. `cache` must not be in use by
+`reproc_start` when it is destroyed but it can be destroyed while processes
+started with it are still running.
+
+Does nothing if `cache` is `NULL` and always returns `NULL`.
+
+Example: `cache = reproc_cache_destroy(cache)`.
+*/
+REPROC_EXPORT reproc_cache_t *reproc_cache_destroy(reproc_cache_t *cache);
+
 /*!
 Returns a string describing `error`. This string must not be modified by the
 caller.
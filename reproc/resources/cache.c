@@ -0,0 +1,7 @@
+#include <stdio.h>
+
+int main(void)
+{
+  printf("cache");
+  return 0;
+}
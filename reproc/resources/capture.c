@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Writes the amount of bytes given in `argv[1]` to stdout and "capture" to
+// stderr. If `argv[2]` is given, waits for stdin to close before exiting.
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    return 1;
+  }
+
+  long size = atol(argv[1]);
+
+  for (long i = 0; i < size; i++) {
+    if (putchar('a' + (int) (i % 26)) == EOF) {
+      return 1;
+    }
+  }
+
+  fputs("capture", stderr);
+
+  if (argc > 2) {
+    while (getchar() != EOF) {
+      ;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+// Waits until stdin is closed.
+int main(void)
+{
+  char input[256];
+
+  while (fread(input, 1, sizeof(input), stdin) > 0) {
+    continue;
+  }
+
+  return 0;
+}
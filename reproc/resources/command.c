@@ -0,0 +1,19 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    return 1;
+  }
+
+  const char *value = getenv("REPROC");
+  printf("%s %s ", argv[1], value == NULL ? "" : value);
+
+  int c = 0;
+  while ((c = getchar()) != EOF) {
+    putchar(c);
+  }
+
+  return 0;
+}
@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Echoes stdin to stdout, writes its argument to stderr and exits with it.
+int main(int argc, const char **argv)
+{
+  if (argc != 2) {
+    return EXIT_FAILURE;
+  }
+
+  int c = 0;
+
+  while ((c = getchar()) != EOF) {
+    putchar(c);
+  }
+
+  fprintf(stderr, "%s", argv[1]);
+
+  return atoi(argv[1]);
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Writes the amount of bytes given in `argv[1]` to stdout and a message to
+// stderr. Without arguments, waits until stdin is closed instead.
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    while (getchar() != EOF) {
+    }
+
+    return 0;
+  }
+
+  long size = atol(argv[1]);
+
+  for (long i = 0; i < size; i++) {
+    putchar((int) (i % 251));
+  }
+
+  fputs("stderr", stderr);
+
+  return 0;
+}
@@ -0,0 +1,39 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// "copy IN OUT": Copies file descriptor IN to file descriptor OUT.
+// "write FD TEXT...": Writes each TEXT to the FD before it.
+// Either way, "log" is written to stdout afterwards.
+int main(int argc, const char **argv)
+{
+  if (argc > 3 && strcmp(argv[1], "copy") == 0) {
+    int in = atoi(argv[2]);
+    int out = atoi(argv[3]);
+
+    char buffer[4096];
+    ssize_t r = 0;
+
+    while ((r = read(in, buffer, sizeof(buffer))) > 0) {
+      if (write(out, buffer, (size_t) r) != r) {
+        return 1;
+      }
+    }
+
+    if (r < 0) {
+      return 1;
+    }
+  } else if (argc > 1 && strcmp(argv[1], "write") == 0) {
+    for (int i = 2; i + 1 < argc; i += 2) {
+      size_t size = strlen(argv[i + 1]);
+
+      if (write(atoi(argv[i]), argv[i + 1], size) != (ssize_t) size) {
+        return 1;
+      }
+    }
+  } else {
+    return 1;
+  }
+
+  return write(STDOUT_FILENO, "log", 3) == 3 ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Writes more than fits in a pipe so the parent has to read it in turns.
+int main(void)
+{
+  static char buffer[1 << 20];
+  memset(buffer, 'x', sizeof(buffer));
+
+  if (fwrite(buffer, 1, sizeof(buffer), stdout) != sizeof(buffer)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "block") == 0) {
+    // Block until stdin is closed.
+    while (getchar() != EOF) {
+    }
+
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "ppid") == 0) {
+    printf("%ld", (long) getppid());
+    return 0;
+  }
+
+  char working_directory[8096];
+
+  if (getcwd(working_directory, sizeof(working_directory)) == NULL) {
+    return 1;
+  }
+
+  const char *value = getenv("REPROC");
+
+  printf("%s%s", working_directory, value == NULL ? "" : value);
+
+  return 0;
+}
@@ -0,0 +1,16 @@
+#include <stdio.h>
+
+// Copies stdin to stdout while reading it.
+int main(void)
+{
+  char buffer[4096];
+  size_t size = 0;
+
+  while ((size = fread(buffer, 1, sizeof(buffer), stdin)) > 0) {
+    if (fwrite(buffer, 1, size, stdout) != size) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,15 @@
+#include <stdio.h>
+
+// Copies stdin to stdout.
+int main(void)
+{
+  int c = 0;
+
+  while ((c = getchar()) != EOF) {
+    if (putchar(c) == EOF) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,20 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <unistd.h>
+
+// Leaves a grandchild process behind that inherits all our file descriptors and
+// keeps running after we exit.
+int main(void)
+{
+  pid_t pid = fork();
+  if (pid < 0) {
+    return EXIT_FAILURE;
+  }
+
+  if (pid == 0) {
+    sleep(2);
+  }
+
+  return EXIT_SUCCESS;
+}
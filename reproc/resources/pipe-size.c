@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Writes the amount of bytes given in `argv[1]` to stdout as fast as possible.
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    return 1;
+  }
+
+  static char buffer[1 << 16];
+  long size = atol(argv[1]);
+
+  memset(buffer, 'x', sizeof(buffer));
+
+  while (size > 0) {
+    size_t chunk = (size_t) size < sizeof(buffer) ? (size_t) size
+                                                  : sizeof(buffer);
+
+    if (fwrite(buffer, 1, chunk, stdout) != chunk) {
+      return 1;
+    }
+
+    size -= (long) chunk;
+  }
+
+  return 0;
+}
@@ -0,0 +1,21 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+// Copies stdin to stdout in upper case. With "count", exits with the amount of
+// bytes read from stdin instead.
+int main(int argc, char *argv[])
+{
+  int count = 0;
+  int c = 0;
+
+  while ((c = getchar()) != EOF) {
+    count++;
+
+    if (argc < 2 || strcmp(argv[1], "count") != 0) {
+      putchar(toupper(c));
+    }
+  }
+
+  return count;
+}
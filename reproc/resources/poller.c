@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+// Waits until stdin is closed before writing its argument to stdout.
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    return 1;
+  }
+
+  char input[256];
+
+  while (fread(input, 1, sizeof(input), stdin) > 0) {
+    continue;
+  }
+
+  fprintf(stdout, "%s", argv[1]);
+
+  return 0;
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    return 255;
+  }
+
+  printf("%s", argv[1]);
+
+  return atoi(argv[1]);
+}
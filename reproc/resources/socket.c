@@ -0,0 +1,23 @@
+#include <string.h>
+#include <unistd.h>
+
+// Copies stdin to stdout. With "close", closes stdin and exits once it has
+// told the parent by writing "closed" to stdout.
+int main(int argc, const char **argv)
+{
+  if (argc > 1 && strcmp(argv[1], "close") == 0) {
+    close(STDIN_FILENO);
+    return write(STDOUT_FILENO, "closed", 6) == 6 ? 0 : 1;
+  }
+
+  char buffer[4096];
+  ssize_t r = 0;
+
+  while ((r = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+    if (write(STDOUT_FILENO, buffer, (size_t) r) != r) {
+      return 1;
+    }
+  }
+
+  return r < 0 ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+#include <stdlib.h>
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    return 255;
+  }
+
+  return atoi(argv[1]);
+}
@@ -0,0 +1,23 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Verifies that stdin contains the amount of bytes given in `argv[1]` following
+// the pattern written by the write-gift test.
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    return 1;
+  }
+
+  long size = atol(argv[1]);
+  long i = 0;
+  int c = 0;
+
+  for (i = 0; (c = getchar()) != EOF; i++) {
+    if (c != (int) (i % 251)) {
+      return 1;
+    }
+  }
+
+  return i == size ? 0 : 1;
+}
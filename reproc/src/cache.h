@@ -0,0 +1,30 @@
+#pragma once
+
+#include "handle.h"
+
+// `reproc_cache_t` is defined separately for each platform.
+typedef struct reproc_cache_t cache_type;
+
+// Allocates a new empty cache. Returns `NULL` if not enough memory is
+// available.
+cache_type *cache_new(void);
+
+// Resolves `program` against the `PATH` of `environment` (or the current
+// process environment if `environment` is `NULL`) and stores the result in
+// `cache`. `working_directory` is the working directory option of the child
+// process which is used to resolve relative `PATH` entries.
+//
+// If `program` was found, `path` is set to its absolute path and `fd` is set to
+// a file descriptor that refers to it (or `HANDLE_INVALID` if not supported).
+// Both remain owned by `cache` and stay valid until the next call to this
+// function with the same cache. If `program` contains a slash or could not be
+// found, `path` is set to `NULL` and `fd` is set to `HANDLE_INVALID` so the
+// regular lookup can report the error in the child process.
+int cache_resolve(cache_type *cache,
+                  const char *program,
+                  const char *const *environment,
+                  const char *working_directory,
+                  const char **path,
+                  handle_type *fd);
+
+cache_type *cache_destroy(cache_type *cache);
@@ -0,0 +1,341 @@
+#define _POSIX_C_SOURCE 200809L
+
+#if defined(__linux__)
+  // `O_PATH`.
+  #define _GNU_SOURCE
+#endif
+
+#include "cache.h"
+
+#include "error.h"
+#include "process.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct entry {
+  // The lookup key. `directory` is only set if `PATH` contains relative entries
+  // since the result of the lookup doesn't depend on the working directory
+  // otherwise.
+  char *program;
+  char *search_path;
+  char *directory;
+  // The result of the lookup.
+  char *path;
+  int fd;
+  // Used to detect if `path` was replaced or modified since it was resolved.
+  struct {
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+  } identity;
+};
+
+struct reproc_cache_t {
+  struct entry *entries;
+  size_t size;
+  size_t capacity;
+};
+
+static bool string_equal(const char *first, const char *second)
+{
+  if (first == NULL || second == NULL) {
+    return first == second;
+  }
+
+  return strcmp(first, second) == 0;
+}
+
+// Returns true if `search_path` contains an entry that is resolved relative to
+// the working directory of the child process. An empty entry indicates the
+// working directory itself.
+static bool search_path_is_relative(const char *search_path)
+{
+  const char *begin = search_path;
+
+  while (true) {
+    if (*begin != '/') {
+      return true;
+    }
+
+    begin = strchr(begin, ':');
+    if (begin == NULL) {
+      return false;
+    }
+
+    begin++;
+  }
+}
+
+// Returns the absolute working directory of the child process. The caller is
+// responsible for freeing the result of this function. If an error occurs,
+// `NULL` is returned and `errno` is set to indicate the error.
+static char *child_directory(const char *working_directory)
+{
+  if (working_directory != NULL && working_directory[0] == '/') {
+    return strdup(working_directory);
+  }
+
+  char cwd[PATH_MAX];
+
+  if (getcwd(cwd, sizeof(cwd)) == NULL) {
+    return NULL;
+  }
+
+  if (working_directory == NULL) {
+    return strdup(cwd);
+  }
+
+  size_t cwd_size = strlen(cwd);
+  size_t working_directory_size = strlen(working_directory);
+
+  // +2 for the separator and the NUL terminator.
+  char *directory = malloc(cwd_size + working_directory_size + 2);
+  if (directory == NULL) {
+    return NULL;
+  }
+
+  memcpy(directory, cwd, cwd_size);
+  directory[cwd_size] = '/';
+  memcpy(directory + cwd_size + 1, working_directory,
+         working_directory_size + 1);
+
+  return directory;
+}
+
+static void entry_destroy(struct entry *entry)
+{
+  free(entry->program);
+  free(entry->search_path);
+  free(entry->directory);
+  free(entry->path);
+  handle_destroy(entry->fd);
+}
+
+// Returns true if `entry->path` still refers to the file that was resolved.
+static bool entry_valid(const struct entry *entry)
+{
+  struct stat info;
+
+  if (stat(entry->path, &info) < 0) {
+    return false;
+  }
+
+  return info.st_dev == entry->identity.dev &&
+         info.st_ino == entry->identity.ino &&
+         info.st_mtim.tv_sec == entry->identity.mtime.tv_sec &&
+         info.st_mtim.tv_nsec == entry->identity.mtime.tv_nsec;
+}
+
+// Searches `entry->search_path` for `entry->program` the same way
+// `process_exec` does and fills in the result fields of `entry`. Returns 1 if
+// `entry->program` was found and 0 if it wasn't.
+static int entry_resolve(struct entry *entry)
+{
+  char buffer[PATH_MAX];
+  size_t program_size = strlen(entry->program);
+  size_t directory_size = entry->directory ? strlen(entry->directory) : 0;
+  struct stat info;
+
+  const char *begin = entry->search_path;
+  bool found = false;
+
+  while (!found) {
+    const char *end = begin;
+    while (*end != ':' && *end != '\0') {
+      end++;
+    }
+
+    size_t entry_size = (size_t)(end - begin);
+    size_t size = 0;
+
+    // +3 for the separators and the NUL terminator.
+    if (directory_size + entry_size + program_size + 3 <= sizeof(buffer)) {
+      if (*begin != '/') {
+        assert(entry->directory);
+        memcpy(buffer, entry->directory, directory_size);
+        buffer[directory_size] = '/';
+        size += directory_size + 1;
+      }
+
+      memcpy(buffer + size, begin, entry_size);
+      size += entry_size;
+
+      if (entry_size > 0) {
+        buffer[size++] = '/';
+      }
+
+      memcpy(buffer + size, entry->program, program_size + 1);
+
+      // Directories and files we're not allowed to execute are skipped by
+      // `execvp` as well.
+      found = stat(buffer, &info) == 0 && S_ISREG(info.st_mode) &&
+              faccessat(AT_FDCWD, buffer, X_OK, AT_EACCESS) == 0;
+    }
+
+    if (*end == '\0') {
+      break;
+    }
+
+    begin = end + 1;
+  }
+
+  if (!found) {
+    return 0;
+  }
+
+  entry->path = strdup(buffer);
+  if (entry->path == NULL) {
+    return -1;
+  }
+
+#if defined(__linux__)
+  // An `O_PATH` file descriptor doesn't need read permissions and allows the
+  // child process to call `execveat` without resolving `path` again.
+  entry->fd = open(buffer, O_PATH | O_CLOEXEC);
+  if (entry->fd < 0) {
+    return -1;
+  }
+
+  // Take the identity from the file we actually opened.
+  int r = fstat(entry->fd, &info);
+  if (r < 0) {
+    return r;
+  }
+#endif
+
+  entry->identity.dev = info.st_dev;
+  entry->identity.ino = info.st_ino;
+  entry->identity.mtime = info.st_mtim;
+
+  return 1;
+}
+
+cache_type *cache_new(void)
+{
+  return calloc(1, sizeof(cache_type));
+}
+
+int cache_resolve(cache_type *cache,
+                  const char *program,
+                  const char *const *environment,
+                  const char *working_directory,
+                  const char **path,
+                  handle_type *fd)
+{
+  assert(cache);
+  assert(program);
+  assert(path);
+  assert(fd);
+
+  *path = NULL;
+  *fd = HANDLE_INVALID;
+
+  // Programs that contain a slash aren't searched for in `PATH`.
+  if (strchr(program, '/') != NULL) {
+    return 0;
+  }
+
+  const char *search_path = process_path(environment);
+  struct entry *entry = NULL;
+  char *directory = NULL;
+  int r = -1;
+
+  if (search_path_is_relative(search_path)) {
+    directory = child_directory(working_directory);
+    if (directory == NULL) {
+      goto finish;
+    }
+  }
+
+  for (size_t i = 0; i < cache->size; i++) {
+    if (strcmp(cache->entries[i].program, program) == 0 &&
+        string_equal(cache->entries[i].directory, directory)) {
+      entry = &cache->entries[i];
+      break;
+    }
+  }
+
+  if (entry != NULL) {
+    if (strcmp(entry->search_path, search_path) == 0 && entry_valid(entry)) {
+      r = 0;
+      goto finish;
+    }
+
+    // `PATH` changed or the executable was replaced or modified since we
+    // resolved it so we evict the entry and resolve `program` again.
+    entry_destroy(entry);
+    *entry = cache->entries[--cache->size];
+    entry = NULL;
+  }
+
+  if (cache->size == cache->capacity) {
+    size_t capacity = cache->capacity == 0 ? 8 : cache->capacity * 2;
+    struct entry *entries = realloc(cache->entries,
+                                    capacity * sizeof(struct entry));
+    if (entries == NULL) {
+      r = -1;
+      goto finish;
+    }
+
+    cache->entries = entries;
+    cache->capacity = capacity;
+  }
+
+  struct entry resolved = { .program = strdup(program),
+                            .search_path = strdup(search_path),
+                            .directory = directory,
+                            .fd = HANDLE_INVALID };
+  directory = NULL;
+
+  if (resolved.program == NULL || resolved.search_path == NULL) {
+    entry_destroy(&resolved);
+    r = -1;
+    goto finish;
+  }
+
+  r = entry_resolve(&resolved);
+  if (r <= 0) {
+    // If `program` wasn't found, we leave it to the child process to report
+    // the error.
+    entry_destroy(&resolved);
+    goto finish;
+  }
+
+  cache->entries[cache->size] = resolved;
+  entry = &cache->entries[cache->size++];
+  r = 0;
+
+finish:
+  free(directory);
+
+  if (entry != NULL) {
+    *path = entry->path;
+    *fd = entry->fd;
+  }
+
+  return error_unify(r);
+}
+
+cache_type *cache_destroy(cache_type *cache)
+{
+  if (cache == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < cache->size; i++) {
+    entry_destroy(&cache->entries[i]);
+  }
+
+  free(cache->entries);
+  free(cache);
+
+  return NULL;
+}
@@ -0,0 +1,38 @@
+#include "cache.h"
+
+#include <stdlib.h>
+
+// `CreateProcess` does its own executable lookup so there's nothing to cache on
+// Windows.
+struct reproc_cache_t {
+  char unused;
+};
+
+cache_type *cache_new(void)
+{
+  return calloc(1, sizeof(cache_type));
+}
+
+int cache_resolve(cache_type *cache,
+                  const char *program,
+                  const char *const *environment,
+                  const char *working_directory,
+                  const char **path,
+                  handle_type *fd)
+{
+  (void) cache;
+  (void) program;
+  (void) environment;
+  (void) working_directory;
+
+  *path = NULL;
+  *fd = HANDLE_INVALID;
+
+  return 0;
+}
+
+cache_type *cache_destroy(cache_type *cache)
+{
+  free(cache);
+  return NULL;
+}
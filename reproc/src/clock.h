@@ -2,4 +2,7 @@
 
 #include <stdint.h>
 
+// Returns the current time in milliseconds on a clock that isn't affected by
+// changes to the system time. Only differences between two results are
+// meaningful.
 int64_t reproc_now(void);
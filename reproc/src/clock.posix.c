@@ -11,7 +11,9 @@ int64_t reproc_now(void)
 {
   struct timespec timespec = { 0 };
 
-  int r = clock_gettime(CLOCK_REALTIME, &timespec);
+  // Deadlines are relative to when a process starts so they shouldn't move
+  // when the system time is changed or stepped by NTP.
+  int r = clock_gettime(CLOCK_MONOTONIC, &timespec);
   ASSERT_UNUSED(r == 0);
 
   return timespec.tv_sec * 1000 + timespec.tv_nsec / 1000000;
@@ -2,6 +2,8 @@
 
 #include "error.h"
 #include "macro.h"
+#include "pipe.h"
+#include "state.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -30,11 +32,19 @@ int reproc_drain(reproc_t *process, reproc_sink out, reproc_sink err)
     return r;
   }
 
+  // Part of `options.input` might not have fit in the stdin pipe.
+  r = reproc_write_input(process);
+  if (r < 0) {
+    return r;
+  }
+
+  bool input = r > 0;
   uint8_t buffer[4096];
 
   while (true) {
-    reproc_event_source source = { process, REPROC_EVENT_OUT | REPROC_EVENT_ERR,
-                                   0 };
+    int interests = REPROC_EVENT_OUT | REPROC_EVENT_ERR |
+                    (input ? REPROC_EVENT_IN : 0);
+    reproc_event_source source = { process, interests, 0 };
 
     r = reproc_poll(&source, 1, REPROC_INFINITE);
     if (r < 0) {
@@ -47,6 +57,19 @@ int reproc_drain(reproc_t *process, reproc_sink out, reproc_sink err)
       break;
     }
 
+    if (source.events & REPROC_EVENT_IN) {
+      r = reproc_write_input(process);
+      if (r < 0) {
+        break;
+      }
+
+      input = r > 0;
+
+      if (!(source.events & (REPROC_EVENT_OUT | REPROC_EVENT_ERR))) {
+        continue;
+      }
+    }
+
     REPROC_STREAM stream = source.events & REPROC_EVENT_OUT ? REPROC_STREAM_OUT
                                                             : REPROC_STREAM_ERR;
 
@@ -119,3 +142,67 @@ void *reproc_free(void *ptr)
   free(ptr);
   return NULL;
 }
+
+int reproc_drain_to_fd(reproc_t *process, reproc_handle out, reproc_handle err)
+{
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+  ASSERT_EINVAL(process->pipe.out == PIPE_INVALID || out != HANDLE_INVALID);
+  ASSERT_EINVAL(process->pipe.err == PIPE_INVALID || err != HANDLE_INVALID);
+
+  // `out` and `err` might not both support `splice`.
+  bool spliceable[] = { true, true };
+  int r = -1;
+
+  while (true) {
+    int interests = REPROC_EVENT_OUT | REPROC_EVENT_ERR |
+                    (process->input.size > 0 ? REPROC_EVENT_IN : 0);
+    reproc_event_source source = { process, interests, 0 };
+
+    r = reproc_poll(&source, 1, REPROC_INFINITE);
+    if (r < 0) {
+      r = r == REPROC_EPIPE ? 0 : r;
+      break;
+    }
+
+    if (source.events & REPROC_EVENT_DEADLINE) {
+      r = REPROC_ETIMEDOUT;
+      break;
+    }
+
+    if (source.events & REPROC_EVENT_IN) {
+      r = write_input(process);
+      if (r < 0) {
+        break;
+      }
+
+      if (!(source.events & (REPROC_EVENT_OUT | REPROC_EVENT_ERR))) {
+        continue;
+      }
+    }
+
+    bool is_out = source.events & REPROC_EVENT_OUT;
+    REPROC_STREAM stream = is_out ? REPROC_STREAM_OUT : REPROC_STREAM_ERR;
+    pipe_type *pipe = output_pipe(process, stream);
+
+    // A pipe holds 64K by default on Linux.
+    size_t size = process->adaptive[!is_out].enabled
+                      ? process->adaptive[!is_out].size
+                      : 1 << 16;
+
+    r = pipe_splice(*pipe, is_out ? out : err, size, &spliceable[!is_out]);
+
+    if (r == REPROC_EPIPE) {
+      close_stream(process, stream);
+      continue;
+    }
+
+    adapt(process, stream, size, r);
+
+    if (r < 0) {
+      break;
+    }
+  }
+
+  return r;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #if defined(_WIN32)
@@ -18,3 +20,11 @@ int handle_cloexec(handle_type handle, bool enable);
 // Does not overwrite the last system error if an error occurs while closing
 // `handle`.
 handle_type handle_destroy(handle_type handle);
+
+// Maps the contents of the file indicated by `handle` into memory (read-only)
+// and stores its location and size in `data` and `size`. `data` is set to
+// `NULL` if the file is empty.
+int handle_map(handle_type handle, const uint8_t **data, size_t *size);
+
+// Unmaps memory mapped by `handle_map`.
+void handle_unmap(const uint8_t *data, size_t size);
@@ -7,6 +7,8 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 const int HANDLE_INVALID = -1;
@@ -43,3 +45,46 @@ int handle_destroy(int handle)
 
   return HANDLE_INVALID;
 }
+
+int handle_map(int handle, const uint8_t **data, size_t *size)
+{
+  assert(handle != HANDLE_INVALID);
+  assert(data);
+  assert(size);
+
+  struct stat info = { 0 };
+  int r = -1;
+
+  r = fstat(handle, &info);
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  if (info.st_size == 0) {
+    // `mmap` doesn't accept a length of zero.
+    *data = NULL;
+    *size = 0;
+    return 0;
+  }
+
+  void *result = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED,
+                      handle, 0);
+  if (result == MAP_FAILED) {
+    return error_unify(-1);
+  }
+
+  *data = result;
+  *size = (size_t) info.st_size;
+
+  return 0;
+}
+
+void handle_unmap(const uint8_t *data, size_t size)
+{
+  if (data == NULL) {
+    return;
+  }
+
+  int r = munmap((void *) data, size);
+  ASSERT_UNUSED(r == 0);
+}
@@ -29,3 +29,57 @@ HANDLE handle_destroy(HANDLE handle)
 
   return HANDLE_INVALID;
 }
+
+int handle_map(HANDLE handle, const uint8_t **data, size_t *size)
+{
+  assert(handle != HANDLE_INVALID);
+  assert(data);
+  assert(size);
+
+  LARGE_INTEGER file_size = { 0 };
+  int r = 0;
+
+  r = GetFileSizeEx(handle, &file_size);
+  if (r == 0) {
+    return error_unify(r);
+  }
+
+  if (file_size.QuadPart == 0) {
+    // `CreateFileMapping` doesn't accept empty files.
+    *data = NULL;
+    *size = 0;
+    return 0;
+  }
+
+  HANDLE mapping = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    return error_unify(r);
+  }
+
+  void *result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+  // The view keeps the mapping alive so we can close its handle right away.
+  r = result != NULL;
+  handle_destroy(mapping);
+
+  if (r == 0) {
+    return error_unify(r);
+  }
+
+  *data = result;
+  *size = (size_t) file_size.QuadPart;
+
+  return 0;
+}
+
+void handle_unmap(const uint8_t *data, size_t size)
+{
+  (void) size;
+
+  if (data == NULL) {
+    return;
+  }
+
+  int r = UnmapViewOfFile(data);
+  ASSERT_UNUSED(r != 0);
+}
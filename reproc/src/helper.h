@@ -0,0 +1,27 @@
+#pragma once
+
+#include "process.h"
+
+// The spawn helper is a small process forked from the current process that
+// starts child processes on our behalf. The helper is only ever forked
+// explicitly with `helper_start` or when reproc is loaded (if built with
+// `REPROC_HELPER_CONSTRUCTOR`), before the current process has grown large or
+// started other threads. Child processes started by the helper become children
+// of the current process so they can be waited on, terminated and killed as if
+// we started them ourselves.
+//
+// The helper is only supported on Linux. On other platforms, `helper_start` and
+// `helper_stop` do nothing and `helper_spawn` falls back to `process_start`.
+
+// Starts the helper if it isn't running yet.
+int helper_start(void);
+
+// Starts a child process through the helper. If the helper isn't running, the
+// child process is started with `vfork` instead. Takes the same arguments as
+// `process_start` but `argv` can't be `NULL`.
+int helper_spawn(process_type *process,
+                 const char *const *argv,
+                 struct process_options options);
+
+// Stops the helper if it is running and waits until it exits.
+int helper_stop(void);
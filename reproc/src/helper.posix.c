@@ -0,0 +1,661 @@
+#define _POSIX_C_SOURCE 200809L
+
+#if defined(__linux__)
+  // `SOCK_CLOEXEC` and `MSG_CMSG_CLOEXEC`.
+  #define _GNU_SOURCE
+#endif
+
+#include "helper.h"
+
+#include "error.h"
+#include "handle.h"
+#include "macro.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(REPROC_MULTITHREADED)
+  #include <pthread.h>
+#endif
+
+#if defined(__linux__)
+
+// The file descriptors that can be attached to a request. Only the valid ones
+// are sent along in this order.
+enum { FD_IN, FD_OUT, FD_ERR, FD_EXIT, FD_EXECUTABLE, NUM_FDS };
+
+struct request {
+  // Bitmask of the file descriptors attached to the request.
+  int fds;
+  size_t argc;
+  size_t envc;
+  // Size of the NUL-terminated strings that follow the request: the program,
+  // the working directory, the arguments and the environment in that order.
+  size_t size;
+};
+
+struct reply {
+  pid_t pid;
+  // `errno` if the helper failed to start the child process.
+  int error;
+};
+
+static struct {
+  pid_t pid;
+  int socket;
+  // The process that started the helper. The helper's child processes only
+  // become children of this process so processes forked from it can't use it.
+  pid_t owner;
+} helper = { -1, -1, -1 }; // `PROCESS_INVALID` and `HANDLE_INVALID`
+
+#if defined(REPROC_MULTITHREADED)
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void lock(void)
+{
+#if defined(REPROC_MULTITHREADED)
+  int r = pthread_mutex_lock(&mutex);
+  ASSERT_UNUSED(r == 0);
+#endif
+}
+
+static void unlock(void)
+{
+#if defined(REPROC_MULTITHREADED)
+  int r = pthread_mutex_unlock(&mutex);
+  ASSERT_UNUSED(r == 0);
+#endif
+}
+
+static int send_all(int socket, const void *buffer, size_t size)
+{
+  const char *data = buffer;
+
+  while (size > 0) {
+    ssize_t r = send(socket, data, size, MSG_NOSIGNAL);
+    if (r < 0) {
+      return -1;
+    }
+
+    data += r;
+    size -= (size_t) r;
+  }
+
+  return 0;
+}
+
+static int recv_all(int socket, void *buffer, size_t size)
+{
+  char *data = buffer;
+
+  while (size > 0) {
+    ssize_t r = recv(socket, data, size, 0);
+    if (r < 0) {
+      return -1;
+    }
+
+    if (r == 0) {
+      errno = EPIPE;
+      return -1;
+    }
+
+    data += r;
+    size -= (size_t) r;
+  }
+
+  return 0;
+}
+
+// Joins `directory` and `path` with a forward slash. The caller is responsible
+// for freeing the result of this function. If an error occurs, `NULL` is
+// returned and `errno` is set to indicate the error.
+static char *path_join(const char *directory, const char *path)
+{
+  size_t directory_size = strlen(directory);
+  size_t path_size = strlen(path);
+
+  // +2 for the separator and the NUL terminator.
+  char *result = malloc(directory_size + path_size + 2);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  memcpy(result, directory, directory_size);
+  result[directory_size] = '/';
+  memcpy(result + directory_size + 1, path, path_size + 1);
+
+  return result;
+}
+
+static size_t strings_size(const char *const *strings, size_t *count)
+{
+  size_t size = 0;
+
+  for (*count = 0; strings != NULL && strings[*count] != NULL; (*count)++) {
+    size += strlen(strings[*count]) + 1;
+  }
+
+  return size;
+}
+
+static char *strings_copy(char *buffer, const char *const *strings)
+{
+  for (size_t i = 0; strings != NULL && strings[i] != NULL; i++) {
+    size_t size = strlen(strings[i]) + 1;
+    memcpy(buffer, strings[i], size);
+    buffer += size;
+  }
+
+  return buffer;
+}
+
+// Sends `request` together with `fds` and `payload` to the helper.
+static int request_send(int socket,
+                        struct request request,
+                        const int *fds,
+                        const char *payload)
+{
+  int attached[NUM_FDS];
+  size_t num_attached = 0;
+
+  for (int i = 0; i < NUM_FDS; i++) {
+    if (fds[i] != HANDLE_INVALID) {
+      request.fds |= 1 << i;
+      attached[num_attached++] = fds[i];
+    }
+  }
+
+  union {
+    char buffer[CMSG_SPACE(sizeof(int) * NUM_FDS)];
+    struct cmsghdr align;
+  } control;
+
+  struct iovec iov = { .iov_base = &request, .iov_len = sizeof(request) };
+  struct msghdr message = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+  // If a pidfd is used to wait for the child process, it doesn't inherit an
+  // exit file descriptor so there might be nothing to attach.
+  if (num_attached > 0) {
+    memset(control.buffer, 0, sizeof(control.buffer));
+    message.msg_control = control.buffer;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * num_attached);
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * num_attached);
+    memcpy(CMSG_DATA(header), attached, sizeof(int) * num_attached);
+  }
+
+  ssize_t r = sendmsg(socket, &message, MSG_NOSIGNAL);
+  if (r < 0) {
+    return -1;
+  }
+
+  // Stream sockets can send less than requested. The file descriptors are
+  // attached to the first byte so they've been sent already.
+  if ((size_t) r < sizeof(request)) {
+    r = send_all(socket, (char *) &request + r, sizeof(request) - (size_t) r);
+    if (r < 0) {
+      return -1;
+    }
+  }
+
+  return send_all(socket, payload, request.size);
+}
+
+// Receives a request from the parent process. Returns 0 if the parent process
+// closed its end of the socket and 1 if a request was received. If not all file
+// descriptors attached to the request could be received (e.g. because we ran
+// out of file descriptors), none of them are stored in `fds` and `error` is set
+// to `EMFILE` so the request can be answered without stopping the helper.
+static int request_receive(int socket,
+                           struct request *request,
+                           int *fds,
+                           char **payload,
+                           int *error)
+{
+  union {
+    char buffer[CMSG_SPACE(sizeof(int) * NUM_FDS)];
+    struct cmsghdr align;
+  } control;
+
+  struct iovec iov = { .iov_base = request, .iov_len = sizeof(*request) };
+  struct msghdr message = { .msg_iov = &iov,
+                            .msg_iovlen = 1,
+                            .msg_control = control.buffer,
+                            .msg_controllen = sizeof(control.buffer) };
+
+  // Receive the file descriptors with `FD_CLOEXEC` set so they don't leak into
+  // unrelated child processes.
+  ssize_t r = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+  if (r <= 0) {
+    return (int) r;
+  }
+
+  struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+  int attached[NUM_FDS];
+  size_t num_attached = 0;
+
+  if (header != NULL && header->cmsg_level == SOL_SOCKET &&
+      header->cmsg_type == SCM_RIGHTS) {
+    num_attached = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    num_attached = MIN(num_attached, (size_t) NUM_FDS);
+    memcpy(attached, CMSG_DATA(header), sizeof(int) * num_attached);
+  }
+
+  // The kernel drops file descriptors it can't install in our file descriptor
+  // table and sets `MSG_CTRUNC` when it does.
+  bool truncated = message.msg_flags & MSG_CTRUNC;
+
+  if ((size_t) r < sizeof(*request)) {
+    r = recv_all(socket, (char *) request + r, sizeof(*request) - (size_t) r);
+    if (r < 0) {
+      goto finish;
+    }
+  }
+
+  size_t num_expected = 0;
+
+  for (int i = 0; i < NUM_FDS; i++) {
+    num_expected += (request->fds & (1 << i)) != 0;
+  }
+
+  if (truncated || num_attached != num_expected) {
+    // The attached file descriptors are closed below.
+    *error = EMFILE;
+  } else {
+    for (size_t i = 0, j = 0; i < NUM_FDS; i++) {
+      if (request->fds & (1 << i)) {
+        fds[i] = attached[j++];
+      }
+    }
+
+    num_attached = 0;
+  }
+
+  *payload = malloc(request->size);
+  if (*payload == NULL) {
+    r = -1;
+    goto finish;
+  }
+
+  r = recv_all(socket, *payload, request->size);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = 1;
+
+finish:
+  for (size_t i = 0; i < num_attached; i++) {
+    handle_destroy(attached[i]);
+  }
+
+  return (int) r;
+}
+
+// Runs in the helper process. Starts child processes until the parent process
+// closes its end of `socket`.
+static int helper_main(int socket)
+{
+  int r = -1;
+
+  while (true) {
+    struct request request = { 0 };
+    int fds[NUM_FDS] = { HANDLE_INVALID, HANDLE_INVALID, HANDLE_INVALID,
+                         HANDLE_INVALID, HANDLE_INVALID };
+    char *payload = NULL;
+    const char **strings = NULL;
+    struct reply reply = { .pid = PROCESS_INVALID, .error = 0 };
+
+    r = request_receive(socket, &request, fds, &payload, &reply.error);
+    if (r <= 0) {
+      break;
+    }
+
+    if (reply.error > 0) {
+      goto respond;
+    }
+
+    // +2 for the `NULL` terminators of the arguments and the environment.
+    strings = malloc((request.argc + request.envc + 2) * sizeof(char *));
+    if (strings == NULL) {
+      reply.error = errno;
+      goto respond;
+    }
+
+    const char *program = payload;
+    const char *working_directory = program + strlen(program) + 1;
+    const char *current = working_directory + strlen(working_directory) + 1;
+
+    for (size_t i = 0; i < request.argc + request.envc + 1; i++) {
+      if (i == request.argc) {
+        strings[i] = NULL;
+        continue;
+      }
+
+      strings[i] = current;
+      current += strlen(current) + 1;
+    }
+
+    strings[request.argc + request.envc + 1] = NULL;
+
+    struct process_options options = {
+      .environment = strings + request.argc + 1,
+      .working_directory = working_directory,
+      .handle = { .in = fds[FD_IN],
+                  .out = fds[FD_OUT],
+                  .err = fds[FD_ERR],
+                  .exit = fds[FD_EXIT] },
+      .executable = { .path = program, .fd = fds[FD_EXECUTABLE] },
+      .vfork = true,
+      .sibling = true
+    };
+
+    r = process_start(&reply.pid, strings, options);
+    if (r < 0) {
+      reply.error = -r;
+    }
+
+  respond:
+    for (int i = 0; i < NUM_FDS; i++) {
+      handle_destroy(fds[i]);
+    }
+
+    free(strings);
+    free(payload);
+
+    r = send_all(socket, &reply, sizeof(reply));
+    if (r < 0) {
+      break;
+    }
+  }
+
+  return r;
+}
+
+static int helper_stop_locked(void)
+{
+  int r = 0;
+
+  if (helper.socket == HANDLE_INVALID) {
+    return 0;
+  }
+
+  if (helper.owner == getpid()) {
+    // Closing the socket tells the helper to exit.
+    helper.socket = handle_destroy(helper.socket);
+    r = waitpid(helper.pid, NULL, 0);
+
+    // The reaper (see reaper.h) might have beaten us to it.
+    if (r < 0 && errno == ECHILD) {
+      r = 0;
+    }
+  }
+
+  // In a forked process, the socket might have been closed already and its
+  // file descriptor reused so we leave it alone.
+  helper.socket = HANDLE_INVALID;
+
+  helper.pid = PROCESS_INVALID;
+  helper.owner = PROCESS_INVALID;
+
+  return error_unify(r);
+}
+
+static int helper_start_locked(void)
+{
+  if (helper.socket != HANDLE_INVALID && helper.owner == getpid()) {
+    return 0;
+  }
+
+  // If we get here with a valid socket, we're in a process that was forked from
+  // the process that started the helper. The helper isn't ours to use so we
+  // start our own.
+  int r = helper_stop_locked();
+  if (r < 0) {
+    return r;
+  }
+
+  int pair[] = { HANDLE_INVALID, HANDLE_INVALID };
+  int null = HANDLE_INVALID;
+  pid_t pid = PROCESS_INVALID;
+
+  r = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair);
+  if (r < 0) {
+    goto finish;
+  }
+
+  // The helper doesn't need its standard streams.
+  null = open("/dev/null", O_RDWR | O_CLOEXEC);
+  if (null < 0) {
+    r = -1;
+    goto finish;
+  }
+
+  // `process_start` makes sure the helper only inherits the file descriptors we
+  // pass it and resets its signal handlers and signal mask.
+  struct process_options options = {
+    .handle = { .in = null, .out = null, .err = null, .exit = pair[1] }
+  };
+
+  r = process_start(&pid, NULL, options);
+  if (r < 0) {
+    goto finish;
+  }
+
+  if (r == 0) {
+    // Helper process
+    r = helper_main(pair[1]);
+    _exit(r < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+  }
+
+  helper.pid = pid;
+  helper.socket = pair[0];
+  helper.owner = getpid();
+  pair[0] = HANDLE_INVALID;
+
+finish:
+  handle_destroy(pair[0]);
+  handle_destroy(pair[1]);
+  handle_destroy(null);
+
+  return error_unify(r);
+}
+
+int helper_start(void)
+{
+  lock();
+  int r = helper_start_locked();
+  unlock();
+
+  return r;
+}
+
+#if defined(REPROC_HELPER_CONSTRUCTOR)
+
+// Runs when reproc is loaded, before `main` or the code that loads reproc has
+// had the chance to grow the current process or start other threads.
+__attribute__((constructor)) static void helper_construct(void)
+{
+  // If this fails, child processes are started without the helper.
+  helper_start();
+}
+
+#endif
+
+int helper_spawn(pid_t *process,
+                 const char *const *argv,
+                 struct process_options options)
+{
+  assert(process);
+  assert(argv);
+
+  char cwd[PATH_MAX];
+  char *working_directory = NULL;
+  char *program = NULL;
+  char *payload = NULL;
+  int r = -1;
+
+  // The helper has its own working directory so we make sure everything that's
+  // relative to ours is absolute before sending it over.
+
+  if (getcwd(cwd, sizeof(cwd)) == NULL) {
+    goto finish;
+  }
+
+  if (options.working_directory == NULL) {
+    working_directory = strdup(cwd);
+  } else if (options.working_directory[0] == '/') {
+    working_directory = strdup(options.working_directory);
+  } else {
+    working_directory = path_join(cwd, options.working_directory);
+  }
+
+  if (working_directory == NULL) {
+    r = -1;
+    goto finish;
+  }
+
+  const char *file = options.executable.path != NULL ? options.executable.path
+                                                     : argv[0];
+
+  // Programs without a slash are searched for in `PATH` by the child process.
+  program = strchr(file, '/') != NULL && file[0] != '/' ? path_join(cwd, file)
+                                                        : strdup(file);
+  if (program == NULL) {
+    r = -1;
+    goto finish;
+  }
+
+  // The helper has its own copy of the environment which might be outdated.
+  extern char **environ;
+  const char *const *environment = options.environment != NULL
+                                       ? options.environment
+                                       : (const char *const *) environ;
+
+  struct request request = { 0 };
+  request.size = strlen(program) + 1 + strlen(working_directory) + 1 +
+                 strings_size(argv, &request.argc) +
+                 strings_size(environment, &request.envc);
+
+  payload = malloc(request.size);
+  if (payload == NULL) {
+    r = -1;
+    goto finish;
+  }
+
+  char *current = payload;
+
+  memcpy(current, program, strlen(program) + 1);
+  current += strlen(program) + 1;
+  memcpy(current, working_directory, strlen(working_directory) + 1);
+  current += strlen(working_directory) + 1;
+  current = strings_copy(current, argv);
+  current = strings_copy(current, environment);
+
+  assert(current == payload + request.size);
+
+  int fds[NUM_FDS] = { options.handle.in, options.handle.out,
+                       options.handle.err, options.handle.exit,
+                       options.executable.fd };
+  struct reply reply = { .pid = PROCESS_INVALID, .error = 0 };
+
+  lock();
+
+  // We never start the helper here because by now, the current process might
+  // have grown large or started other threads which is exactly what the helper
+  // is supposed to avoid. Instead, we start the child process ourselves
+  // without copying our address space.
+  if (helper.socket == HANDLE_INVALID || helper.owner != getpid()) {
+    unlock();
+
+    options.helper = false;
+    options.vfork = true;
+    r = process_start(process, argv, options);
+    goto finish;
+  }
+
+  r = request_send(helper.socket, request, fds, payload);
+  if (r < 0) {
+    goto release;
+  }
+
+  r = recv_all(helper.socket, &reply, sizeof(reply));
+
+release:
+  if (r < 0) {
+    // If the helper died, we start child processes ourselves from now on.
+    int saved = errno;
+    helper_stop_locked();
+    errno = saved;
+  }
+
+  unlock();
+
+  if (r < 0) {
+    goto finish;
+  }
+
+  if (reply.error > 0) {
+    // If the child process was started, it's our child so we have to reap it.
+    if (reply.pid > 0) {
+      r = waitpid(reply.pid, NULL, 0);
+      assert(r < 0 || r == reply.pid);
+    }
+
+    r = -reply.error;
+    goto finish;
+  }
+
+  *process = reply.pid;
+  r = 0;
+
+finish:
+  free(working_directory);
+  free(program);
+  free(payload);
+
+  return error_unify_or_else(r, 1);
+}
+
+int helper_stop(void)
+{
+  lock();
+  int r = helper_stop_locked();
+  unlock();
+
+  return r;
+}
+
+#else
+
+int helper_start(void)
+{
+  return 0;
+}
+
+int helper_spawn(pid_t *process,
+                 const char *const *argv,
+                 struct process_options options)
+{
+  options.helper = false;
+  return process_start(process, argv, options);
+}
+
+int helper_stop(void)
+{
+  return 0;
+}
+
+#endif
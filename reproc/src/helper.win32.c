@@ -0,0 +1,22 @@
+#include "helper.h"
+
+// `CreateProcess` doesn't copy the address space of the parent process so
+// there's no need for a spawn helper on Windows.
+
+int helper_start(void)
+{
+  return 0;
+}
+
+int helper_spawn(process_type *process,
+                 const char *const *argv,
+                 struct process_options options)
+{
+  options.helper = false;
+  return process_start(process, argv, options);
+}
+
+int helper_stop(void)
+{
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include "options.h"
 
 #include <assert.h>
+#include <limits.h>
 
 #include "error.h"
 
@@ -16,7 +17,11 @@ static int parse_redirect(reproc_redirect *redirect,
     redirect->file = file;
   }
 
-  if (redirect->type == REPROC_REDIRECT_HANDLE || redirect->handle) {
+  // `REPROC_REDIRECT_MEMFD` accepts an existing memfd for stdin.
+  bool memfd = redirect->type == REPROC_REDIRECT_MEMFD;
+
+  if (redirect->type == REPROC_REDIRECT_HANDLE ||
+      (redirect->handle && !memfd)) {
     ASSERT_EINVAL(!redirect->type || redirect->type == REPROC_REDIRECT_HANDLE);
     ASSERT_EINVAL(redirect->handle);
     ASSERT_EINVAL(!redirect->file);
@@ -30,6 +35,19 @@ static int parse_redirect(reproc_redirect *redirect,
     redirect->type = REPROC_REDIRECT_FILE;
   }
 
+  if (redirect->adaptive) {
+    ASSERT_EINVAL(!redirect->type || redirect->type == REPROC_REDIRECT_PIPE);
+    ASSERT_EINVAL(stream != REPROC_STREAM_IN);
+    redirect->type = REPROC_REDIRECT_PIPE;
+  }
+
+  if (redirect->pipe_size > 0) {
+    ASSERT_EINVAL(!redirect->type || redirect->type == REPROC_REDIRECT_PIPE ||
+                  redirect->type == REPROC_REDIRECT_SOCKET);
+    ASSERT_EINVAL(redirect->pipe_size <= INT_MAX);
+    redirect->type = redirect->type ? redirect->type : REPROC_REDIRECT_PIPE;
+  }
+
   if (!redirect->type) {
     if (parent) {
       ASSERT_EINVAL(!discard);
@@ -43,6 +61,57 @@ static int parse_redirect(reproc_redirect *redirect,
     }
   }
 
+  if (memfd) {
+    ASSERT_EINVAL(!redirect->handle || stream == REPROC_STREAM_IN);
+  }
+
+  return 0;
+}
+
+int parse_extra_stream(reproc_extra_stream *stream)
+{
+  assert(stream);
+
+  int r = parse_redirect(&stream->redirect,
+                         stream->input ? REPROC_STREAM_IN : REPROC_STREAM_OUT,
+                         false, false, NULL);
+  if (r < 0) {
+    return r;
+  }
+
+  ASSERT_EINVAL(stream->fd > 2);
+  ASSERT_EINVAL(!stream->redirect.adaptive);
+  ASSERT_EINVAL(stream->redirect.type == REPROC_REDIRECT_PIPE ||
+                stream->redirect.type == REPROC_REDIRECT_SOCKET ||
+                stream->redirect.type == REPROC_REDIRECT_DISCARD ||
+                stream->redirect.type == REPROC_REDIRECT_HANDLE ||
+                stream->redirect.type == REPROC_REDIRECT_FILE);
+
+  return 0;
+}
+
+static int parse_extra_streams(const reproc_extra_stream *streams, size_t size)
+{
+  ASSERT_EINVAL(streams || size == 0);
+  ASSERT_EINVAL(size <= REPROC_EXTRA_STREAMS_MAX);
+
+#if defined(_WIN32)
+  ASSERT_EINVAL(size == 0);
+#endif
+
+  for (size_t i = 0; i < size; i++) {
+    reproc_extra_stream stream = streams[i];
+
+    int r = parse_extra_stream(&stream);
+    if (r < 0) {
+      return r;
+    }
+
+    for (size_t j = 0; j < i; j++) {
+      ASSERT_EINVAL(streams[j].fd != stream.fd);
+    }
+  }
+
   return 0;
 }
 
@@ -75,15 +144,44 @@ int parse_options(reproc_options *options, const char *const *argv)
   if (options->input.data != NULL || options->input.size > 0) {
     ASSERT_EINVAL(options->input.data != NULL);
     ASSERT_EINVAL(options->input.size > 0);
-    ASSERT_EINVAL(options->redirect.in.type == REPROC_REDIRECT_PIPE);
+    ASSERT_EINVAL(options->redirect.in.type == REPROC_REDIRECT_PIPE ||
+                  options->redirect.in.type == REPROC_REDIRECT_SOCKET ||
+                  options->redirect.in.type == REPROC_REDIRECT_MEMFD);
+  }
+
+  if (options->redirect.in.type == REPROC_REDIRECT_MEMFD) {
+    // The child process reads stdin from either a copy of `input` or the
+    // memfd passed in `handle`.
+    ASSERT_EINVAL(!options->input.data != !options->redirect.in.handle);
+  }
+
+  r = parse_extra_streams(options->extra_streams, options->num_extra_streams);
+  if (r < 0) {
+    return r;
   }
 
   if (options->fork) {
     ASSERT_EINVAL(argv == NULL);
+    ASSERT_EINVAL(options->num_extra_streams == 0);
+    ASSERT_EINVAL(!options->spawn || options->spawn == REPROC_SPAWN_FORK);
   } else {
     ASSERT_EINVAL(argv != NULL && argv[0] != NULL);
   }
 
+  if (options->async) {
+    ASSERT_EINVAL(!options->fork);
+    ASSERT_EINVAL(!options->spawn || options->spawn == REPROC_SPAWN_FORK);
+    options->spawn = REPROC_SPAWN_FORK;
+  }
+
+  if (!options->spawn) {
+    options->spawn = options->fork ? REPROC_SPAWN_FORK : REPROC_SPAWN_VFORK;
+  }
+
+  ASSERT_EINVAL(options->spawn == REPROC_SPAWN_FORK ||
+                options->spawn == REPROC_SPAWN_VFORK ||
+                options->spawn == REPROC_SPAWN_HELPER);
+
   if (options->deadline == 0) {
     options->deadline = REPROC_INFINITE;
   }
@@ -3,3 +3,7 @@
 #include <reproc/reproc.h>
 
 int parse_options(reproc_options *options, const char *const *argv);
+
+// Fills in the defaults of an extra stream that was validated by
+// `parse_options`.
+int parse_extra_stream(reproc_extra_stream *stream);
@@ -4,6 +4,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "handle.h"
+
+#include <reproc/reproc.h>
+
 #ifdef _WIN64
 typedef uint64_t pipe_type; // `SOCKET`
 #elif _WIN32
@@ -17,18 +21,31 @@ enum {
   PIPE_EVENT_IN = 1 << 0,
   PIPE_EVENT_OUT = 1 << 1,
   PIPE_EVENT_ERR = 1 << 2,
-  PIPE_EVENT_EXIT = 1 << 3
+  PIPE_EVENT_EXIT = 1 << 3,
+  PIPE_EVENT_START = 1 << 5
 };
 
+// Keep in sync with `REPROC_EVENT_EXTRA`.
+#define PIPE_EVENT_EXTRA(index) (1 << (16 + (index)))
+
+enum { PIPE_EXTRA_MAX = REPROC_EXTRA_STREAMS_MAX };
+
 typedef struct {
   pipe_type in;
   pipe_type out;
   pipe_type err;
   pipe_type exit;
+  pipe_type start;
+  // Only the first `num_extra` pipes are polled (POSIX only). Bit `i` of
+  // `extra_in` is set if `extra[i]` is polled for writability instead of
+  // readability.
+  pipe_type extra[PIPE_EXTRA_MAX];
+  size_t num_extra;
+  int extra_in;
   int events;
 } pipe_set;
 
-enum { PIPES_PER_SET = 4 };
+enum { PIPES_PER_SET = 5 };
 
 extern const pipe_type PIPE_INVALID;
 
@@ -36,6 +53,10 @@ extern const pipe_type PIPE_INVALID;
 // child endpoint of the pipe respectively.
 int pipe_init(pipe_type *read, pipe_type *write);
 
+// `pipe_init` but creates a bidirectional socket pair instead. Writing to the
+// sockets has to be done with `pipe_send` and `pipe_sendv`.
+int pipe_socket(pipe_type *read, pipe_type *write);
+
 // Sets `pipe` to nonblocking mode.
 int pipe_nonblocking(pipe_type pipe, bool enable);
 
@@ -47,10 +68,58 @@ int pipe_read(pipe_type pipe, uint8_t *buffer, size_t size);
 // returns the amount of bytes written.
 int pipe_write(pipe_type pipe, const uint8_t *buffer, size_t size);
 
+// `pipe_write` for sockets created by `pipe_socket`. Writing to a socket whose
+// other end was closed returns `REPROC_EPIPE` without raising `SIGPIPE`.
+int pipe_send(pipe_type pipe, const uint8_t *buffer, size_t size);
+
+// Maximum amount of buffers used by `pipe_readv` and `pipe_writev`.
+enum { PIPE_IOV_MAX = 64 };
+
+// `pipe_read` but reads into the first `PIPE_IOV_MAX` buffers of `buffers`.
+int pipe_readv(pipe_type pipe, const reproc_iovec *buffers, size_t num_buffers);
+
+// `pipe_write` but writes the first `PIPE_IOV_MAX` buffers of `buffers`.
+int pipe_writev(pipe_type pipe,
+                const reproc_iovec *buffers,
+                size_t num_buffers);
+
+// `pipe_writev` for sockets created by `pipe_socket` (see `pipe_send`).
+int pipe_sendv(pipe_type pipe, const reproc_iovec *buffers, size_t num_buffers);
+
+// `pipe_write` but on Linux, the pages of `buffer` are gifted to the pipe with
+// `vmsplice` instead of being copied into it. The caller may not modify the
+// bytes that were written afterwards. Falls back to `pipe_write` elsewhere.
+int pipe_write_gift(pipe_type pipe, const uint8_t *buffer, size_t size);
+
+// Moves up to `size` bytes from the pipe indicated by `pipe` to `out` and
+// returns the amount of bytes moved. On Linux, the data is moved with `splice`
+// if `*spliceable` is true. If `out` doesn't support `splice`, `*spliceable` is
+// set to false and the data is copied with `read` and `write` instead. `out`
+// must be in blocking mode. Interrupted writes are retried but if writing to
+// `out` fails otherwise, the data that was already read from `pipe` is lost.
+int pipe_splice(pipe_type pipe,
+                handle_type out,
+                size_t size,
+                bool *spliceable);
+
+// Sets the capacity of the pipe indicated by `pipe` to at least `size` bytes
+// and returns its new capacity. The socket buffer sizes are changed if `pipe`
+// is a socket. Returns 0 without doing anything on POSIX systems other than
+// Linux where the capacity of a pipe can't be changed.
+int pipe_resize(pipe_type pipe, size_t size);
+
+// Returns the capacity of the pipe indicated by `pipe` in bytes or 0 if it
+// can't be queried (pipes on POSIX systems other than Linux).
+int pipe_capacity(pipe_type pipe);
+
 // Returns the first stream of `in`, `out` and `err` that has data available to
 // read. 0 => in, 1 => out, 2 => err.
 //
 // Returns `REPROC_EPIPE` if `in`, `out` and `err` are invalid.
 int pipe_wait(pipe_set *sets, size_t num_sets, int timeout);
 
+// Shuts down the sending (`write`) or receiving direction of a socket created
+// by `pipe_socket`.
+int pipe_shutdown(pipe_type pipe, bool write);
+
 pipe_type pipe_destroy(pipe_type pipe);
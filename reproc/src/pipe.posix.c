@@ -1,5 +1,10 @@
 #define _POSIX_C_SOURCE 200809L
 
+#if defined(__linux__)
+  // `pipe2`, `splice`, `vmsplice` and `F_SETPIPE_SZ`
+  #define _GNU_SOURCE
+#endif
+
 #include "pipe.h"
 
 #include "error.h"
@@ -11,8 +16,16 @@
 #include <limits.h>
 #include <poll.h>
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#if !defined(MSG_NOSIGNAL)
+  // macOS uses the `SO_NOSIGPIPE` socket option instead.
+  #define MSG_NOSIGNAL 0
+#endif
+
 const int PIPE_INVALID = -1;
 
 int pipe_init(int *read, int *write)
@@ -23,6 +36,13 @@ int pipe_init(int *read, int *write)
   int pair[] = { PIPE_INVALID, PIPE_INVALID };
   int r = -1;
 
+#if defined(__linux__)
+  // Create the pipe and set `FD_CLOEXEC` in a single system call.
+  r = pipe2(pair, O_CLOEXEC);
+  if (r < 0) {
+    goto finish;
+  }
+#else
   r = pipe(pair);
   if (r < 0) {
     goto finish;
@@ -37,6 +57,64 @@ int pipe_init(int *read, int *write)
   if (r < 0) {
     goto finish;
   }
+#endif
+
+  *read = pair[0];
+  *write = pair[1];
+
+  pair[0] = PIPE_INVALID;
+  pair[1] = PIPE_INVALID;
+
+finish:
+  pipe_destroy(pair[0]);
+  pipe_destroy(pair[1]);
+
+  return error_unify(r);
+}
+
+int pipe_socket(int *read, int *write)
+{
+  assert(read);
+  assert(write);
+
+  int pair[] = { PIPE_INVALID, PIPE_INVALID };
+  int r = -1;
+
+#if defined(SOCK_CLOEXEC)
+  r = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair);
+  if (r < 0) {
+    goto finish;
+  }
+#else
+  r = socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = handle_cloexec(pair[0], true);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = handle_cloexec(pair[1], true);
+  if (r < 0) {
+    goto finish;
+  }
+#endif
+
+#if defined(SO_NOSIGPIPE)
+  int enable = 1;
+
+  r = setsockopt(pair[0], SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = setsockopt(pair[1], SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+  if (r < 0) {
+    goto finish;
+  }
+#endif
 
   *read = pair[0];
   *write = pair[1];
@@ -92,27 +170,265 @@ int pipe_write(int pipe, const uint8_t *buffer, size_t size)
   return error_unify_or_else(r, r);
 }
 
+int pipe_send(int pipe, const uint8_t *buffer, size_t size)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(buffer);
+
+  int r = (int) send(pipe, buffer, size, MSG_NOSIGNAL);
+
+  return error_unify_or_else(r, r);
+}
+
+// Converts `buffers` to `iov` and returns the amount of buffers converted.
+static int iovec_from(struct iovec *iov,
+                      const reproc_iovec *buffers,
+                      size_t num_buffers)
+{
+  num_buffers = num_buffers < PIPE_IOV_MAX ? num_buffers : PIPE_IOV_MAX;
+
+  for (size_t i = 0; i < num_buffers; i++) {
+    assert(buffers[i].data || buffers[i].size == 0);
+    iov[i] = (struct iovec){ buffers[i].data, buffers[i].size };
+  }
+
+  return (int) num_buffers;
+}
+
+int pipe_readv(int pipe, const reproc_iovec *buffers, size_t num_buffers)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(buffers);
+
+  struct iovec iov[PIPE_IOV_MAX];
+  int count = iovec_from(iov, buffers, num_buffers);
+
+  int r = (int) readv(pipe, iov, count);
+
+  if (r == 0) {
+    // `readv` returns 0 to indicate the other end of the pipe was closed.
+    r = -EPIPE;
+  }
+
+  return error_unify_or_else(r, r);
+}
+
+int pipe_writev(int pipe, const reproc_iovec *buffers, size_t num_buffers)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(buffers);
+
+  struct iovec iov[PIPE_IOV_MAX];
+  int count = iovec_from(iov, buffers, num_buffers);
+
+  int r = (int) writev(pipe, iov, count);
+
+  return error_unify_or_else(r, r);
+}
+
+int pipe_sendv(int pipe, const reproc_iovec *buffers, size_t num_buffers)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(buffers);
+
+  struct iovec iov[PIPE_IOV_MAX];
+  int count = iovec_from(iov, buffers, num_buffers);
+
+  struct msghdr message = { 0 };
+  message.msg_iov = iov;
+  message.msg_iovlen = (size_t) count;
+
+  int r = (int) sendmsg(pipe, &message, MSG_NOSIGNAL);
+
+  return error_unify_or_else(r, r);
+}
+
+int pipe_write_gift(int pipe, const uint8_t *buffer, size_t size)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(buffer);
+
+#if defined(__linux__)
+  // `vmsplice` takes a non-const `iovec` but doesn't modify the data when
+  // writing to a pipe.
+  struct iovec iov = { (void *) buffer, size };
+
+  int r = (int) vmsplice(pipe, &iov, 1, SPLICE_F_GIFT);
+
+  return error_unify_or_else(r, r);
+#else
+  return pipe_write(pipe, buffer, size);
+#endif
+}
+
+// Writes all of `buffer` to `out`. `buffer` has already been read from the
+// child process so a signal handler installed without `SA_RESTART` mustn't make
+// us lose it.
+static int write_all(int out, const uint8_t *buffer, size_t size)
+{
+  while (size > 0) {
+    ssize_t r = write(out, buffer, size);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (r < 0) {
+      return error_unify(-1);
+    }
+
+    buffer += r;
+    size -= (size_t) r;
+  }
+
+  return 0;
+}
+
+int pipe_splice(int pipe, int out, size_t size, bool *spliceable)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(out != HANDLE_INVALID);
+  assert(spliceable);
+
+  int r = -1;
+
+#if defined(__linux__)
+  if (*spliceable) {
+    assert(size <= INT_MAX);
+
+    r = (int) splice(pipe, NULL, out, NULL, size, SPLICE_F_MOVE);
+
+    if (r == 0) {
+      return -EPIPE;
+    }
+
+    // `EINVAL` indicates `out` can't be spliced to (for example, files opened
+    // with `O_APPEND`). Nothing was moved so we can fall back to copying.
+    if (r >= 0 || (errno != EINVAL && errno != ENOSYS)) {
+      return error_unify_or_else(r, r);
+    }
+
+    *spliceable = false;
+  }
+#endif
+
+  uint8_t buffer[4096];
+
+  size = size < sizeof(buffer) ? size : sizeof(buffer);
+
+  r = pipe_read(pipe, buffer, size);
+  if (r < 0) {
+    return r;
+  }
+
+  int written = write_all(out, buffer, (size_t) r);
+  if (written < 0) {
+    return written;
+  }
+
+  return r;
+}
+
+static bool is_socket(int pipe)
+{
+  struct stat info = { 0 };
+  return fstat(pipe, &info) == 0 && S_ISSOCK(info.st_mode);
+}
+
+int pipe_resize(int pipe, size_t size)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(size <= INT_MAX);
+
+  if (is_socket(pipe)) {
+    int value = (int) size;
+    int r = -1;
+
+    // We don't know which direction data flows through `pipe` so we resize
+    // both socket buffers.
+    r = setsockopt(pipe, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+    if (r < 0) {
+      return error_unify(r);
+    }
+
+    r = setsockopt(pipe, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+    if (r < 0) {
+      return error_unify(r);
+    }
+
+    return pipe_capacity(pipe);
+  }
+
+#if defined(__linux__)
+  // The kernel rounds `size` up to a power of two multiple of the page size and
+  // returns the actual capacity of the pipe.
+  int r = fcntl(pipe, F_SETPIPE_SZ, (int) size);
+  return error_unify_or_else(r, r);
+#else
+  (void) pipe;
+  (void) size;
+  return 0;
+#endif
+}
+
+int pipe_capacity(int pipe)
+{
+  assert(pipe != PIPE_INVALID);
+
+  if (is_socket(pipe)) {
+    // Data sent over a Unix domain socket is accounted against the send buffer
+    // of the sender.
+    int value = 0;
+    socklen_t size = sizeof(value);
+
+    int r = getsockopt(pipe, SOL_SOCKET, SO_SNDBUF, &value, &size);
+    return error_unify_or_else(r, value);
+  }
+
+#if defined(__linux__)
+  int r = fcntl(pipe, F_GETPIPE_SZ);
+  return error_unify_or_else(r, r);
+#else
+  (void) pipe;
+  return 0;
+#endif
+}
+
 int pipe_wait(pipe_set *sets, size_t num_sets, int timeout)
 {
-  assert(num_sets * PIPES_PER_SET <= INT_MAX);
+  static const int EVENTS[PIPES_PER_SET] = { PIPE_EVENT_IN, PIPE_EVENT_OUT,
+                                             PIPE_EVENT_ERR, PIPE_EVENT_EXIT,
+                                             PIPE_EVENT_START };
 
   struct pollfd *pollfds = NULL;
-  size_t num_pipes = num_sets * PIPES_PER_SET;
+  size_t num_pipes = 0;
   int r = -ENOMEM;
 
+  for (size_t i = 0; i < num_sets; i++) {
+    assert(sets[i].num_extra <= PIPE_EXTRA_MAX);
+    num_pipes += PIPES_PER_SET + sets[i].num_extra;
+  }
+
+  assert(num_pipes <= INT_MAX);
+
   pollfds = calloc(sizeof(struct pollfd), num_pipes);
   if (pollfds == NULL) {
     goto finish;
   }
 
-  for (size_t i = 0; i < num_sets; i++) {
-    size_t j = i * PIPES_PER_SET;
-    pollfds[j + 0] = (struct pollfd){ .fd = sets[i].in, .events = POLLOUT };
-    pollfds[j + 1] = (struct pollfd){ .fd = sets[i].out, .events = POLLIN };
-    pollfds[j + 2] = (struct pollfd){ .fd = sets[i].err, .events = POLLIN };
+  for (size_t i = 0, j = 0; i < num_sets; i++) {
+    pollfds[j++] = (struct pollfd){ .fd = sets[i].in, .events = POLLOUT };
+    pollfds[j++] = (struct pollfd){ .fd = sets[i].out, .events = POLLIN };
+    pollfds[j++] = (struct pollfd){ .fd = sets[i].err, .events = POLLIN };
     // macos 10.15 indicates `POLLIN` instead of `POLLHUP` when the peer fd is
     // closed.
-    pollfds[j + 3] = (struct pollfd){ .fd = sets[i].exit, .events = POLLIN };
+    pollfds[j++] = (struct pollfd){ .fd = sets[i].exit, .events = POLLIN };
+    pollfds[j++] = (struct pollfd){ .fd = sets[i].start, .events = POLLIN };
+
+    for (size_t k = 0; k < sets[i].num_extra; k++) {
+      short events = sets[i].extra_in & (1 << k) ? POLLOUT : POLLIN;
+      pollfds[j++] = (struct pollfd){ .fd = sets[i].extra[k],
+                                      .events = events };
+    }
   }
 
   r = poll(pollfds, (nfds_t) num_pipes, timeout);
@@ -120,16 +436,19 @@ int pipe_wait(pipe_set *sets, size_t num_sets, int timeout)
     goto finish;
   }
 
-  for (size_t i = 0; i < num_sets; i++) {
+  for (size_t i = 0, j = 0; i < num_sets; i++) {
     sets[i].events = 0;
-  }
 
-  for (size_t i = 0; i < num_pipes; i++) {
-    struct pollfd pollfd = pollfds[i];
+    for (size_t k = 0; k < PIPES_PER_SET; k++, j++) {
+      if (pollfds[j].revents > 0) {
+        sets[i].events |= EVENTS[k];
+      }
+    }
 
-    if (pollfd.revents > 0) {
-      int event = 1 << (i % PIPES_PER_SET);
-      sets[i / PIPES_PER_SET].events |= event;
+    for (size_t k = 0; k < sets[i].num_extra; k++, j++) {
+      if (pollfds[j].revents > 0) {
+        sets[i].events |= PIPE_EVENT_EXTRA(k);
+      }
     }
   }
 
@@ -144,7 +463,15 @@ int pipe_wait(pipe_set *sets, size_t num_sets, int timeout)
 finish:
   free(pollfds);
 
-  return r;
+  return error_unify(r);
+}
+
+int pipe_shutdown(int pipe, bool write)
+{
+  assert(pipe != PIPE_INVALID);
+
+  int r = shutdown(pipe, write ? SHUT_WR : SHUT_RD);
+  return error_unify(r);
 }
 
 int pipe_destroy(int pipe)
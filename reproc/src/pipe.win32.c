@@ -92,7 +92,7 @@ finish:
   return error_unify(r);
 }
 
-int pipe_init(SOCKET *read, SOCKET *write)
+static int pair_init(SOCKET *read, SOCKET *write, bool duplex)
 {
   assert(read);
   assert(write);
@@ -117,16 +117,18 @@ int pipe_init(SOCKET *read, SOCKET *write)
     goto finish;
   }
 
-  // Make the connection unidirectional to better emulate a pipe.
+  if (!duplex) {
+    // Make the connection unidirectional to better emulate a pipe.
 
-  r = shutdown(pair[0], SD_SEND);
-  if (r < 0) {
-    goto finish;
-  }
+    r = shutdown(pair[0], SD_SEND);
+    if (r < 0) {
+      goto finish;
+    }
 
-  r = shutdown(pair[1], SD_RECEIVE);
-  if (r < 0) {
-    goto finish;
+    r = shutdown(pair[1], SD_RECEIVE);
+    if (r < 0) {
+      goto finish;
+    }
   }
 
   *read = pair[0];
@@ -142,6 +144,16 @@ finish:
   return error_unify(r);
 }
 
+int pipe_init(SOCKET *read, SOCKET *write)
+{
+  return pair_init(read, write, false);
+}
+
+int pipe_socket(SOCKET *read, SOCKET *write)
+{
+  return pair_init(read, write, true);
+}
+
 int pipe_nonblocking(SOCKET pipe, bool enable)
 {
   u_long mode = enable;
@@ -179,8 +191,171 @@ int pipe_write(SOCKET pipe, const uint8_t *buffer, size_t size)
   return error_unify_or_else(r, r);
 }
 
+int pipe_send(SOCKET pipe, const uint8_t *buffer, size_t size)
+{
+  // Windows doesn't have `SIGPIPE`.
+  return pipe_write(pipe, buffer, size);
+}
+
+// Converts `buffers` to `wsabufs` and returns the amount of buffers converted.
+static DWORD wsabuf_from(WSABUF *wsabufs,
+                         const reproc_iovec *buffers,
+                         size_t num_buffers)
+{
+  num_buffers = num_buffers < PIPE_IOV_MAX ? num_buffers : PIPE_IOV_MAX;
+
+  for (size_t i = 0; i < num_buffers; i++) {
+    assert(buffers[i].data || buffers[i].size == 0);
+    assert(buffers[i].size <= ULONG_MAX);
+    wsabufs[i] = (WSABUF){ (ULONG) buffers[i].size, (CHAR *) buffers[i].data };
+  }
+
+  return (DWORD) num_buffers;
+}
+
+int pipe_readv(SOCKET pipe, const reproc_iovec *buffers, size_t num_buffers)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(buffers);
+
+  WSABUF wsabufs[PIPE_IOV_MAX];
+  DWORD count = wsabuf_from(wsabufs, buffers, num_buffers);
+  DWORD bytes_read = 0;
+  DWORD flags = 0;
+
+  int r = WSARecv(pipe, wsabufs, count, &bytes_read, &flags, NULL, NULL);
+
+  if (r == 0 && bytes_read == 0) {
+    return -ERROR_BROKEN_PIPE;
+  }
+
+  if (r < 0) {
+    return WSAGetLastError() == WSAECONNRESET ? -ERROR_BROKEN_PIPE
+                                              : error_unify(r);
+  }
+
+  assert(bytes_read <= INT_MAX);
+
+  return (int) bytes_read;
+}
+
+int pipe_writev(SOCKET pipe, const reproc_iovec *buffers, size_t num_buffers)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(buffers);
+
+  WSABUF wsabufs[PIPE_IOV_MAX];
+  DWORD count = wsabuf_from(wsabufs, buffers, num_buffers);
+  DWORD bytes_written = 0;
+
+  int r = WSASend(pipe, wsabufs, count, &bytes_written, 0, NULL, NULL);
+
+  if (r < 0) {
+    return WSAGetLastError() == WSAECONNRESET ? -ERROR_BROKEN_PIPE
+                                              : error_unify(r);
+  }
+
+  assert(bytes_written <= INT_MAX);
+
+  return (int) bytes_written;
+}
+
+int pipe_sendv(SOCKET pipe, const reproc_iovec *buffers, size_t num_buffers)
+{
+  return pipe_writev(pipe, buffers, num_buffers);
+}
+
+int pipe_write_gift(SOCKET pipe, const uint8_t *buffer, size_t size)
+{
+  // Windows doesn't have `vmsplice`.
+  return pipe_write(pipe, buffer, size);
+}
+
+int pipe_splice(SOCKET pipe, HANDLE out, size_t size, bool *spliceable)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(out != HANDLE_INVALID);
+  assert(spliceable);
+
+  // Windows doesn't have `splice` so we always copy through a buffer.
+  *spliceable = false;
+
+  uint8_t buffer[4096];
+
+  size = size < sizeof(buffer) ? size : sizeof(buffer);
+
+  int r = pipe_read(pipe, buffer, size);
+  if (r < 0) {
+    return r;
+  }
+
+  for (DWORD offset = 0; offset < (DWORD) r;) {
+    DWORD written = 0;
+
+    if (!WriteFile(out, buffer + offset, (DWORD) r - offset, &written, NULL)) {
+      return error_unify(-1);
+    }
+
+    offset += written;
+  }
+
+  return r;
+}
+
+int pipe_resize(SOCKET pipe, size_t size)
+{
+  assert(pipe != PIPE_INVALID);
+  assert(size <= INT_MAX);
+
+  int value = (int) size;
+  int r = -1;
+
+  // We don't know which direction data flows through `pipe` so we resize both
+  // socket buffers.
+  r = setsockopt(pipe, SOL_SOCKET, SO_RCVBUF, (const char *) &value,
+                 sizeof(value));
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  r = setsockopt(pipe, SOL_SOCKET, SO_SNDBUF, (const char *) &value,
+                 sizeof(value));
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  return pipe_capacity(pipe);
+}
+
+int pipe_capacity(SOCKET pipe)
+{
+  assert(pipe != PIPE_INVALID);
+
+  int value = 0;
+  int size = sizeof(value);
+
+  int r = getsockopt(pipe, SOL_SOCKET, SO_RCVBUF, (char *) &value, &size);
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  return value;
+}
+
+int pipe_shutdown(SOCKET pipe, bool write)
+{
+  assert(pipe != PIPE_INVALID);
+
+  int r = shutdown(pipe, write ? SD_SEND : SD_RECEIVE);
+  return r < 0 ? error_unify(r) : 0;
+}
+
 int pipe_wait(pipe_set *sets, size_t num_sets, int timeout)
 {
+  static const int EVENTS[PIPES_PER_SET] = { PIPE_EVENT_IN, PIPE_EVENT_OUT,
+                                             PIPE_EVENT_ERR, PIPE_EVENT_EXIT,
+                                             PIPE_EVENT_START };
+
   assert(num_sets * PIPES_PER_SET <= INT_MAX);
 
   WSAPOLLFD *pollfds = NULL;
@@ -198,6 +373,7 @@ int pipe_wait(pipe_set *sets, size_t num_sets, int timeout)
     pollfds[j + 1] = (WSAPOLLFD){ .fd = sets[i].out, .events = POLLIN };
     pollfds[j + 2] = (WSAPOLLFD){ .fd = sets[i].err, .events = POLLIN };
     pollfds[j + 3] = (WSAPOLLFD){ .fd = sets[i].exit };
+    pollfds[j + 4] = (WSAPOLLFD){ .fd = sets[i].start, .events = POLLIN };
   }
 
   r = WSAPoll(pollfds, (ULONG) num_pipes, timeout);
@@ -213,7 +389,7 @@ int pipe_wait(pipe_set *sets, size_t num_sets, int timeout)
     WSAPOLLFD pollfd = pollfds[i];
 
     if (pollfd.revents > 0 && pollfd.revents != POLLNVAL) {
-      int event = 1 << (i % PIPES_PER_SET);
+      int event = EVENTS[i % PIPES_PER_SET];
       sets[i / PIPES_PER_SET].events |= event;
     }
   }
@@ -229,7 +405,7 @@ int pipe_wait(pipe_set *sets, size_t num_sets, int timeout)
 finish:
   free(pollfds);
 
-  return r;
+  return error_unify(r);
 }
 
 SOCKET pipe_destroy(SOCKET pipe)
@@ -0,0 +1,173 @@
+#include <reproc/pipeline.h>
+
+#include "clock.h"
+#include "error.h"
+#include "handle.h"
+#include "macro.h"
+#include "pipe.h"
+#include "redirect.h"
+
+int reproc_pipeline_start(reproc_t *const *stages,
+                          const char *const *const *argvs,
+                          size_t num_stages,
+                          reproc_options options)
+{
+  ASSERT_EINVAL(stages);
+  ASSERT_EINVAL(argvs);
+  ASSERT_EINVAL(num_stages > 0);
+  ASSERT_EINVAL(!options.fork);
+
+  // Read end of the pipe between the previous stage and the current stage.
+  pipe_type in = PIPE_INVALID;
+  // Both ends of the pipe between the current stage and the next stage.
+  pipe_type out = PIPE_INVALID;
+  handle_type child = HANDLE_INVALID;
+  size_t i = 0;
+  int r = 0;
+
+  for (i = 0; i < num_stages; i++) {
+    reproc_options stage = options;
+
+    if (i > 0) {
+      stage.redirect.in = (reproc_redirect){ .type = REPROC_REDIRECT_HANDLE,
+                                             .handle = (handle_type) in };
+      stage.input.data = NULL;
+      stage.input.size = 0;
+    }
+
+    if (i < num_stages - 1) {
+      // The pipes between stages get the capacity requested for stdout.
+      reproc_redirect pipe = { .type = REPROC_REDIRECT_PIPE,
+                               .pipe_size = options.redirect.out.pipe_size };
+
+      r = redirect_init(&out, &child, REPROC_STREAM_OUT, pipe, false,
+                        HANDLE_INVALID);
+      if (r < 0) {
+        goto finish;
+      }
+
+      stage.redirect.out = (reproc_redirect){ .type = REPROC_REDIRECT_HANDLE,
+                                              .handle = child };
+
+      if (stage.redirect.file) {
+        stage.redirect.err = (reproc_redirect){ .type = REPROC_REDIRECT_FILE,
+                                                .file = stage.redirect.file };
+        stage.redirect.file = NULL;
+      }
+    }
+
+    r = reproc_start(stages[i], argvs[i], stage);
+
+    // The child process has its own copies of its ends of the pipes so we close
+    // ours to make sure each stage sees end of file when the previous stage
+    // exits.
+    in = pipe_destroy(in);
+    child = redirect_destroy(child, REPROC_REDIRECT_PIPE);
+
+    if (r < 0) {
+      goto finish;
+    }
+
+    in = out;
+    out = PIPE_INVALID;
+  }
+
+finish:
+  pipe_destroy(in);
+  pipe_destroy(out);
+  redirect_destroy(child, REPROC_REDIRECT_PIPE);
+
+  if (r < 0) {
+    for (size_t j = 0; j < i; j++) {
+      reproc_kill(stages[j]);
+      reproc_wait(stages[j], REPROC_INFINITE);
+    }
+
+    return r;
+  }
+
+  return 0;
+}
+
+int reproc_pipeline_wait(reproc_t *const *stages,
+                         size_t num_stages,
+                         int timeout,
+                         int *statuses)
+{
+  ASSERT_EINVAL(stages);
+  ASSERT_EINVAL(num_stages > 0);
+
+  // `REPROC_INFINITE` and `REPROC_DEADLINE` are passed on as is.
+  int64_t end = timeout >= 0 ? reproc_now() + timeout : timeout;
+  int error = 0;
+  int r = -1;
+
+  for (size_t i = 0; i < num_stages; i++) {
+    if (end >= 0) {
+      int64_t now = reproc_now();
+      timeout = now >= end ? 0 : (int) (end - now);
+    }
+
+    // Keep going after an error so `statuses` is filled in for every stage.
+    r = reproc_wait(stages[i], timeout);
+
+    if (statuses != NULL) {
+      statuses[i] = r;
+    }
+
+    if (r < 0 && error == 0) {
+      error = r;
+    }
+  }
+
+  return error < 0 ? error : r;
+}
+
+int reproc_pipeline_stop(reproc_t *const *stages,
+                         size_t num_stages,
+                         reproc_stop_actions stop,
+                         int *statuses)
+{
+  ASSERT_EINVAL(stages);
+  ASSERT_EINVAL(num_stages > 0);
+
+  reproc_stop_action actions[] = { stop.first, stop.second, stop.third };
+  int r = -1;
+
+  for (size_t i = 0; i < ARRAY_SIZE(actions); i++) {
+    r = REPROC_EINVAL; // NOLINT
+
+    switch (actions[i].action) {
+      case REPROC_STOP_NOOP:
+        r = 0;
+        continue;
+      case REPROC_STOP_WAIT:
+        r = 0;
+        break;
+      case REPROC_STOP_TERMINATE:
+      case REPROC_STOP_KILL:
+        r = 0;
+
+        for (size_t j = 0; j < num_stages; j++) {
+          int s = actions[i].action == REPROC_STOP_TERMINATE
+                      ? reproc_terminate(stages[j])
+                      : reproc_kill(stages[j]);
+          r = r < 0 ? r : s;
+        }
+
+        break;
+    }
+
+    // Stop if `reproc_terminate` or `reproc_kill` fail.
+    if (r < 0) {
+      break;
+    }
+
+    r = reproc_pipeline_wait(stages, num_stages, actions[i].timeout, statuses);
+    if (r != REPROC_ETIMEDOUT) {
+      break;
+    }
+  }
+
+  return r;
+}
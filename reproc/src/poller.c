@@ -0,0 +1,1156 @@
+#include <reproc/reproc.h>
+
+#include "clock.h"
+#include "error.h"
+#include "macro.h"
+#include "pipe.h"
+#include "poller.h"
+#include "reaper.h"
+#include "ring.h"
+#include "state.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+// Reported by a poller instead of a slot when the self-pipe of the reaper is
+// readable, when its timer expires or when its ring has completions.
+#define WATCH_REAPER UINT64_MAX
+#define WATCH_TIMER (UINT64_MAX - 1)
+#define WATCH_RING (UINT64_MAX - 2)
+
+// Amount of output read for each completion reported by a poller without a
+// ring.
+enum { COMPLETION_SIZE = 8192 };
+
+struct reproc_poller_t {
+  poller_type *poller;
+  reproc_t **processes;
+  size_t size;
+  size_t capacity;
+  // Amount of pipes of `processes` registered with `poller`.
+  size_t pipes;
+  // Amount of `processes` whose exit is reported by the reaper. The self-pipe
+  // of the reaper is registered with `poller` as long as this isn't zero.
+  size_t reaped;
+  // Min-heap of the `processes` that have a deadline and haven't been waited
+  // for yet, ordered by deadline. Has the same capacity as `processes`.
+  reproc_t **heap;
+  size_t heap_size;
+  // Set if the internal poller supports timers, in which case its timer is
+  // armed for the deadline in `armed` instead of shortening the timeout of
+  // every wait until the earliest deadline. The timer stays ready once it
+  // expires so an expired deadline keeps being reported until it's removed
+  // from the heap.
+  bool timer;
+  int64_t armed;
+  // Reused by every call to `reproc_poller_wait`.
+  poller_event *ready;
+  size_t num_ready;
+  // Set once the poller is used with `reproc_poller_complete` or
+  // `reproc_poller_write` (see `watched_interests`).
+  bool complete;
+  // Reads from and writes to stdin, stdout and stderr of `processes` if
+  // io_uring is available. Otherwise, they're read from and written to once
+  // they're ready.
+  ring_type *ring;
+  // Operations submitted to `ring`, indexed by the data they report. An
+  // operation that was cancelled doesn't have a process anymore but stays in
+  // use until its last completion is reaped. Free operations are linked
+  // through `next`, starting from the one-based position in `free`.
+  struct {
+    reproc_t *process;
+    size_t slot;
+    size_t next;
+  } *ops;
+  size_t num_ops;
+  size_t free;
+  // Amount of operations in `ops` that still have a process.
+  size_t operations;
+  // Reused by every call to `reproc_poller_complete`.
+  reproc_poller_event *events;
+  ring_completion *finished;
+  // Output reported by the previous call to `reproc_poller_complete`, which is
+  // recycled by the next one. Without a ring, output is read into `buffer`
+  // instead, which has room for `COMPLETION_SIZE` bytes for each completion.
+  const uint8_t **used;
+  size_t num_used;
+  uint8_t *buffer;
+  size_t num_completions;
+};
+
+// Returns the interests of `process` that its poller watches pipes for. In
+// completion mode, stdin is only watched while a write is queued and a ring
+// takes care of stdin, stdout and stderr without watching them at all.
+static int watched_interests(reproc_t *process)
+{
+  reproc_poller_t *poller = process->watch.poller;
+  int interests = process->watch.interests;
+
+  if (!poller->complete) {
+    return interests;
+  }
+
+  interests &= ~REPROC_EVENT_IN;
+
+  if (poller->ring != NULL) {
+    return interests & ~(REPROC_EVENT_OUT | REPROC_EVENT_ERR);
+  }
+
+  return process->watch.write.data != NULL ? interests | REPROC_EVENT_IN
+                                           : interests;
+}
+
+// Returns the pipe of `process` that its poller should watch in `slot` or
+// `PIPE_INVALID` if there's none. The `POLLER` events to watch it for are
+// stored in `events`.
+static pipe_type watched_pipe(reproc_t *process, size_t slot, int *events)
+{
+  int interests = watched_interests(process);
+  pipe_type in = process->pipe.in;
+  pipe_type out = process->pipe.out;
+
+  *events = POLLER_IN;
+
+  switch (slot) {
+    case WATCH_IN:
+      // A socket shared by stdin and stdout can only be registered once so
+      // it's watched for both directions in this slot.
+      *events = POLLER_OUT | (interests & REPROC_EVENT_OUT && out == in
+                                  ? POLLER_IN
+                                  : 0);
+      return interests & REPROC_EVENT_IN ? in : PIPE_INVALID;
+    case WATCH_OUT:
+      return interests & REPROC_EVENT_OUT &&
+                     !(out == in && interests & REPROC_EVENT_IN)
+                 ? out
+                 : PIPE_INVALID;
+    case WATCH_ERR:
+      return interests & REPROC_EVENT_ERR ? process->pipe.err : PIPE_INVALID;
+    case WATCH_EXIT:
+      return interests & REPROC_EVENT_EXIT ? process->pipe.exit
+                                           : PIPE_INVALID;
+    case WATCH_START:
+      return interests & REPROC_EVENT_START ? process->pipe.start
+                                            : PIPE_INVALID;
+  }
+
+  size_t index = slot - WATCH_EXTRA;
+
+  if (index >= process->extra.size ||
+      !(interests & REPROC_EVENT_EXTRA(index))) {
+    return PIPE_INVALID;
+  }
+
+  *events = process->extra.in & (1 << index) ? POLLER_OUT : POLLER_IN;
+
+  return process->extra.pipe[index];
+}
+
+// Returns the `REPROC_EVENT` flags that correspond to the `POLLER` events in
+// `events` occurring for the pipe watched in `slot`.
+static int watched_events(size_t slot, int events)
+{
+  switch (slot) {
+    case WATCH_IN:
+      return (events & POLLER_OUT ? REPROC_EVENT_IN : 0) |
+             (events & POLLER_IN ? REPROC_EVENT_OUT : 0);
+    case WATCH_OUT:
+      return REPROC_EVENT_OUT;
+    case WATCH_ERR:
+      return REPROC_EVENT_ERR;
+    case WATCH_EXIT:
+      return REPROC_EVENT_EXIT;
+    case WATCH_START:
+      return REPROC_EVENT_START;
+  }
+
+  return REPROC_EVENT_EXTRA(slot - WATCH_EXTRA);
+}
+
+static void heap_place(reproc_poller_t *poller, size_t i, reproc_t *process)
+{
+  poller->heap[i] = process;
+  process->watch.heap = i;
+}
+
+static void heap_up(reproc_poller_t *poller, size_t i)
+{
+  reproc_t *process = poller->heap[i];
+
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+
+    if (poller->heap[parent]->deadline <= process->deadline) {
+      break;
+    }
+
+    heap_place(poller, i, poller->heap[parent]);
+    i = parent;
+  }
+
+  heap_place(poller, i, process);
+}
+
+static void heap_down(reproc_poller_t *poller, size_t i)
+{
+  reproc_t *process = poller->heap[i];
+
+  while (true) {
+    size_t child = 2 * i + 1;
+
+    if (child >= poller->heap_size) {
+      break;
+    }
+
+    if (child + 1 < poller->heap_size &&
+        poller->heap[child + 1]->deadline < poller->heap[child]->deadline) {
+      child++;
+    }
+
+    if (process->deadline <= poller->heap[child]->deadline) {
+      break;
+    }
+
+    heap_place(poller, i, poller->heap[child]);
+    i = child;
+  }
+
+  heap_place(poller, i, process);
+}
+
+static void heap_push(reproc_poller_t *poller, reproc_t *process)
+{
+  heap_place(poller, poller->heap_size++, process);
+  heap_up(poller, process->watch.heap);
+  process->watch.timed = true;
+}
+
+static void heap_erase(reproc_poller_t *poller, reproc_t *process)
+{
+  size_t i = process->watch.heap;
+  reproc_t *last = poller->heap[--poller->heap_size];
+
+  process->watch.timed = false;
+
+  if (last == process) {
+    return;
+  }
+
+  // Move the last process into the hole and restore the heap property in
+  // whichever direction it's violated.
+  heap_place(poller, i, last);
+  heap_down(poller, i);
+  heap_up(poller, last->watch.heap);
+}
+
+// Returns the pipe of `process` that the ring of its poller should read from or
+// write to in `slot` or `PIPE_INVALID` if there's none.
+static pipe_type ringed_pipe(reproc_t *process, size_t slot)
+{
+  int interests = process->watch.interests;
+
+  switch (slot) {
+    case WATCH_IN:
+      return process->watch.write.data != NULL ? process->pipe.in
+                                               : PIPE_INVALID;
+    case WATCH_OUT:
+      return interests & REPROC_EVENT_OUT ? process->pipe.out : PIPE_INVALID;
+    case WATCH_ERR:
+      return interests & REPROC_EVENT_ERR ? process->pipe.err : PIPE_INVALID;
+  }
+
+  return PIPE_INVALID;
+}
+
+// Submits a write of the queued input of `process` (`WATCH_IN`) or a read of
+// its output (`WATCH_OUT` and `WATCH_ERR`) from `pipe` to the ring of its
+// poller.
+static int submit(reproc_t *process, size_t slot, pipe_type pipe)
+{
+  reproc_poller_t *poller = process->watch.poller;
+
+  if (poller->free == 0) {
+    size_t num_ops = poller->num_ops == 0 ? 16 : poller->num_ops * 2;
+
+    void *ops = realloc(poller->ops, num_ops * sizeof(*poller->ops));
+    if (ops == NULL) {
+      return REPROC_ENOMEM;
+    }
+
+    poller->ops = ops;
+
+    for (size_t i = poller->num_ops; i < num_ops; i++) {
+      poller->ops[i].process = NULL;
+      poller->ops[i].next = i + 1 < num_ops ? i + 2 : 0;
+    }
+
+    poller->free = poller->num_ops + 1;
+    poller->num_ops = num_ops;
+  }
+
+  size_t op = poller->free - 1;
+  int r = -1;
+
+  if (slot == WATCH_IN) {
+    r = ring_write(poller->ring, pipe, process->watch.write.data,
+                   process->watch.write.size, process->socket, op);
+  } else {
+    r = ring_read(poller->ring, pipe, op);
+  }
+
+  if (r < 0) {
+    return r;
+  }
+
+  poller->free = poller->ops[op].next;
+  poller->ops[op].process = process;
+  poller->ops[op].slot = slot;
+  poller->operations++;
+  process->watch.ops[slot] = op + 1;
+
+  return 0;
+}
+
+// Cancels the operation submitted for `process` in `slot`. The operation stays
+// in use without a process until its last completion is reaped.
+static void cancel(reproc_t *process, size_t slot)
+{
+  reproc_poller_t *poller = process->watch.poller;
+  size_t op = process->watch.ops[slot] - 1;
+
+  poller->ops[op].process = NULL;
+  poller->operations--;
+  process->watch.ops[slot] = 0;
+
+  ring_cancel(poller->ring, op);
+}
+
+int watch(reproc_t *process)
+{
+  reproc_poller_t *poller = process->watch.poller;
+  if (poller == NULL) {
+    return 0;
+  }
+
+  pipe_type pipes[WATCH_SLOTS];
+  int events[WATCH_SLOTS];
+
+  for (size_t i = 0; i < WATCH_SLOTS; i++) {
+    pipes[i] = watched_pipe(process, i, &events[i]);
+  }
+
+  // Remove everything that changed first since a socket shared by stdin and
+  // stdout can move to another slot.
+  for (size_t i = 0; i < WATCH_SLOTS; i++) {
+    pipe_type pipe = process->watch.pipes[i].pipe;
+
+    if (pipe == PIPE_INVALID ||
+        (pipe == pipes[i] && process->watch.pipes[i].events == events[i])) {
+      continue;
+    }
+
+    // Errors don't matter here since the pipe isn't reported anymore either
+    // way.
+    poller_remove(poller->poller, pipe);
+    process->watch.pipes[i].pipe = PIPE_INVALID;
+    poller->pipes--;
+  }
+
+  for (size_t i = 0; i < WATCH_SLOTS; i++) {
+    if (pipes[i] == PIPE_INVALID ||
+        process->watch.pipes[i].pipe != PIPE_INVALID) {
+      continue;
+    }
+
+    uint64_t data = process->watch.index * WATCH_SLOTS + i;
+
+    int r = poller_add(poller->poller, pipes[i], events[i], data);
+    if (r < 0) {
+      return r;
+    }
+
+    process->watch.pipes[i].pipe = pipes[i];
+    process->watch.pipes[i].events = events[i];
+    poller->pipes++;
+  }
+
+  for (size_t i = 0; poller->ring != NULL && i < WATCH_EXIT; i++) {
+    pipe_type pipe = ringed_pipe(process, i);
+
+    if (pipe == PIPE_INVALID && process->watch.ops[i] != 0) {
+      cancel(process, i);
+    } else if (pipe != PIPE_INVALID && process->watch.ops[i] == 0) {
+      int r = submit(process, i, pipe);
+      if (r < 0) {
+        return r;
+      }
+    }
+  }
+
+  // Processes waited for by the reaper don't have an exit handle. Instead, the
+  // poller watches the self-pipe of the reaper and checks which of them exited
+  // whenever it becomes readable.
+  bool reaped = process->watch.interests & REPROC_EVENT_EXIT &&
+                process->reaper && process->status < 0;
+
+  if (reaped && !process->watch.reaped) {
+    if (poller->reaped == 0) {
+      int r = poller_add(poller->poller, reaper_pipe(), POLLER_IN,
+                         WATCH_REAPER);
+      if (r < 0) {
+        return r;
+      }
+    }
+
+    poller->reaped++;
+    process->watch.reaped = true;
+  } else if (!reaped && process->watch.reaped) {
+    poller->reaped--;
+    process->watch.reaped = false;
+
+    if (poller->reaped == 0) {
+      poller_remove(poller->poller, reaper_pipe());
+    }
+  }
+
+  // Processes that have been waited for can't miss their deadline anymore.
+  bool timed = process->deadline != REPROC_INFINITE && process->status < 0;
+
+  if (timed && !process->watch.timed) {
+    heap_push(poller, process);
+  } else if (!timed && process->watch.timed) {
+    heap_erase(poller, process);
+  }
+
+  return 0;
+}
+
+reproc_poller_t *reproc_poller_new(void)
+{
+  reproc_poller_t *poller = calloc(1, sizeof(reproc_poller_t));
+  if (poller == NULL) {
+    return NULL;
+  }
+
+  int r = poller_init(&poller->poller);
+  if (r < 0) {
+    free(poller);
+    return NULL;
+  }
+
+  poller->timer = true;
+  poller->armed = REPROC_INFINITE;
+
+  return poller;
+}
+
+// Updates the data reported for the pipes of `process` after it moved to
+// another position in its poller.
+static void rewatch(reproc_t *process)
+{
+  reproc_poller_t *poller = process->watch.poller;
+
+  for (size_t i = 0; i < WATCH_SLOTS; i++) {
+    if (process->watch.pipes[i].pipe == PIPE_INVALID) {
+      continue;
+    }
+
+    // Modifying a pipe that is already registered doesn't fail.
+    poller_modify(poller->poller, process->watch.pipes[i].pipe,
+                  process->watch.pipes[i].events,
+                  process->watch.index * WATCH_SLOTS + i);
+  }
+}
+
+int reproc_poller_add(reproc_poller_t *poller,
+                      reproc_t *process,
+                      int interests,
+                      void *context)
+{
+  ASSERT_EINVAL(poller);
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+  ASSERT_EINVAL(process->status != STATUS_NOT_STARTED);
+  ASSERT_EINVAL(process->watch.poller == NULL);
+
+  if (poller->size == poller->capacity) {
+    size_t capacity = poller->capacity == 0 ? 16 : poller->capacity * 2;
+
+    reproc_t **processes = realloc(poller->processes,
+                                   capacity * sizeof(reproc_t *));
+    if (processes == NULL) {
+      return REPROC_ENOMEM;
+    }
+
+    poller->processes = processes;
+
+    // Growing the heap along with `processes` means pushing to it can't fail.
+    reproc_t **heap = realloc(poller->heap, capacity * sizeof(reproc_t *));
+    if (heap == NULL) {
+      return REPROC_ENOMEM;
+    }
+
+    poller->heap = heap;
+    poller->capacity = capacity;
+  }
+
+  process->watch.poller = poller;
+  process->watch.index = poller->size;
+  process->watch.interests = interests;
+  process->watch.context = context;
+
+  poller->processes[poller->size++] = process;
+
+  int r = watch(process);
+  if (r < 0) {
+    reproc_poller_remove(poller, process);
+    return r;
+  }
+
+  return 0;
+}
+
+int reproc_poller_modify(reproc_poller_t *poller,
+                         reproc_t *process,
+                         int interests)
+{
+  ASSERT_EINVAL(poller);
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->watch.poller == poller);
+
+  process->watch.interests = interests;
+
+  return watch(process);
+}
+
+int reproc_poller_remove(reproc_poller_t *poller, reproc_t *process)
+{
+  ASSERT_EINVAL(poller);
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->watch.poller == poller);
+
+  // Without interests or a queued write, `watch` only removes pipes from the
+  // poller and cancels the operations submitted to its ring.
+  process->watch.interests = 0;
+  process->watch.write.data = NULL;
+  process->watch.write.size = 0;
+  watch(process);
+
+  if (process->watch.timed) {
+    heap_erase(poller, process);
+  }
+
+  size_t index = process->watch.index;
+  poller->size--;
+
+  if (index != poller->size) {
+    reproc_t *moved = poller->processes[poller->size];
+    poller->processes[index] = moved;
+    moved->watch.index = index;
+    rewatch(moved);
+  }
+
+  process->watch.poller = NULL;
+
+  return 0;
+}
+
+// Adds `event` to the events reported for `process` by the ongoing call to
+// `reproc_poller_wait`. Returns the new amount of events in `events`. If
+// `events` is full, `process` is left for the next call to report.
+static size_t report(reproc_poller_event *events,
+                     size_t num_events,
+                     size_t count,
+                     reproc_t *process,
+                     int event)
+{
+  if (process->watch.ready == 0) {
+    if (count == num_events) {
+      return count;
+    }
+
+    events[count] = (reproc_poller_event){ .process = process,
+                                           .context = process->watch.context };
+    process->watch.ready = ++count;
+  }
+
+  events[process->watch.ready - 1].events |= event;
+
+  return count;
+}
+
+// Reports the exit of the processes in `poller` waited for by the reaper that
+// have exited. Returns the new amount of events in `events`.
+static size_t report_reaped(reproc_poller_t *poller,
+                            reproc_poller_event *events,
+                            size_t num_events,
+                            size_t count)
+{
+  int status = 0;
+
+  for (size_t i = 0; i < poller->size; i++) {
+    reproc_t *process = poller->processes[i];
+
+    if (process->watch.reaped && reaper_exited(process->handle, &status)) {
+      count = report(events, num_events, count, process, REPROC_EVENT_EXIT);
+    }
+  }
+
+  return count;
+}
+
+// Reports the expiry of the deadlines in the subtree of the deadline heap of
+// `poller` rooted at `i` that expired at `now`. Subtrees whose root hasn't
+// expired are skipped so this only visits the expired processes and their
+// children. Returns the new amount of events in `events`.
+static size_t report_expired(reproc_poller_t *poller,
+                             size_t i,
+                             int64_t now,
+                             reproc_poller_event *events,
+                             size_t num_events,
+                             size_t count)
+{
+  if (i >= poller->heap_size || poller->heap[i]->deadline > now) {
+    return count;
+  }
+
+  count = report(events, num_events, count, poller->heap[i],
+                 REPROC_EVENT_DEADLINE);
+  count = report_expired(poller, 2 * i + 1, now, events, num_events, count);
+  count = report_expired(poller, 2 * i + 2, now, events, num_events, count);
+
+  return count;
+}
+
+// Reports the first `num_ready` pipes that the internal poller of `poller`
+// found to be ready. `readable` is set if the self-pipe of the reaper is one
+// of them, `fired` is set if the timer of `poller` expired and `completed` is
+// set if its ring has completions. Returns the new amount of events in
+// `events`.
+static size_t report_ready(reproc_poller_t *poller,
+                           size_t num_ready,
+                           reproc_poller_event *events,
+                           size_t num_events,
+                           size_t count,
+                           bool *readable,
+                           bool *fired,
+                           bool *completed)
+{
+  for (size_t i = 0; i < num_ready; i++) {
+    poller_event ready = poller->ready[i];
+
+    if (ready.data == WATCH_REAPER) {
+      *readable = true;
+      continue;
+    }
+
+    if (ready.data == WATCH_TIMER) {
+      *fired = true;
+      continue;
+    }
+
+    if (ready.data == WATCH_RING) {
+      *completed = true;
+      continue;
+    }
+
+    reproc_t *process = poller->processes[ready.data / WATCH_SLOTS];
+    size_t slot = ready.data % WATCH_SLOTS;
+    int occurred = ready.events & process->watch.pipes[slot].events;
+
+    if (occurred != 0) {
+      count = report(events, num_events, count, process,
+                     watched_events(slot, occurred));
+    }
+  }
+
+  return count;
+}
+
+// Waits until events occur for the processes in `poller` or until its ring has
+// completions. Returns the amount of events stored in `events`, which is zero
+// if only the ring has completions.
+static int wait_events(reproc_poller_t *poller,
+                       reproc_poller_event *events,
+                       size_t num_events,
+                       int timeout)
+{
+  if (poller->pipes == 0 && poller->reaped == 0 && poller->operations == 0) {
+    return REPROC_EPIPE;
+  }
+
+  // Leave room for the self-pipe of the reaper, the timer and the ring.
+  size_t num_ready = num_events + 3;
+
+  if (poller->num_ready < num_ready) {
+    poller_event *ready = realloc(poller->ready,
+                                  num_ready * sizeof(poller_event));
+    if (ready == NULL) {
+      return REPROC_ENOMEM;
+    }
+
+    poller->ready = ready;
+    poller->num_ready = num_ready;
+  }
+
+  int64_t deadline = poller->heap_size > 0 ? poller->heap[0]->deadline
+                                            : REPROC_INFINITE;
+
+  if (poller->timer && poller->armed != deadline) {
+    int r = poller_timer(poller->poller, deadline, WATCH_TIMER);
+    // Fall back to shortening the timeout if the timer isn't supported.
+    poller->timer = r == 0;
+    poller->armed = r == 0 ? deadline : REPROC_INFINITE;
+  }
+
+  // With a timer, the expiry of `deadline` is reported like any other event.
+  bool timer = poller->timer && deadline != REPROC_INFINITE;
+  bool expires = !timer && expires_first(timeout, deadline);
+  int first = timer ? timeout : expiry(timeout, deadline);
+  int64_t end = first == REPROC_INFINITE ? REPROC_INFINITE
+                                         : reproc_now() + first;
+
+  bool reaped = poller->reaped > 0;
+  bool fired = false;
+  bool completed = false;
+  size_t count = 0;
+  int r = -1;
+
+  while (true) {
+    if (reaped) {
+      reaper_enter();
+
+      count = report_reaped(poller, events, num_events, 0);
+      if (count > 0) {
+        reaper_leave(false);
+        break;
+      }
+    }
+
+    r = poller_wait(poller->poller, poller->ready, num_ready, remaining(end));
+
+    bool readable = false;
+
+    if (r > 0) {
+      count = report_ready(poller, (size_t) r, events, num_events, count,
+                           &readable, &fired, &completed);
+    }
+
+    if (reaped) {
+      reaper_leave(readable);
+
+      if (r >= 0) {
+        count = report_reaped(poller, events, num_events, count);
+      }
+    }
+
+    if (count > 0 || fired || completed) {
+      break;
+    }
+
+    // The `SIGCHLD` handler of the reaper and the task work that posts the
+    // completions of a ring interrupt `epoll_wait`.
+    if (r < 0 && (r != -EINTR || !(reaped || poller->ring != NULL))) {
+      break;
+    }
+  }
+
+  // Deadline expiry is an event, timeout is an error. All deadlines that
+  // expired are reported at once, along with any other events.
+  if (r >= 0 || r == REPROC_ETIMEDOUT) {
+    bool expired = fired || (r == REPROC_ETIMEDOUT && expires);
+    int64_t now = expired_at(deadline, expired);
+    count = report_expired(poller, 0, now, events, num_events, count);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    reproc_t *process = events[i].process;
+    process->watch.ready = 0;
+
+    if (events[i].events & REPROC_EVENT_START) {
+      collect_start(process);
+
+      if (process->error < 0) {
+        events[i].events |= REPROC_EVENT_EXIT;
+      }
+    }
+  }
+
+  return count > 0 || completed ? (int) count : r;
+}
+
+int reproc_poller_wait(reproc_poller_t *poller,
+                       reproc_poller_event *events,
+                       size_t num_events,
+                       int timeout)
+{
+  ASSERT_EINVAL(poller);
+  ASSERT_EINVAL(events);
+  ASSERT_EINVAL(num_events > 0);
+  ASSERT_EINVAL(!poller->complete);
+
+  return wait_events(poller, events, num_events, timeout);
+}
+
+// Switches `poller` to completion mode. Stdin, stdout and stderr are handed
+// over to a ring if io_uring is available.
+static int complete_mode(reproc_poller_t *poller)
+{
+  if (poller->complete) {
+    return 0;
+  }
+
+  poller->complete = true;
+
+  // Without a ring, we fall back to reading from and writing to pipes once
+  // they're ready.
+  if (ring_init(&poller->ring) == 0) {
+    int r = poller_add(poller->poller, ring_handle(poller->ring), POLLER_IN,
+                       WATCH_RING);
+    if (r < 0) {
+      poller->ring = ring_destroy(poller->ring);
+    }
+  }
+
+  for (size_t i = 0; i < poller->size; i++) {
+    int r = watch(poller->processes[i]);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  return 0;
+}
+
+int reproc_poller_write(reproc_poller_t *poller,
+                        reproc_t *process,
+                        const uint8_t *buffer,
+                        size_t size)
+{
+  ASSERT_EINVAL(poller);
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->watch.poller == poller);
+  ASSERT_EINVAL(buffer && size > 0);
+  ASSERT_EINVAL(process->watch.write.data == NULL);
+
+  if (process->pipe.in == PIPE_INVALID) {
+    return REPROC_EPIPE;
+  }
+
+  int r = complete_mode(poller);
+  if (r < 0) {
+    return r;
+  }
+
+  process->watch.write.data = buffer;
+  process->watch.write.size = size;
+
+  r = watch(process);
+  if (r < 0) {
+    process->watch.write.data = NULL;
+    process->watch.write.size = 0;
+    watch(process);
+  }
+
+  return r;
+}
+
+// Grows the buffers reused by every call to `reproc_poller_complete` so they
+// have room for `num_completions` completions.
+static int reserve(reproc_poller_t *poller, size_t num_completions)
+{
+  if (poller->num_completions >= num_completions) {
+    return 0;
+  }
+
+  void *events = realloc(poller->events,
+                         num_completions * sizeof(reproc_poller_event));
+  if (events == NULL) {
+    return REPROC_ENOMEM;
+  }
+
+  poller->events = events;
+
+  void *finished = realloc(poller->finished,
+                           num_completions * sizeof(ring_completion));
+  if (finished == NULL) {
+    return REPROC_ENOMEM;
+  }
+
+  poller->finished = finished;
+
+  void *used = realloc(poller->used, num_completions * sizeof(uint8_t *));
+  if (used == NULL) {
+    return REPROC_ENOMEM;
+  }
+
+  poller->used = used;
+
+  if (poller->ring == NULL) {
+    void *buffer = realloc(poller->buffer, num_completions * COMPLETION_SIZE);
+    if (buffer == NULL) {
+      return REPROC_ENOMEM;
+    }
+
+    poller->buffer = buffer;
+  }
+
+  poller->num_completions = num_completions;
+
+  return 0;
+}
+
+// Turns the completions of the ring of `poller` into completions of its
+// processes. Returns the new amount of completions in `completions`.
+static size_t complete_ring(reproc_poller_t *poller,
+                            reproc_completion *completions,
+                            size_t num_completions,
+                            size_t count)
+{
+  size_t num_finished = ring_reap(poller->ring, poller->finished,
+                                  num_completions - count);
+
+  for (size_t i = 0; i < num_finished; i++) {
+    ring_completion reaped = poller->finished[i];
+    size_t op = (size_t) reaped.data;
+    reproc_t *process = poller->ops[op].process;
+    size_t slot = poller->ops[op].slot;
+
+    if (!reaped.more) {
+      poller->ops[op].process = NULL;
+      poller->ops[op].next = poller->free;
+      poller->free = op + 1;
+
+      if (process != NULL) {
+        poller->operations--;
+        process->watch.ops[slot] = 0;
+      }
+    }
+
+    // Cancelled operations and reads that ran out of buffers don't have
+    // anything to report.
+    if (process == NULL || reaped.result == 0) {
+      ring_recycle(poller->ring, reaped.buffer);
+    } else {
+      completions[count++] = (reproc_completion){
+        .process = process,
+        .context = process->watch.context,
+        .events = slot == WATCH_IN    ? REPROC_EVENT_IN
+                  : slot == WATCH_OUT ? REPROC_EVENT_OUT
+                                      : REPROC_EVENT_ERR,
+        .result = reaped.result,
+        .data = reaped.buffer
+      };
+
+      if (reaped.buffer != NULL) {
+        poller->used[poller->num_used++] = reaped.buffer;
+      }
+    }
+
+    if (process == NULL || reaped.more) {
+      continue;
+    }
+
+    if (slot == WATCH_IN) {
+      process->watch.write.data = NULL;
+      process->watch.write.size = 0;
+    }
+
+    // Same as `reproc_read` and `reproc_write`, we close the stream once its
+    // other end is closed. Reads that fail don't get another chance.
+    if (reaped.result == REPROC_EPIPE ||
+        (slot != WATCH_IN && reaped.result < 0)) {
+      close_stream(process, (REPROC_STREAM) slot);
+    } else {
+      // Submits the read again. This reuses the operation that just completed
+      // so it can't run out of memory.
+      watch(process);
+    }
+  }
+
+  return count;
+}
+
+// Turns `event` of `process` into a completion by reading from or writing to
+// its pipe or by waiting for it. Returns the new amount of completions in
+// `completions`, which stays the same if the pipe turned out not to be ready.
+static size_t complete_event(reproc_poller_t *poller,
+                             reproc_t *process,
+                             int event,
+                             reproc_completion *completions,
+                             size_t count)
+{
+  reproc_completion *completion = &completions[count];
+  uint8_t *buffer = poller->buffer + count * COMPLETION_SIZE;
+  int r = 0;
+
+  *completion = (reproc_completion){ .process = process,
+                                     .context = process->watch.context,
+                                     .events = event };
+
+  switch (event) {
+    case REPROC_EVENT_IN:
+      r = reproc_write(process, process->watch.write.data,
+                       process->watch.write.size);
+      if (r != REPROC_EWOULDBLOCK) {
+        process->watch.write.data = NULL;
+        process->watch.write.size = 0;
+        // Stops watching stdin, which can't fail.
+        watch(process);
+      }
+      break;
+    case REPROC_EVENT_OUT:
+    case REPROC_EVENT_ERR:
+      r = reproc_read(process,
+                      event == REPROC_EVENT_OUT ? REPROC_STREAM_OUT
+                                                : REPROC_STREAM_ERR,
+                      buffer, COMPLETION_SIZE);
+      completion->data = r > 0 ? buffer : NULL;
+      break;
+    case REPROC_EVENT_EXIT:
+      r = reproc_wait(process, 0);
+      break;
+  }
+
+  if (r == REPROC_EWOULDBLOCK || r == REPROC_ETIMEDOUT) {
+    return count;
+  }
+
+  completion->result = r;
+
+  return count + 1;
+}
+
+// Turns the `num_events` events in `poller->events` into completions. Returns
+// the new amount of completions in `completions`. Events that don't fit are
+// dropped. The poller reports them again since they stay pending until they're
+// handled.
+static size_t complete_events(reproc_poller_t *poller,
+                              size_t num_events,
+                              reproc_completion *completions,
+                              size_t num_completions,
+                              size_t count)
+{
+  static const int handled[] = { REPROC_EVENT_IN, REPROC_EVENT_OUT,
+                                 REPROC_EVENT_ERR, REPROC_EVENT_EXIT };
+
+  for (size_t i = 0; i < num_events; i++) {
+    reproc_t *process = poller->events[i].process;
+    int events = poller->events[i].events;
+
+    for (size_t j = 0; j < ARRAY_SIZE(handled); j++) {
+      if (events & handled[j] && count < num_completions) {
+        count = complete_event(poller, process, handled[j], completions,
+                               count);
+      }
+
+      events &= ~handled[j];
+    }
+
+    // Any other events are reported as is.
+    if (events != 0 && count < num_completions) {
+      completions[count++] = (reproc_completion){
+        .process = process,
+        .context = process->watch.context,
+        .events = events
+      };
+    }
+  }
+
+  return count;
+}
+
+int reproc_poller_complete(reproc_poller_t *poller,
+                           reproc_completion *completions,
+                           size_t num_completions,
+                           int timeout)
+{
+  ASSERT_EINVAL(poller);
+  ASSERT_EINVAL(completions);
+  ASSERT_EINVAL(num_completions > 0);
+
+  int r = complete_mode(poller);
+  if (r < 0) {
+    return r;
+  }
+
+  r = reserve(poller, num_completions);
+  if (r < 0) {
+    return r;
+  }
+
+  // The output reported by the previous call isn't needed anymore.
+  for (size_t i = 0; i < poller->num_used; i++) {
+    ring_recycle(poller->ring, poller->used[i]);
+  }
+
+  poller->num_used = 0;
+
+  int64_t end = timeout == REPROC_INFINITE ? REPROC_INFINITE
+                                           : reproc_now() + timeout;
+  size_t count = 0;
+
+  // Completions that didn't fit in `completions` last time are reported
+  // without waiting.
+  if (poller->ring != NULL) {
+    count = complete_ring(poller, completions, num_completions, count);
+  }
+
+  // Pipes that turn out not to be ready and reads that ran out of buffers
+  // don't produce completions so we keep waiting until something does.
+  while (count == 0) {
+    if (poller->ring != NULL) {
+      r = ring_submit(poller->ring);
+      if (r < 0) {
+        return r;
+      }
+    }
+
+    r = wait_events(poller, poller->events, num_completions, remaining(end));
+    if (r < 0) {
+      return r;
+    }
+
+    if (poller->ring != NULL) {
+      count = complete_ring(poller, completions, num_completions, count);
+    }
+
+    count = complete_events(poller, (size_t) r, completions, num_completions,
+                            count);
+  }
+
+  // Submits the operations of the reads that completed for the last time.
+  if (poller->ring != NULL) {
+    r = ring_submit(poller->ring);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  return (int) count;
+}
+
+reproc_poller_t *reproc_poller_destroy(reproc_poller_t *poller)
+{
+  ASSERT_RETURN(poller, NULL);
+
+  while (poller->size > 0) {
+    reproc_poller_remove(poller, poller->processes[poller->size - 1]);
+  }
+
+  // The ring waits until the kernel is done with the operations that were
+  // cancelled when the processes were removed.
+  ring_destroy(poller->ring);
+  poller_destroy(poller->poller);
+  free(poller->processes);
+  free(poller->heap);
+  free(poller->ready);
+  free(poller->ops);
+  free(poller->events);
+  free(poller->finished);
+  free(poller->used);
+  free(poller->buffer);
+  free(poller);
+
+  return NULL;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pipe.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A set of pipes that stays registered between waits. On Linux, the set is an
+// epoll instance so a wait only costs time proportional to the amount of pipes
+// that are ready. Elsewhere, the pipes are kept in an array that is handed to
+// `poll` (`WSAPoll` on Windows) as is, which at least avoids rebuilding it for
+// every wait.
+typedef struct poller poller_type;
+
+enum { POLLER_IN = 1 << 0, POLLER_OUT = 1 << 1 };
+
+typedef struct {
+  uint64_t data;
+  // Combo of `POLLER_IN` and `POLLER_OUT`. Both are reported if the pipe hung
+  // up or failed, regardless of which ones were asked for.
+  int events;
+} poller_event;
+
+int poller_init(poller_type **poller);
+
+// Adds `pipe` to `poller`. `events` is a combo of `POLLER_IN` and `POLLER_OUT`.
+// `data` is reported by `poller_wait` when `pipe` is ready. A pipe may only be
+// added once.
+int poller_add(poller_type *poller, pipe_type pipe, int events, uint64_t data);
+
+// Changes the `events` and `data` of a pipe that was added to `poller`.
+int poller_modify(poller_type *poller,
+                  pipe_type pipe,
+                  int events,
+                  uint64_t data);
+
+// Removes `pipe` from `poller`. Has to be called before `pipe` is closed.
+int poller_remove(poller_type *poller, pipe_type pipe);
+
+// Waits up to `timeout` milliseconds until at least one of the pipes in
+// `poller` is ready and stores up to `size` ready pipes in `ready`. Returns the
+// amount of pipes stored in `ready`, which can be zero on Windows.
+int poller_wait(poller_type *poller,
+                poller_event *ready,
+                size_t size,
+                int timeout);
+
+// Makes `poller` report `data` once `deadline` (see `reproc_now`) has passed
+// until the timer is armed again. A negative `deadline` disarms the timer. The
+// first call decides `data`. Fails if `poller` doesn't support timers, in which
+// case the caller has to shorten the timeout passed to `poller_wait` instead.
+int poller_timer(poller_type *poller, int64_t deadline, uint64_t data);
+
+poller_type *poller_destroy(poller_type *poller);
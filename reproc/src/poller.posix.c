@@ -0,0 +1,352 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "poller.h"
+
+#include "error.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+
+  #include <sys/epoll.h>
+  #include <sys/timerfd.h>
+
+struct poller {
+  int epoll;
+  // Created by the first call to `poller_timer`.
+  int timer;
+  // Reused by every call to `poller_wait`.
+  struct epoll_event *events;
+  size_t size;
+};
+
+int poller_init(struct poller **poller)
+{
+  assert(poller);
+
+  struct poller *result = calloc(1, sizeof(struct poller));
+  if (result == NULL) {
+    return -ENOMEM;
+  }
+
+  result->timer = -1;
+  result->epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (result->epoll < 0) {
+    int r = error_unify(result->epoll);
+    free(result);
+    return r;
+  }
+
+  *poller = result;
+
+  return 0;
+}
+
+static int control(struct poller *poller,
+                   int operation,
+                   int pipe,
+                   int events,
+                   uint64_t data)
+{
+  struct epoll_event event = {
+    .events = (events & POLLER_IN ? EPOLLIN : 0u) |
+              (events & POLLER_OUT ? EPOLLOUT : 0u),
+    .data = { .u64 = data }
+  };
+
+  int r = epoll_ctl(poller->epoll, operation, pipe, &event);
+  return error_unify(r);
+}
+
+int poller_add(struct poller *poller, int pipe, int events, uint64_t data)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  return control(poller, EPOLL_CTL_ADD, pipe, events, data);
+}
+
+int poller_modify(struct poller *poller, int pipe, int events, uint64_t data)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  return control(poller, EPOLL_CTL_MOD, pipe, events, data);
+}
+
+int poller_remove(struct poller *poller, int pipe)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  int r = epoll_ctl(poller->epoll, EPOLL_CTL_DEL, pipe, NULL);
+  return error_unify(r);
+}
+
+int poller_wait(struct poller *poller,
+                poller_event *ready,
+                size_t size,
+                int timeout)
+{
+  assert(poller);
+  assert(ready);
+  assert(size > 0);
+
+  size = size < INT_MAX ? size : INT_MAX;
+
+  if (size > poller->size) {
+    struct epoll_event *events = realloc(poller->events,
+                                         size * sizeof(struct epoll_event));
+    if (events == NULL) {
+      return -ENOMEM;
+    }
+
+    poller->events = events;
+    poller->size = size;
+  }
+
+  int r = epoll_wait(poller->epoll, poller->events, (int) size, timeout);
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  if (r == 0) {
+    return -ETIMEDOUT;
+  }
+
+  for (int i = 0; i < r; i++) {
+    struct epoll_event event = poller->events[i];
+    bool hangup = event.events & (EPOLLHUP | EPOLLERR);
+
+    ready[i].data = event.data.u64;
+    ready[i].events = (event.events & EPOLLIN || hangup ? POLLER_IN : 0) |
+                      (event.events & EPOLLOUT || hangup ? POLLER_OUT : 0);
+  }
+
+  return r;
+}
+
+int poller_timer(struct poller *poller, int64_t deadline, uint64_t data)
+{
+  assert(poller);
+
+  int r = -1;
+
+  if (poller->timer < 0) {
+    // timerfd uses the same clock as `reproc_now`.
+    poller->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (poller->timer < 0) {
+      return error_unify(poller->timer);
+    }
+
+    r = control(poller, EPOLL_CTL_ADD, poller->timer, POLLER_IN, data);
+    if (r < 0) {
+      close(poller->timer);
+      poller->timer = -1;
+      return r;
+    }
+  }
+
+  // A zero `it_value` disarms the timer so we round a zero deadline up.
+  struct itimerspec value = { 0 };
+
+  if (deadline >= 0) {
+    value.it_value.tv_sec = (time_t) (deadline / 1000);
+    value.it_value.tv_nsec = deadline > 0 ? (long) (deadline % 1000) * 1000000
+                                          : 1;
+  }
+
+  // Arming the timer again also resets its readiness.
+  r = timerfd_settime(poller->timer, TFD_TIMER_ABSTIME, &value, NULL);
+  return error_unify(r);
+}
+
+struct poller *poller_destroy(struct poller *poller)
+{
+  if (poller == NULL) {
+    return NULL;
+  }
+
+  if (poller->timer >= 0) {
+    close(poller->timer);
+  }
+
+  close(poller->epoll);
+  free(poller->events);
+  free(poller);
+
+  return NULL;
+}
+
+#else
+
+  #include <poll.h>
+
+struct poller {
+  struct pollfd *pollfds;
+  uint64_t *data;
+  size_t size;
+  size_t capacity;
+};
+
+int poller_init(struct poller **poller)
+{
+  assert(poller);
+
+  *poller = calloc(1, sizeof(struct poller));
+  return *poller == NULL ? -ENOMEM : 0;
+}
+
+static short poll_events(int events)
+{
+  return (short) ((events & POLLER_IN ? POLLIN : 0) |
+                  (events & POLLER_OUT ? POLLOUT : 0));
+}
+
+static size_t find(struct poller *poller, int pipe)
+{
+  size_t i = 0;
+
+  while (i < poller->size && poller->pollfds[i].fd != pipe) {
+    i++;
+  }
+
+  return i;
+}
+
+int poller_add(struct poller *poller, int pipe, int events, uint64_t data)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  if (find(poller, pipe) < poller->size) {
+    return -EEXIST;
+  }
+
+  if (poller->size == poller->capacity) {
+    size_t capacity = poller->capacity == 0 ? 16 : poller->capacity * 2;
+
+    struct pollfd *pollfds = realloc(poller->pollfds,
+                                     capacity * sizeof(struct pollfd));
+    if (pollfds == NULL) {
+      return -ENOMEM;
+    }
+
+    poller->pollfds = pollfds;
+
+    uint64_t *array = realloc(poller->data, capacity * sizeof(uint64_t));
+    if (array == NULL) {
+      return -ENOMEM;
+    }
+
+    poller->data = array;
+    poller->capacity = capacity;
+  }
+
+  poller->pollfds[poller->size] =
+      (struct pollfd){ .fd = pipe, .events = poll_events(events) };
+  poller->data[poller->size] = data;
+  poller->size++;
+
+  return 0;
+}
+
+int poller_modify(struct poller *poller, int pipe, int events, uint64_t data)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  size_t i = find(poller, pipe);
+  if (i == poller->size) {
+    return -ENOENT;
+  }
+
+  poller->pollfds[i].events = poll_events(events);
+  poller->data[i] = data;
+
+  return 0;
+}
+
+int poller_remove(struct poller *poller, int pipe)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  size_t i = find(poller, pipe);
+  if (i == poller->size) {
+    return -ENOENT;
+  }
+
+  poller->size--;
+  poller->pollfds[i] = poller->pollfds[poller->size];
+  poller->data[i] = poller->data[poller->size];
+
+  return 0;
+}
+
+int poller_wait(struct poller *poller,
+                poller_event *ready,
+                size_t size,
+                int timeout)
+{
+  assert(poller);
+  assert(ready);
+  assert(size > 0);
+
+  int r = poll(poller->pollfds, (nfds_t) poller->size, timeout);
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  if (r == 0) {
+    return -ETIMEDOUT;
+  }
+
+  size_t count = 0;
+
+  for (size_t i = 0; i < poller->size && count < size; i++) {
+    struct pollfd pollfd = poller->pollfds[i];
+    bool hangup = pollfd.revents & (POLLHUP | POLLERR | POLLNVAL);
+
+    if (pollfd.revents == 0) {
+      continue;
+    }
+
+    ready[count].data = poller->data[i];
+    ready[count].events = (pollfd.revents & POLLIN || hangup ? POLLER_IN : 0) |
+                          (pollfd.revents & POLLOUT || hangup ? POLLER_OUT
+                                                              : 0);
+    count++;
+  }
+
+  return (int) count;
+}
+
+int poller_timer(struct poller *poller, int64_t deadline, uint64_t data)
+{
+  assert(poller);
+  (void) deadline;
+  (void) data;
+
+  return -ENOSYS;
+}
+
+struct poller *poller_destroy(struct poller *poller)
+{
+  if (poller == NULL) {
+    return NULL;
+  }
+
+  free(poller->pollfds);
+  free(poller->data);
+  free(poller);
+
+  return NULL;
+}
+
+#endif
@@ -0,0 +1,182 @@
+#define _WIN32_WINNT _WIN32_WINNT_VISTA
+
+#include "poller.h"
+
+#include "error.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <windows.h>
+#include <winsock2.h>
+
+// Windows doesn't have an equivalent of epoll that works with sockets so we
+// keep the registered sockets in an array that's passed to `WSAPoll` as is.
+struct poller {
+  WSAPOLLFD *pollfds;
+  uint64_t *data;
+  size_t size;
+  size_t capacity;
+};
+
+int poller_init(struct poller **poller)
+{
+  assert(poller);
+
+  *poller = calloc(1, sizeof(struct poller));
+  return *poller == NULL ? -ERROR_NOT_ENOUGH_MEMORY : 0;
+}
+
+static SHORT poll_events(int events)
+{
+  return (SHORT) ((events & POLLER_IN ? POLLIN : 0) |
+                  (events & POLLER_OUT ? POLLOUT : 0));
+}
+
+static size_t find(struct poller *poller, SOCKET pipe)
+{
+  size_t i = 0;
+
+  while (i < poller->size && poller->pollfds[i].fd != pipe) {
+    i++;
+  }
+
+  return i;
+}
+
+int poller_add(struct poller *poller, SOCKET pipe, int events, uint64_t data)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  if (find(poller, pipe) < poller->size) {
+    return -ERROR_ALREADY_EXISTS;
+  }
+
+  if (poller->size == poller->capacity) {
+    size_t capacity = poller->capacity == 0 ? 16 : poller->capacity * 2;
+
+    if (capacity > ULONG_MAX) {
+      return -ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    WSAPOLLFD *pollfds = realloc(poller->pollfds,
+                                 capacity * sizeof(WSAPOLLFD));
+    if (pollfds == NULL) {
+      return -ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    poller->pollfds = pollfds;
+
+    uint64_t *array = realloc(poller->data, capacity * sizeof(uint64_t));
+    if (array == NULL) {
+      return -ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    poller->data = array;
+    poller->capacity = capacity;
+  }
+
+  poller->pollfds[poller->size] =
+      (WSAPOLLFD){ .fd = pipe, .events = poll_events(events) };
+  poller->data[poller->size] = data;
+  poller->size++;
+
+  return 0;
+}
+
+int poller_modify(struct poller *poller, SOCKET pipe, int events, uint64_t data)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  size_t i = find(poller, pipe);
+  if (i == poller->size) {
+    return -ERROR_NOT_FOUND;
+  }
+
+  poller->pollfds[i].events = poll_events(events);
+  poller->data[i] = data;
+
+  return 0;
+}
+
+int poller_remove(struct poller *poller, SOCKET pipe)
+{
+  assert(poller);
+  assert(pipe != PIPE_INVALID);
+
+  size_t i = find(poller, pipe);
+  if (i == poller->size) {
+    return -ERROR_NOT_FOUND;
+  }
+
+  poller->size--;
+  poller->pollfds[i] = poller->pollfds[poller->size];
+  poller->data[i] = poller->data[poller->size];
+
+  return 0;
+}
+
+int poller_wait(struct poller *poller,
+                poller_event *ready,
+                size_t size,
+                int timeout)
+{
+  assert(poller);
+  assert(ready);
+  assert(size > 0);
+
+  int r = WSAPoll(poller->pollfds, (ULONG) poller->size, timeout);
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  if (r == 0) {
+    return -WAIT_TIMEOUT;
+  }
+
+  size_t count = 0;
+
+  for (size_t i = 0; i < poller->size && count < size; i++) {
+    WSAPOLLFD pollfd = poller->pollfds[i];
+
+    bool hangup = pollfd.revents & (POLLHUP | POLLERR);
+
+    if (pollfd.revents <= 0 || pollfd.revents == POLLNVAL) {
+      continue;
+    }
+
+    ready[count].data = poller->data[i];
+    ready[count].events = (pollfd.revents & POLLIN || hangup ? POLLER_IN : 0) |
+                          (pollfd.revents & POLLOUT || hangup ? POLLER_OUT
+                                                              : 0);
+    count++;
+  }
+
+  return (int) count;
+}
+
+int poller_timer(struct poller *poller, int64_t deadline, uint64_t data)
+{
+  assert(poller);
+  (void) deadline;
+  (void) data;
+
+  // Windows has waitable timers but `WSAPoll` can't wait for them.
+  return -ERROR_NOT_SUPPORTED;
+}
+
+struct poller *poller_destroy(struct poller *poller)
+{
+  if (poller == NULL) {
+    return NULL;
+  }
+
+  free(poller->pollfds);
+  free(poller->data);
+  free(poller);
+
+  return NULL;
+}
@@ -22,13 +22,40 @@ struct process_options {
   // The standard streams of the child process are redirected to the `in`, `out`
   // and `err` handles. If a handle is `HANDLE_INVALID`, the corresponding child
   // process standard stream is closed. The `exit` handle is simply inherited by
-  // the child process.
+  // the child process unless it is `HANDLE_INVALID`.
   struct {
     handle_type in;
     handle_type out;
     handle_type err;
     handle_type exit;
   } handle;
+  // The child process inherits `handle[i]` as file descriptor `fd[i]` for each
+  // of the `size` extra streams (POSIX only).
+  struct {
+    const handle_type *handle;
+    const int *fd;
+    size_t size;
+  } extra;
+  // If `path` is not `NULL`, it is executed instead of searching for `argv[0]`
+  // in `PATH`. If `fd` is not `HANDLE_INVALID`, it refers to the same file as
+  // `path` and is executed instead of `path` where supported.
+  struct {
+    const char *path;
+    handle_type fd;
+  } executable;
+  // If `true`, the child process is started without copying the address space
+  // of the parent process (`clone(CLONE_VM | CLONE_VFORK)`) if the platform
+  // supports it. Ignored when `argv` is `NULL`.
+  bool vfork;
+  // If `true`, the child process is started by the spawn helper process (see
+  // helper.h) if the platform supports it. Ignored when `argv` is `NULL`.
+  bool helper;
+  // If `true`, the child process becomes a child of the parent of the calling
+  // process instead of the calling process itself (`CLONE_PARENT`). Only used
+  // by the spawn helper. Requires `vfork`. Because the calling process can't
+  // wait for the child process, `process` is set even if the child process
+  // fails to call `exec` so that the caller can report it to whoever can.
+  bool sibling;
 };
 
 // Spawns a child process that executes the command stored in `argv`.
@@ -42,6 +69,39 @@ int process_start(process_type *process,
                   const char *const *argv,
                   struct process_options options);
 
+// `process_start` but doesn't wait for the child process to report whether it
+// managed to call `exec`. If there's something to wait for, `pending` is set to
+// a handle that has to be passed to `process_finish`. Otherwise, `pending` is
+// set to `HANDLE_INVALID`. This allows starting multiple child processes
+// without waiting for each of them in turn.
+int process_launch(process_type *process,
+                   const char *const *argv,
+                   struct process_options options,
+                   handle_type *pending);
+
+// Waits until the child process started by `process_launch` calls `exec` and
+// closes `pending`. If the child process failed to call `exec`, it is reaped
+// and the error is returned.
+int process_finish(process_type process, handle_type pending);
+
+// `process_finish` but doesn't reap the child process if it failed to call
+// `exec`. Only blocks if `pending` isn't readable yet.
+int process_started(handle_type pending);
+
+// Returns true if `process_pidfd` is supported (Linux 5.3+).
+bool process_pidfd_supported(void);
+
+// Opens a handle to `process` that becomes readable once it exits without the
+// child process having to inherit anything. Only supported if
+// `process_pidfd_supported` returns true.
+int process_pidfd(process_type process, handle_type *pidfd);
+
+// Returns the value of the `PATH` environment variable in `environment` or the
+// default search path if `environment` does not contain `PATH`. This is where
+// `process_start` searches for `argv[0]`. If `environment` is `NULL`, the
+// environment of the current process is used (POSIX only).
+const char *process_path(const char *const *environment);
+
 // Returns the process's exit status if it has finished running.
 int process_wait(process_type process);
 
@@ -1,8 +1,14 @@
 #define _POSIX_C_SOURCE 200809L
 
+#if defined(__linux__)
+  // `clone`, `MAP_STACK` and `AT_EMPTY_PATH`.
+  #define _GNU_SOURCE
+#endif
+
 #include "process.h"
 
 #include "error.h"
+#include "helper.h"
 #include "macro.h"
 #include "pipe.h"
 
@@ -17,6 +23,37 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+  #include <sched.h>
+  #include <stdint.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+
+  #if !defined(CLOSE_RANGE_CLOEXEC)
+    #define CLOSE_RANGE_CLOEXEC (1U << 2)
+  #endif
+
+  #if !defined(SYS_pidfd_open)
+    #define SYS_pidfd_open 434
+  #endif
+#endif
+
+#if defined(REPROC_MULTITHREADED)
+  #include <pthread.h>
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+  #define ADDRESS_SANITIZER
+#elif defined(__has_feature)
+  #if __has_feature(address_sanitizer)
+    #define ADDRESS_SANITIZER
+  #endif
+#endif
+
+#if defined(ADDRESS_SANITIZER)
+  #include <sanitizer/asan_interface.h>
+#endif
+
 const pid_t PROCESS_INVALID = -1;
 
 static int signal_mask(int how, const sigset_t *newmask, sigset_t *oldmask)
@@ -128,108 +165,258 @@ static bool fd_in_set(int fd, const int *fd_set, size_t size)
   return false;
 }
 
-static pid_t process_fork(const int *except, size_t num_except)
+// Sorts the file descriptors in `fds` in ascending order. `fds` only ever
+// contains a handful of file descriptors so insertion sort is good enough.
+static void fd_sort(int *fds, size_t size)
 {
-  struct {
-    sigset_t old;
-    sigset_t new;
-  } mask;
+  for (size_t i = 1; i < size; i++) {
+    int fd = fds[i];
+    size_t j = i;
+
+    for (; j > 0 && fds[j - 1] > fd; j--) {
+      fds[j] = fds[j - 1];
+    }
+
+    fds[j] = fd;
+  }
+}
 
+#if defined(__linux__)
+
+// Closes (or marks `FD_CLOEXEC` if `cloexec` is true) all file descriptors
+// except those in `keep` using `close_range` (Linux 5.9+, `CLOSE_RANGE_CLOEXEC`
+// requires Linux 5.11+). `keep` must be sorted.
+static int fd_close_range(const int *keep, size_t num_keep, bool cloexec)
+{
+  #if defined(SYS_close_range)
+  unsigned int flags = cloexec ? CLOSE_RANGE_CLOEXEC : 0;
+  unsigned int first = 0;
   int r = -1;
 
-  // We don't want signal handlers of the parent to run in the child process so
-  // we block all signals before forking.
+  for (size_t i = 0; i < num_keep; i++) {
+    unsigned int fd = (unsigned int) keep[i];
 
-  r = sigfillset(&mask.new);
-  if (r < 0) {
-    return error_unify(r);
+    if (fd > first) {
+      r = (int) syscall(SYS_close_range, first, fd - 1, flags);
+      if (r < 0) {
+        return r;
+      }
+    }
+
+    first = fd + 1;
   }
 
-  r = signal_mask(SIG_SETMASK, &mask.new, &mask.old);
-  if (r < 0) {
-    return error_unify(r);
+  return (int) syscall(SYS_close_range, first, ~0U, flags);
+  #else
+  (void) keep;
+  (void) num_keep;
+  (void) cloexec;
+
+  errno = ENOSYS;
+  return -1;
+  #endif
+}
+
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// Returns the file descriptor described by the NUL-terminated string in
+// `name` or -1 if `name` does not describe a file descriptor.
+static int fd_parse(const char *name)
+{
+  int fd = 0;
+
+  if (*name == '\0') {
+    return -1;
   }
 
-  struct {
-    int read;
-    int write;
-  } pipe = { PIPE_INVALID, PIPE_INVALID };
+  for (; *name != '\0'; name++) {
+    if (*name < '0' || *name > '9' || fd > (INT_MAX - 9) / 10) {
+      return -1;
+    }
 
-  r = pipe_init(&pipe.read, &pipe.write);
-  if (r < 0) {
-    return error_unify(r);
+    fd = fd * 10 + (*name - '0');
   }
 
-  r = fork();
-  if (r < 0) {
-    // `fork` error.
+  return fd;
+}
 
-    r = signal_mask(SIG_SETMASK, &mask.new, &mask.old);
-    ASSERT_UNUSED(r == 0);
+// Closes (or marks `FD_CLOEXEC` if `cloexec` is true) all file descriptors
+// except those in `keep` by iterating over the entries of /proc/self/fd. We use
+// the `getdents64` system call directly because `opendir` and `readdir` are
+// not async-signal-safe.
+static int fd_close_proc(const int *keep, size_t num_keep, bool cloexec)
+{
+  uint64_t buffer[512];
+  int r = -1;
 
-    pipe_destroy(pipe.read);
-    pipe_destroy(pipe.write);
+  int dir = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir < 0) {
+    return dir;
+  }
 
-    return error_unify(r);
+  // Closing file descriptors while iterating over /proc/self/fd might make us
+  // skip entries so we keep going until we complete a pass without closing any
+  // file descriptors. Marking file descriptors `FD_CLOEXEC` does not modify
+  // the directory so a single pass is sufficient in that case.
+  bool closed = true;
+
+  while (closed) {
+    closed = false;
+
+    r = (int) lseek(dir, 0, SEEK_SET);
+    if (r < 0) {
+      goto finish;
+    }
+
+    while (true) {
+      long size = syscall(SYS_getdents64, dir, buffer, sizeof(buffer));
+      if (size <= 0) {
+        r = (int) size;
+        break;
+      }
+
+      for (long offset = 0; offset < size;) {
+        char *current = (char *) buffer + offset;
+        struct linux_dirent64 *entry = (struct linux_dirent64 *) current;
+        offset += entry->d_reclen;
+
+        int fd = fd_parse(entry->d_name);
+        if (fd < 0 || fd == dir || fd_in_set(fd, keep, num_keep)) {
+          continue;
+        }
+
+        if (cloexec) {
+          r = fcntl(fd, F_SETFD, FD_CLOEXEC);
+          if (r < 0) {
+            goto finish;
+          }
+        } else {
+          handle_destroy(fd);
+          closed = true;
+        }
+      }
+    }
+
+    if (r < 0) {
+      goto finish;
+    }
   }
 
-  if (r > 0) {
-    // Parent process
+finish:
+  handle_destroy(dir);
 
-    pid_t child = r;
+  return r;
+}
 
-    // From now on, the child process might have started so we don't report
-    // errors from `signal_mask` and `read`. This puts the responsibility
-    // for cleaning up the process in the hands of the caller.
+#endif
 
-    r = signal_mask(SIG_SETMASK, &mask.old, &mask.old);
-    ASSERT_UNUSED(r == 0);
+// Not all file descriptors might have been created with the `FD_CLOEXEC` flag
+// so we manually close all file descriptors except those in `except`, `first`
+// and `second` to prevent file descriptors leaking into the child process. If
+// `cloexec` is true, file descriptors are marked `FD_CLOEXEC` instead of being
+// closed which is sufficient if the caller is going to call `exec`.
+//
+// Only async-signal-safe functions are called.
+static int fd_close_all(const int *except,
+                        size_t num_except,
+                        int first,
+                        int second,
+                        bool cloexec)
+{
+  int keep[num_except + 2];
+  size_t num_keep = 0;
 
-    // Close the error pipe write end on the parent's side so `read` will return
-    // when it is closed on the child side as well.
-    pipe_destroy(pipe.write);
+  for (size_t i = 0; i < num_except; i++) {
+    if (except[i] >= 0) {
+      keep[num_keep++] = except[i];
+    }
+  }
 
-    int child_errno = 0;
-    r = (int) read(pipe.read, &child_errno, sizeof(child_errno));
-    ASSERT_UNUSED(r >= 0);
+  if (first >= 0) {
+    keep[num_keep++] = first;
+  }
 
-    if (child_errno > 0) {
-      // If the child writes to the error pipe and exits, we're certain the
-      // child process exited on its own and we can report errors as usual.
-      r = waitpid(child, NULL, 0);
-      assert(r < 0 || r == child);
+  if (second >= 0) {
+    keep[num_keep++] = second;
+  }
 
-      if (r == child) {
-        r = -child_errno;
-      }
-    } else {
-      r = 0;
+  fd_sort(keep, num_keep);
+
+#if defined(__linux__)
+  if (fd_close_range(keep, num_keep, cloexec) == 0) {
+    return 0;
+  }
+
+  if (fd_close_proc(keep, num_keep, cloexec) == 0) {
+    return 0;
+  }
+#endif
+
+  // Fall back to checking every possible file descriptor.
+
+  int max_fd = get_max_fd();
+  if (max_fd < 0) {
+    return max_fd;
+  }
+
+  if (max_fd > MAX_FD_LIMIT) {
+    // Refuse to try to close too many file descriptors.
+    errno = EMFILE;
+    return -1;
+  }
+
+  for (int i = 0; i < max_fd; i++) {
+    if (fd_in_set(i, keep, num_keep)) {
+      continue;
     }
 
-    pipe_destroy(pipe.read);
+    // Check if `i` is a valid file descriptor before trying to close it.
+    int r = fcntl(i, F_GETFD);
+    if (r < 0) {
+      continue;
+    }
 
-    return error_unify_or_else(r, child);
+    if (cloexec) {
+      r = fcntl(i, F_SETFD, FD_CLOEXEC);
+      if (r < 0) {
+        return r;
+      }
+    } else {
+      handle_destroy(i);
+    }
   }
 
-  // Child process
+  return 0;
+}
 
+// Resets all signal handlers and the signal mask of the calling (child)
+// process to their defaults. Only async-signal-safe functions are called.
+static int signal_reset(void)
+{
   // Reset all signal handlers so they don't run in the child process. By
   // default, a child process inherits the parent's signal handlers but we
   // override this as most signal handlers won't be written in a way that they
   // can deal with being run in a child process.
 
   struct sigaction action = { .sa_handler = SIG_DFL };
+  int r = -1;
 
   r = sigemptyset(&action.sa_mask);
   if (r < 0) {
-    goto finish;
+    return r;
   }
 
   // NSIG is not standardized so we use a fixed limit instead.
   for (int signal = 0; signal < 32; signal++) {
     r = sigaction(signal, &action, NULL);
     if (r < 0 && errno != EINVAL) {
-      goto finish;
+      return r;
     }
   }
 
@@ -238,156 +425,609 @@ static pid_t process_fork(const int *except, size_t num_except)
   // but we override this as most processes won't be written in a way that they
   // can deal with starting with a custom signal mask.
 
-  r = sigemptyset(&mask.new);
+  sigset_t mask;
+
+  r = sigemptyset(&mask);
   if (r < 0) {
-    goto finish;
+    return r;
+  }
+
+  return signal_mask(SIG_SETMASK, &mask, NULL);
+}
+
+const char *process_path(const char *const *environment)
+{
+  static const char *const DEFAULT_PATH = "/bin:/usr/bin";
+
+  if (environment == NULL) {
+    extern char **environ;
+    environment = (const char *const *) environ;
+  }
+
+  // `clearenv` sets `environ` to `NULL`.
+  for (size_t i = 0; environment != NULL && environment[i] != NULL; i++) {
+    if (strncmp(environment[i], "PATH=", 5) == 0) {
+      return environment[i] + 5;
+    }
+  }
+
+  return DEFAULT_PATH;
+}
+
+// Runs `file` as a shell script the same way `execvp` does when `execve` fails
+// with `ENOEXEC`. Only returns on failure.
+static void exec_script(const char *file,
+                        const char *const *argv,
+                        char *const *environment)
+{
+  size_t argc = 0;
+  while (argv[argc] != NULL) {
+    argc++;
+  }
+
+  // `argv` always contains the program name so `argc` is never zero.
+  const char *script[argc + 2];
+
+  script[0] = "/bin/sh";
+  script[1] = file;
+
+  for (size_t i = 1; i <= argc; i++) {
+    script[i + 1] = argv[i];
+  }
+
+  execve(script[0], (char *const *) script, environment);
+}
+
+// `execvp` but takes the environment and the search path as arguments instead
+// of reading them from `environ`. Unlike `execvp`, this function only calls
+// async-signal-safe functions and doesn't modify any global state so it can be
+// safely called from a child process that shares its memory with the parent
+// process. If `fd` is not `HANDLE_INVALID`, it refers to `file` and is executed
+// directly if possible. Only returns on failure.
+static int process_exec(int fd,
+                        const char *file,
+                        const char *const *argv,
+                        char *const *environment,
+                        const char *path)
+{
+#if defined(SYS_execveat)
+  if (fd != HANDLE_INVALID) {
+    syscall(SYS_execveat, fd, "", argv, environment, AT_EMPTY_PATH);
+
+    // Scripts can't be executed via a close-on-exec file descriptor since the
+    // interpreter wouldn't be able to open it so we fall back to `file` if
+    // `execveat` fails.
+  }
+#else
+  (void) fd;
+#endif
+
+  if (strchr(file, '/') != NULL) {
+    execve(file, (char *const *) argv, environment);
+
+    if (errno == ENOEXEC) {
+      exec_script(file, argv, environment);
+    }
+
+    return -1;
+  }
+
+  char buffer[PATH_MAX];
+  size_t file_size = strlen(file);
+  bool eacces = false;
+
+  const char *begin = path;
+
+  while (true) {
+    const char *end = begin;
+    while (*end != ':' && *end != '\0') {
+      end++;
+    }
+
+    size_t directory_size = (size_t)(end - begin);
+
+    // An empty entry indicates the current working directory.
+    if (directory_size + file_size + 2 <= sizeof(buffer)) {
+      memcpy(buffer, begin, directory_size);
+
+      if (directory_size > 0) {
+        buffer[directory_size++] = '/';
+      }
+
+      memcpy(buffer + directory_size, file, file_size + 1);
+
+      execve(buffer, (char *const *) argv, environment);
+
+      switch (errno) {
+        case EACCES:
+          // Remember that we found an executable we didn't have permission to
+          // run and keep searching.
+          eacces = true;
+          break;
+        case ENOENT:
+        case ENOTDIR:
+        case ENAMETOOLONG:
+        case ENODEV:
+        case ETIMEDOUT:
+        case ESTALE:
+          break;
+        case ENOEXEC:
+          exec_script(buffer, argv, environment);
+          return -1;
+        default:
+          return -1;
+      }
+    }
+
+    if (*end == '\0') {
+      break;
+    }
+
+    begin = end + 1;
+  }
+
+  errno = eacces ? EACCES : ENOENT;
+
+  return -1;
+}
+
+// Maximum amount of handles returned by `child_handles`.
+enum { CHILD_HANDLES_MAX = REPROC_EXTRA_STREAMS_MAX + 6 };
+
+// Stores the handles in `options` that the child process needs along with
+// `other` in `fds` and returns how many there are.
+static size_t child_handles(struct process_options options,
+                            int other,
+                            int fds[CHILD_HANDLES_MAX])
+{
+  assert(options.extra.size <= REPROC_EXTRA_STREAMS_MAX);
+
+  size_t size = 0;
+
+  fds[size++] = options.handle.in;
+  fds[size++] = options.handle.out;
+  fds[size++] = options.handle.err;
+  fds[size++] = options.handle.exit;
+  // The cached executable (see cache.h) is run with `execveat`.
+  fds[size++] = options.executable.fd;
+  fds[size++] = other;
+
+  for (size_t i = 0; i < options.extra.size; i++) {
+    fds[size++] = options.extra.handle[i];
+  }
+
+  return size;
+}
+
+// Moves `*fd` to a file descriptor of at least `min` if it's one of the file
+// descriptors that the extra streams are redirected to so that it survives the
+// redirection. Only async-signal-safe functions are called.
+static int fd_evade(int *fd, const int *fds, size_t num_fds, int min)
+{
+  if (*fd < 0 || !fd_in_set(*fd, fds, num_fds)) {
+    return 0;
   }
 
-  r = signal_mask(SIG_SETMASK, &mask.new, NULL);
+  int r = fcntl(*fd, F_DUPFD_CLOEXEC, min);
   if (r < 0) {
-    goto finish;
+    return r;
   }
 
-  // Not all file descriptors might have been created with the `FD_CLOEXEC`
-  // flag so we manually close all file descriptors to prevent file descriptors
-  // leaking into the child process.
+  *fd = r;
 
-  int max_fd = get_max_fd();
-  if (max_fd < 0) {
-    goto finish;
+  return 0;
+}
+
+// Redirects the standard and extra streams of the child process and changes its
+// working directory. Handles in `options` and `error` are moved if they're in
+// the way of the extra streams. Only async-signal-safe functions are called.
+static int child_setup(struct process_options *options, int *error)
+{
+  int redirect[] = { options->handle.in, options->handle.out,
+                     options->handle.err };
+  size_t num_extra = options->extra.size;
+  // With `vfork`, `options->extra.handle` is the parent's memory so we work on
+  // a copy.
+  int extra[REPROC_EXTRA_STREAMS_MAX];
+  int max = 0;
+  int r = -1;
+
+  for (size_t i = 0; i < num_extra; i++) {
+    extra[i] = options->extra.handle[i];
+    max = options->extra.fd[i] > max ? options->extra.fd[i] : max;
   }
 
-  if (max_fd > MAX_FD_LIMIT) {
-    // Refuse to try to close too many file descriptors.
-    r = -EMFILE;
-    goto finish;
+  if (num_extra > 0) {
+    int *needed[] = { &redirect[0], &redirect[1], &redirect[2],
+                      &options->handle.exit, &options->executable.fd, error };
+
+    for (size_t i = 0; i < ARRAY_SIZE(needed); i++) {
+      if (needed[i] == NULL) {
+        continue;
+      }
+
+      r = fd_evade(needed[i], options->extra.fd, num_extra, max + 1);
+      if (r < 0) {
+        return r;
+      }
+    }
+
+    for (size_t i = 0; i < num_extra; i++) {
+      r = fd_evade(&extra[i], options->extra.fd, num_extra, max + 1);
+      if (r < 0) {
+        return r;
+      }
+    }
   }
 
-  for (int i = 0; i < max_fd; i++) {
-    // Make sure we don't close the error pipe file descriptors twice.
-    if (i == pipe.read || i == pipe.write) {
-      continue;
+  for (int i = 0; i < (int) ARRAY_SIZE(redirect); i++) {
+    // `i` corresponds to the standard stream we need to redirect.
+    r = dup2(redirect[i], i);
+    if (r < 0) {
+      return r;
     }
 
-    if (fd_in_set(i, except, num_except)) {
-      continue;
+    // Make sure we don't accidentally cloexec the standard streams of the
+    // child process when we're inheriting the parent standard streams. If we
+    // don't call `exec`, the caller is responsible for closing the redirect
+    // and exit handles.
+    if (redirect[i] != i) {
+      // Make sure the pipe is closed when we call exec.
+      r = handle_cloexec(redirect[i], true);
+      if (r < 0) {
+        return r;
+      }
     }
+  }
 
-    // Check if `i` is a valid file descriptor before trying to close it.
-    r = fcntl(i, F_GETFD);
-    if (r >= 0) {
-      handle_destroy(i);
+  for (size_t i = 0; i < num_extra; i++) {
+    r = dup2(extra[i], options->extra.fd[i]);
+    if (r < 0) {
+      return r;
     }
   }
 
-  r = 0;
+  for (size_t i = 0; i < num_extra; i++) {
+    // Standard streams are left alone for the same reason as above.
+    if (extra[i] > 2) {
+      r = handle_cloexec(extra[i], true);
+      if (r < 0) {
+        return r;
+      }
+    }
+  }
+
+  // Make sure the `exit` file descriptor is inherited.
+
+  if (options->handle.exit != HANDLE_INVALID) {
+    r = handle_cloexec(options->handle.exit, false);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  if (options->working_directory != NULL) {
+    r = chdir(options->working_directory);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  return 0;
+}
+
+// Forks the current process with all signals blocked. In the child process,
+// signal handlers and the signal mask are reset and all file descriptors except
+// those in `except` are closed. If `exec` is true, the caller is going to call
+// `exec` in the child process and it's sufficient to mark the file descriptors
+// `FD_CLOEXEC` instead. If any of this fails, the child process writes `errno`
+// to `error` and exits.
+//
+// Returns the pid of the child process in the parent process and 0 in the child
+// process.
+static pid_t
+process_fork(const int *except, size_t num_except, int error, bool exec)
+{
+  struct {
+    sigset_t old;
+    sigset_t new;
+  } mask;
+
+  int r = -1;
+
+  // We don't want signal handlers of the parent to run in the child process so
+  // we block all signals before forking.
+
+  r = sigfillset(&mask.new);
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  r = signal_mask(SIG_SETMASK, &mask.new, &mask.old);
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  pid_t child = fork();
+
+  if (child != 0) {
+    // Parent process or `fork` error.
+
+    r = signal_mask(SIG_SETMASK, &mask.old, NULL);
+    ASSERT_UNUSED(r == 0);
+
+    return error_unify_or_else(child, child);
+  }
+
+  // Child process
+
+  r = signal_reset();
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = fd_close_all(except, num_except, HANDLE_INVALID, HANDLE_INVALID, exec);
+  if (r < 0) {
+    goto finish;
+  }
 
 finish:
   if (r < 0) {
-    (void) !write(pipe.write, &errno, sizeof(errno));
+    (void) !write(error, &errno, sizeof(errno));
     _exit(EXIT_FAILURE);
   }
 
-  pipe_destroy(pipe.write);
-  pipe_destroy(pipe.read);
-
   return 0;
 }
 
-int process_start(pid_t *process,
-                  const char *const *argv,
-                  struct process_options options)
+#if defined(__linux__)
+
+struct vfork_context {
+  const char *program;
+  const char *const *argv;
+  char *const *environment;
+  const char *path;
+  struct process_options options;
+  // Set by the child process if it fails to start.
+  int error;
+};
+
+static int vfork_child(void *arg)
+{
+  struct vfork_context *context = arg;
+  int except[CHILD_HANDLES_MAX];
+  size_t num_except = child_handles(context->options, HANDLE_INVALID, except);
+  int r = -1;
+
+  r = signal_reset();
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = fd_close_all(except, num_except, HANDLE_INVALID, HANDLE_INVALID, true);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = child_setup(&context->options, NULL);
+  if (r < 0) {
+    goto finish;
+  }
+
+  process_exec(context->options.executable.fd, context->program,
+               context->argv, context->environment, context->path);
+
+finish:
+  // The child process shares its memory with the parent process until it calls
+  // `exec` so we can report errors without going through a pipe.
+  context->error = errno;
+  _exit(EXIT_FAILURE);
+}
+
+// Starts a child process with `clone(CLONE_VM | CLONE_VFORK)`. The child
+// process borrows the parent's address space until it calls `exec` which means
+// none of the parent's page tables have to be copied. The calling thread is
+// suspended until the child process calls `exec` or exits.
+static int process_vfork(pid_t *process,
+                         const char *program,
+                         const char *const *argv,
+                         char *const *environment,
+                         struct process_options options)
+{
+  size_t argc = 0;
+  while (argv[argc] != NULL) {
+    argc++;
+  }
+
+  // The child process needs space for the path buffer in `process_exec` and the
+  // arguments array in `exec_script`. We add some extra space for the signal
+  // and `exec` machinery.
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+  size_t stack_size = PATH_MAX + (argc + 2) * sizeof(char *) + 32 * 1024;
+  stack_size = (stack_size + page_size - 1) / page_size * page_size;
+
+  struct {
+    sigset_t old;
+    sigset_t new;
+  } mask;
+
+  int r = -1;
+
+  char *stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED) {
+    return error_unify(r);
+  }
+
+  // The child process runs on top of our memory so we have to make sure none of
+  // the parent's signal handlers run in the child process before it has had
+  // the chance to reset them.
+
+  r = sigfillset(&mask.new);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = signal_mask(SIG_SETMASK, &mask.new, &mask.old);
+  if (r < 0) {
+    goto finish;
+  }
+
+  const char *path = process_path((const char *const *) environment);
+
+  struct vfork_context context = { .program = program,
+                                   .argv = argv,
+                                   .environment = environment,
+                                   .path = path,
+                                   .options = options,
+                                   .error = 0 };
+
+#if defined(ADDRESS_SANITIZER)
+  // The child process never returns from `vfork_child` so AddressSanitizer
+  // would otherwise find the stale redzones of a previous child process when
+  // `mmap` reuses the same stack memory.
+  ASAN_UNPOISON_MEMORY_REGION(stack, stack_size);
+#endif
+
+  int flags = CLONE_VM | CLONE_VFORK | SIGCHLD;
+
+  if (options.sibling) {
+    flags |= CLONE_PARENT;
+  }
+
+  // Stacks grow downwards on all architectures supported by reproc.
+  pid_t child = clone(vfork_child, stack + stack_size, flags, &context);
+
+  r = signal_mask(SIG_SETMASK, &mask.old, NULL);
+  ASSERT_UNUSED(r == 0);
+
+  r = child;
+
+  if (child > 0 && context.error > 0) {
+    r = -context.error;
+
+    if (options.sibling) {
+      // We're not the parent of the child process so it's up to the caller to
+      // make sure it's reaped.
+      *process = child;
+      goto finish;
+    }
+
+    // If the child process reported an error, it has already exited so we can
+    // reap it immediately.
+    r = waitpid(child, NULL, 0);
+    assert(r < 0 || r == child);
+
+    if (r == child) {
+      r = -context.error;
+    }
+
+    goto finish;
+  }
+
+  if (child > 0) {
+    *process = child;
+  }
+
+finish:
+  munmap(stack, stack_size);
+
+  return error_unify(r);
+}
+
+#endif
+
+int process_launch(pid_t *process,
+                   const char *const *argv,
+                   struct process_options options,
+                   int *pending)
 {
   assert(process);
+  assert(pending);
 
   if (argv != NULL) {
     assert(argv[0] != NULL);
   }
 
+  // Only the fork path leaves something to wait for.
+  *pending = HANDLE_INVALID;
+
+  // The helper only passes the standard streams along.
+  if (argv != NULL && options.helper && options.extra.size == 0) {
+    return helper_spawn(process, argv, options);
+  }
+
   struct {
     int read;
     int write;
   } pipe = { PIPE_INVALID, PIPE_INVALID };
-  char *program = NULL;
+  const char *program = NULL;
+  char *absolute = NULL;
   int r = -1;
 
-  // We create an error pipe to receive errors from the child process.
-  r = pipe_init(&pipe.read, &pipe.write);
-  if (r < 0) {
-    goto finish;
-  }
-
   if (argv != NULL) {
+    program = options.executable.path != NULL ? options.executable.path
+                                              : argv[0];
+
     // We prepend the parent working directory to `program` if it is a
     // relative path so that it will always be searched for relative to the
     // parent working directory even after executing `chdir`.
-    program = options.working_directory && path_is_relative(argv[0])
-                  ? path_prepend_cwd(argv[0])
-                  : strdup(argv[0]);
-    if (program == NULL) {
-      r = -1;
-      goto finish;
+    if (options.working_directory && path_is_relative(program)) {
+      absolute = path_prepend_cwd(program);
+      if (absolute == NULL) {
+        r = -1;
+        goto finish;
+      }
+
+      program = absolute;
     }
   }
 
-  int except[] = { options.handle.in, options.handle.out, options.handle.err,
-                   pipe.read,         pipe.write,         options.handle.exit };
+  extern char **environ;
+  char *const *environment = options.environment != NULL
+                                 ? (char *const *) options.environment
+                                 : environ;
 
-  r = process_fork(except, ARRAY_SIZE(except));
-  if (r < 0) {
+#if defined(__linux__)
+  if (argv != NULL && options.vfork) {
+    r = process_vfork(process, program, argv, environment, options);
     goto finish;
   }
+#endif
 
-  if (r == 0) {
-    // Redirect stdin, stdout and stderr.
-
-    int redirect[] = { options.handle.in, options.handle.out,
-                       options.handle.err };
+  // We create an error pipe to receive errors from the child process. The same
+  // pipe is used for errors that happen before and after forking.
+  r = pipe_init(&pipe.read, &pipe.write);
+  if (r < 0) {
+    goto finish;
+  }
 
-    for (int i = 0; i < (int) ARRAY_SIZE(redirect); i++) {
-      // `i` corresponds to the standard stream we need to redirect.
-      r = dup2(redirect[i], i);
-      if (r < 0) {
-        goto child;
-      }
+  const char *path = process_path((const char *const *) environment);
 
-      // Make sure we don't accidentally cloexec the standard streams of the
-      // child process when we're inheriting the parent standard streams. If we
-      // don't call `exec`, the caller is responsible for closing the redirect
-      // and exit handles.
-      if (redirect[i] != i) {
-        // Make sure the pipe is closed when we call exec.
-        r = handle_cloexec(redirect[i], true);
-        if (r < 0) {
-          goto child;
-        }
-      }
-    }
+  int except[CHILD_HANDLES_MAX];
+  size_t num_except = child_handles(options, pipe.write, except);
 
-    // Make sure the `exit` file descriptor is inherited.
+  r = process_fork(except, num_except, pipe.write, argv != NULL);
+  if (r < 0) {
+    goto finish;
+  }
 
-    r = handle_cloexec(options.handle.exit, false);
+  if (r == 0) {
+    r = child_setup(&options, &pipe.write);
     if (r < 0) {
       goto child;
     }
 
-    if (options.working_directory != NULL) {
-      r = chdir(options.working_directory);
-      if (r < 0) {
-        goto child;
-      }
-    }
-
     if (options.environment != NULL) {
       // `environ` is carried over calls to `exec`.
-      extern char **environ;
       environ = (char **) options.environment;
     }
 
     if (argv != NULL) {
       assert(program);
 
-      r = execvp(program, (char *const *) argv);
+      r = process_exec(options.executable.fd, program, argv, environment,
+                       path);
       if (r < 0) {
         goto child;
       }
@@ -399,41 +1039,140 @@ int process_start(pid_t *process,
       _exit(EXIT_FAILURE);
     }
 
-    pipe_destroy(pipe.read);
+    // `process_fork` already closed the read end of the error pipe. Closing the
+    // write end tells the parent process we've started successfully.
     pipe_destroy(pipe.write);
-    free(program);
+    free(absolute);
 
     return 0;
   }
 
-  pid_t child = r;
+  *process = r;
 
   // Close the error pipe write end on the parent's side so `read` will return
-  // when it is closed on the child side as well.
+  // when it is closed on the child side as well. The read end is handed over to
+  // `process_finish`.
   pipe.write = pipe_destroy(pipe.write);
+  *pending = pipe.read;
+  pipe.read = PIPE_INVALID;
+
+  r = 0;
+
+finish:
+  pipe_destroy(pipe.read);
+  pipe_destroy(pipe.write);
+  free(absolute);
+
+  return error_unify_or_else(r, 1);
+}
+
+int process_started(int pending)
+{
+  if (pending == HANDLE_INVALID) {
+    return 0;
+  }
 
   int child_errno = 0;
-  r = (int) read(pipe.read, &child_errno, sizeof(child_errno));
+  int r = (int) read(pending, &child_errno, sizeof(child_errno));
   ASSERT_UNUSED(r >= 0);
 
-  if (child_errno > 0) {
-    r = waitpid(child, NULL, 0);
-    if (r == child) {
-      r = -child_errno;
-    }
+  pipe_destroy(pending);
 
-    goto finish;
+  return -child_errno;
+}
+
+int process_finish(pid_t process, int pending)
+{
+  int child_error = process_started(pending);
+  if (child_error == 0) {
+    return 0;
   }
 
-  *process = child;
-  r = 0;
+  // If the reaper (see reaper.h) is running, it might have reaped the child
+  // process already.
+  int r = waitpid(process, NULL, 0);
+  if (r == process || (r < 0 && errno == ECHILD)) {
+    r = child_error;
+  }
 
-finish:
-  pipe_destroy(pipe.read);
-  pipe_destroy(pipe.write);
-  free(program);
+  return error_unify(r);
+}
 
-  return error_unify_or_else(r, 1);
+int process_start(pid_t *process,
+                  const char *const *argv,
+                  struct process_options options)
+{
+  int pending = HANDLE_INVALID;
+
+  int r = process_launch(process, argv, options, &pending);
+  if (r <= 0) {
+    // Either an error occurred or we're in the child process.
+    return r;
+  }
+
+  r = process_finish(*process, pending);
+  if (r < 0) {
+    *process = PROCESS_INVALID;
+    return r;
+  }
+
+  return 1;
+}
+
+#if defined(__linux__)
+
+static bool pidfd_supported = false;
+
+static void pidfd_probe(void)
+{
+  int pidfd = (int) syscall(SYS_pidfd_open, getpid(), 0);
+  if (pidfd >= 0) {
+    pidfd_supported = true;
+    handle_destroy(pidfd);
+  }
+}
+
+#endif
+
+bool process_pidfd_supported(void)
+{
+#if defined(__linux__)
+  #if defined(REPROC_MULTITHREADED)
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  int r = pthread_once(&once, pidfd_probe);
+  ASSERT_UNUSED(r == 0);
+  #else
+  static bool probed = false;
+  if (!probed) {
+    pidfd_probe();
+    probed = true;
+  }
+  #endif
+
+  return pidfd_supported;
+#else
+  return false;
+#endif
+}
+
+int process_pidfd(pid_t process, int *pidfd)
+{
+  assert(process != PROCESS_INVALID);
+  assert(pidfd);
+
+#if defined(__linux__)
+  // `pidfd_open` always sets `O_CLOEXEC`. `process` hasn't been reaped yet so
+  // its pid can't have been reused.
+  int r = (int) syscall(SYS_pidfd_open, process, 0);
+  if (r >= 0) {
+    *pidfd = r;
+  }
+
+  return error_unify(r);
+#else
+  (void) process;
+  return -ENOSYS;
+#endif
 }
 
 static int parse_status(int status)
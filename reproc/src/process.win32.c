@@ -411,6 +411,41 @@ finish:
   return error_unify_or_else(r, 1);
 }
 
+int process_launch(HANDLE *process,
+                   const char *const *argv,
+                   struct process_options options,
+                   HANDLE *pending)
+{
+  // `CreateProcess` reports errors directly so there's nothing to wait for.
+  *pending = HANDLE_INVALID;
+  return process_start(process, argv, options);
+}
+
+int process_finish(HANDLE process, HANDLE pending)
+{
+  (void) process;
+  (void) pending;
+  return 0;
+}
+
+int process_started(HANDLE pending)
+{
+  (void) pending;
+  return 0;
+}
+
+bool process_pidfd_supported(void)
+{
+  return false;
+}
+
+int process_pidfd(HANDLE process, HANDLE *pidfd)
+{
+  (void) process;
+  (void) pidfd;
+  return -ERROR_CALL_NOT_IMPLEMENTED;
+}
+
 int process_wait(HANDLE process)
 {
   assert(process);
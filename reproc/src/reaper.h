@@ -0,0 +1,96 @@
+#pragma once
+
+#include "pipe.h"
+#include "process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// The reaper finds out when child processes exit through a single `SIGCHLD`
+// handler instead of a pidfd or exit pipe per child process. The handler writes
+// to a self-pipe which is polled instead of the exit handle of each process.
+// When the self-pipe becomes readable, all exited child processes are reaped
+// with `waitid(P_ALL)` and their exit status is stored until it is asked for.
+//
+// Because `waitid(P_ALL)` reaps every child process, child processes that were
+// not started while the reaper was running are reaped as well. To keep the exit
+// status of the ones started by reproc, they are tracked with `reaper_expect`
+// and `reaper_track` whether the reaper is running or not. Their exit status is
+// kept until `reaper_claim` or `reaper_reap` asks for it. The exit status of
+// child processes not started by reproc is dropped.
+//
+// The reaper is only supported on POSIX systems. On Windows, `reaper_start`
+// returns an error and `reaper_acquire` always returns false.
+
+// Installs the `SIGCHLD` handler if it isn't installed yet.
+int reaper_start(void);
+
+// Restores the previous `SIGCHLD` handler. Fails with `EBUSY` if there are
+// still child processes registered with the reaper or being started.
+int reaper_stop(void);
+
+// Returns true if the reaper is running. If it is, it keeps running until
+// `reaper_release` is called.
+bool reaper_acquire(void);
+
+void reaper_release(void);
+
+// Keeps the reaper from reaping child processes until `reaper_unlock` is called
+// so that a child process started in between can't be reaped before it's
+// registered with `reaper_register`. Only the launch of the child process
+// should happen in between since other threads can't wait for child processes
+// or start them while the reaper is locked. Must be called between
+// `reaper_acquire` and `reaper_release`.
+void reaper_lock(void);
+
+void reaper_unlock(void);
+
+// Registers `process` with the reaper. Must be called between `reaper_lock` and
+// `reaper_unlock`.
+int reaper_register(process_type process);
+
+// Forgets about `process`, which was registered or tracked. If `process` is
+// still running, it is reaped by the reaper (if running) when it exits.
+void reaper_unregister(process_type process);
+
+// Must be called before starting a child process without the reaper. Until the
+// matching `reaper_track` call, the reaper keeps the exit status of every child
+// process it reaps in case it turns out to be the one being started.
+void reaper_expect(void);
+
+// Tracks `process`, which was started without the reaper after calling
+// `reaper_expect`. Pass `PROCESS_INVALID` if no child process was started.
+int reaper_track(process_type process);
+
+// Waits for `process`, which has exited and is tracked, and forgets about it.
+// If the reaper reaped it already, its exit status is returned instead.
+int reaper_reap(process_type process);
+
+// Returns true and stores the exit status of `process` in `status` if the
+// reaper has reaped it while it was tracked. The reaper forgets about `process`
+// afterwards.
+bool reaper_claim(process_type process, int *status);
+
+// Returns true and stores the exit status of `process` in `status` if the
+// reaper has collected it. Exit statuses are collected by `reaper_enter` and
+// `reaper_leave`.
+bool reaper_exited(process_type process, int *status);
+
+// Returns the amount of child processes the reaper knows about. Only used by
+// the tests.
+size_t reaper_size(void);
+
+// Returns the self-pipe of the reaper. It becomes readable when a child process
+// exits.
+pipe_type reaper_pipe(void);
+
+// Collects the exit status of all exited child processes and registers the
+// calling thread as polling the self-pipe. Check `reaper_exited` after calling
+// this function and before polling the self-pipe to make sure no exit goes
+// unnoticed.
+void reaper_enter(void);
+
+// Unregisters the calling thread as polling the self-pipe. If the self-pipe
+// became readable, collects the exit status of all exited child processes and
+// wakes up the other threads polling the self-pipe if any of them exited.
+void reaper_leave(bool readable);
@@ -0,0 +1,548 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "reaper.h"
+
+#include "error.h"
+#include "macro.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(REPROC_MULTITHREADED)
+  #include <pthread.h>
+#endif
+
+enum { STATUS_RUNNING = -1 };
+
+enum kind {
+  // Started while the reaper was running.
+  KIND_REGISTERED,
+  // Started by reproc while the reaper wasn't running. If the reaper reaps it,
+  // its exit status is kept until `reaper_claim` or `reaper_reap` asks for it.
+  KIND_TRACKED,
+  // Reaped while a child process was being started without the reaper. It
+  // might turn out to be that child process once `reaper_track` is called.
+  KIND_UNKNOWN
+};
+
+struct entry {
+  // 0 marks an empty slot.
+  pid_t pid;
+  int status;
+  enum kind kind;
+};
+
+// Every child process started by reproc is tracked so the table starts out
+// with static storage to keep `reproc_start` from allocating memory.
+static struct entry initial[64];
+
+static struct {
+  // The process that installed the `SIGCHLD` handler. Processes forked from it
+  // don't inherit the handler (see `process_fork`) so the reaper isn't running
+  // in them.
+  pid_t owner;
+  struct {
+    int read;
+    int write;
+  } pipe;
+  struct sigaction previous;
+  // Open addressing hash table of child processes keyed by pid.
+  struct entry *entries;
+  size_t size;
+  size_t capacity;
+  // The amount of registered entries in `entries`.
+  size_t registered;
+  // The amount of unknown entries in `entries`.
+  size_t unknown;
+  // The amount of child processes being started with the reaper.
+  size_t acquired;
+  // The amount of child processes being started without the reaper.
+  size_t expected;
+  // The amount of threads polling the self-pipe.
+  size_t waiters;
+} reaper = { .owner = -1,
+             .pipe = { -1, -1 },
+             .entries = initial,
+             .capacity = ARRAY_SIZE(initial) };
+
+#if defined(REPROC_MULTITHREADED)
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void lock(void)
+{
+#if defined(REPROC_MULTITHREADED)
+  int r = pthread_mutex_lock(&mutex);
+  ASSERT_UNUSED(r == 0);
+#endif
+}
+
+static void unlock(void)
+{
+#if defined(REPROC_MULTITHREADED)
+  int r = pthread_mutex_unlock(&mutex);
+  ASSERT_UNUSED(r == 0);
+#endif
+}
+
+static bool running(void)
+{
+  // Avoid the `getpid` system call if the reaper was never started.
+  return reaper.owner != -1 && reaper.owner == getpid();
+}
+
+static void handler(int signal)
+{
+  (void) signal;
+
+  // `write` might overwrite `errno` of the interrupted code.
+  int saved = errno;
+  // If the pipe is full, there's already a wakeup pending.
+  (void) !write(reaper.pipe.write, "", 1);
+  errno = saved;
+}
+
+static void wake(size_t amount)
+{
+  for (size_t i = 0; i < amount; i++) {
+    if (write(reaper.pipe.write, "", 1) < 0) {
+      break;
+    }
+  }
+}
+
+static size_t slot(pid_t pid)
+{
+  // `capacity` is always a power of two.
+  return ((size_t) pid * 2654435761U) & (reaper.capacity - 1);
+}
+
+static struct entry *find(pid_t pid)
+{
+  for (size_t i = slot(pid);; i = (i + 1) & (reaper.capacity - 1)) {
+    if (reaper.entries[i].pid == pid) {
+      return &reaper.entries[i];
+    }
+
+    if (reaper.entries[i].pid == 0) {
+      return NULL;
+    }
+  }
+}
+
+static void insert(struct entry entry)
+{
+  size_t i = slot(entry.pid);
+
+  while (reaper.entries[i].pid != 0) {
+    i = (i + 1) & (reaper.capacity - 1);
+  }
+
+  reaper.entries[i] = entry;
+  reaper.size++;
+}
+
+static void erase(struct entry *entry)
+{
+  size_t i = (size_t)(entry - reaper.entries);
+  size_t mask = reaper.capacity - 1;
+
+  // Move later entries of the same probe sequence back so that lookups don't
+  // stop early at the slot we're emptying.
+  for (size_t j = (i + 1) & mask; reaper.entries[j].pid != 0;
+       j = (j + 1) & mask) {
+    size_t home = slot(reaper.entries[j].pid);
+
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      reaper.entries[i] = reaper.entries[j];
+      i = j;
+    }
+  }
+
+  reaper.entries[i] = (struct entry){ 0, 0, KIND_REGISTERED };
+  reaper.size--;
+}
+
+static int grow(void)
+{
+  // Keep the load factor at or below 1/2.
+  if ((reaper.size + 1) * 2 <= reaper.capacity) {
+    return 0;
+  }
+
+  size_t capacity = reaper.capacity * 2;
+  struct entry *entries = calloc(capacity, sizeof(struct entry));
+  if (entries == NULL) {
+    return -1;
+  }
+
+  struct entry *previous = reaper.entries;
+  size_t previous_capacity = reaper.capacity;
+
+  reaper.entries = entries;
+  reaper.capacity = capacity;
+  reaper.size = 0;
+
+  for (size_t i = 0; i < previous_capacity; i++) {
+    if (previous[i].pid != 0) {
+      insert(previous[i]);
+    }
+  }
+
+  if (previous != initial) {
+    free(previous);
+  }
+
+  return 0;
+}
+
+// Reaps all exited child processes and stores their exit status. Wakes up the
+// threads polling the self-pipe if the exit status of any registered process
+// was stored.
+static void collect(void)
+{
+  bool collected = false;
+
+  while (true) {
+    siginfo_t info;
+    info.si_pid = 0;
+
+    int r = waitid(P_ALL, 0, &info, WEXITED | WNOHANG);
+    if (r < 0 || info.si_pid == 0) {
+      break;
+    }
+
+    // Keep in sync with `parse_status` in process.posix.c.
+    int status = info.si_code == CLD_EXITED ? info.si_status
+                                            : info.si_status + 128;
+
+    struct entry *entry = find(info.si_pid);
+    if (entry != NULL) {
+      entry->status = status;
+      collected = collected || entry->kind == KIND_REGISTERED;
+      continue;
+    }
+
+    // Child processes not started by reproc are none of our business. We only
+    // hold on to their exit status if it might belong to a child process that
+    // is being started without the reaper and hasn't been tracked yet. If we're
+    // out of memory, the exit status is lost.
+    if (reaper.expected > 0 && grow() == 0) {
+      insert((struct entry){ info.si_pid, status, KIND_UNKNOWN });
+      reaper.unknown++;
+    }
+  }
+
+  if (collected) {
+    wake(reaper.waiters);
+  }
+}
+
+int reaper_start(void)
+{
+  int r = 0;
+
+  lock();
+
+  if (running()) {
+    goto finish;
+  }
+
+  r = pipe_init(&reaper.pipe.read, &reaper.pipe.write);
+  if (r < 0) {
+    goto finish;
+  }
+
+  // The handler can't block and we only read from the pipe after `poll` says
+  // it's readable but another thread might beat us to it.
+  r = pipe_nonblocking(reaper.pipe.read, true);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = pipe_nonblocking(reaper.pipe.write, true);
+  if (r < 0) {
+    goto finish;
+  }
+
+  struct sigaction action = { .sa_handler = handler,
+                              .sa_flags = SA_RESTART | SA_NOCLDSTOP };
+
+  r = sigemptyset(&action.sa_mask);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = sigaction(SIGCHLD, &action, &reaper.previous);
+  if (r < 0) {
+    goto finish;
+  }
+
+  reaper.owner = getpid();
+
+finish:
+  if (r < 0) {
+    reaper.pipe.read = pipe_destroy(reaper.pipe.read);
+    reaper.pipe.write = pipe_destroy(reaper.pipe.write);
+  }
+
+  unlock();
+
+  return error_unify(r);
+}
+
+int reaper_stop(void)
+{
+  int r = 0;
+
+  lock();
+
+  if (!running()) {
+    goto finish;
+  }
+
+  if (reaper.registered > 0 || reaper.acquired > 0) {
+    r = -EBUSY;
+    goto finish;
+  }
+
+  r = sigaction(SIGCHLD, &reaper.previous, NULL);
+  if (r < 0) {
+    goto finish;
+  }
+
+  reaper.pipe.read = pipe_destroy(reaper.pipe.read);
+  reaper.pipe.write = pipe_destroy(reaper.pipe.write);
+  reaper.owner = -1;
+
+finish:
+  unlock();
+
+  return error_unify(r);
+}
+
+bool reaper_acquire(void)
+{
+  lock();
+
+  bool acquired = running();
+  reaper.acquired += acquired;
+
+  unlock();
+
+  return acquired;
+}
+
+void reaper_release(void)
+{
+  lock();
+
+  assert(reaper.acquired > 0);
+  reaper.acquired--;
+
+  unlock();
+}
+
+void reaper_lock(void)
+{
+  lock();
+}
+
+void reaper_unlock(void)
+{
+  unlock();
+}
+
+// Stores `entry` in the table, replacing the entry of a child process with the
+// same pid. That child process has exited and its pid has been reused.
+static int store(struct entry entry)
+{
+  struct entry *existing = find(entry.pid);
+  if (existing != NULL) {
+    reaper.registered -= existing->kind == KIND_REGISTERED;
+    reaper.unknown -= existing->kind == KIND_UNKNOWN;
+    *existing = entry;
+  } else {
+    int r = grow();
+    if (r < 0) {
+      return error_unify(r);
+    }
+
+    insert(entry);
+  }
+
+  reaper.registered += entry.kind == KIND_REGISTERED;
+
+  return 0;
+}
+
+int reaper_register(pid_t process)
+{
+  assert(running());
+
+  // The reaper was locked before `process` was started so it can't have
+  // reaped it yet.
+  return store((struct entry){ process, STATUS_RUNNING, KIND_REGISTERED });
+}
+
+void reaper_expect(void)
+{
+  lock();
+  reaper.expected++;
+  unlock();
+}
+
+int reaper_track(pid_t process)
+{
+  int r = 0;
+
+  lock();
+
+  assert(reaper.expected > 0);
+  reaper.expected--;
+
+  if (process != PROCESS_INVALID) {
+    struct entry *entry = find(process);
+
+    if (entry != NULL && entry->kind == KIND_UNKNOWN) {
+      // The reaper reaped `process` before we got here.
+      entry->kind = KIND_TRACKED;
+      reaper.unknown--;
+    } else {
+      r = store((struct entry){ process, STATUS_RUNNING, KIND_TRACKED });
+    }
+  }
+
+  // None of the remaining unknown entries can belong to a child process
+  // started by reproc anymore.
+  for (size_t i = 0; reaper.expected == 0 && reaper.unknown > 0;) {
+    if (reaper.entries[i].pid != 0 &&
+        reaper.entries[i].kind == KIND_UNKNOWN) {
+      // `erase` might move a later entry into slot `i`.
+      erase(&reaper.entries[i]);
+      reaper.unknown--;
+    } else {
+      i++;
+    }
+  }
+
+  unlock();
+
+  return r;
+}
+
+int reaper_reap(pid_t process)
+{
+  lock();
+
+  // `process` has exited so this doesn't block. We hold the lock so that its
+  // pid can't be reused and tracked by another thread before we forget it.
+  int r = process_wait(process);
+
+  struct entry *entry = find(process);
+  if (entry != NULL && entry->kind == KIND_TRACKED) {
+    // The reaper beat us to it.
+    if (r < 0 && entry->status != STATUS_RUNNING) {
+      r = entry->status;
+    }
+
+    erase(entry);
+  }
+
+  unlock();
+
+  return r;
+}
+
+void reaper_unregister(pid_t process)
+{
+  lock();
+
+  struct entry *entry = find(process);
+  if (entry != NULL && entry->kind != KIND_UNKNOWN) {
+    reaper.registered -= entry->kind == KIND_REGISTERED;
+    erase(entry);
+  }
+
+  unlock();
+}
+
+bool reaper_claim(pid_t process, int *status)
+{
+  assert(status);
+
+  lock();
+
+  struct entry *entry = find(process);
+  bool claimed = entry != NULL && entry->kind == KIND_TRACKED &&
+                 entry->status != STATUS_RUNNING;
+
+  if (claimed) {
+    *status = entry->status;
+    erase(entry);
+  }
+
+  unlock();
+
+  return claimed;
+}
+
+bool reaper_exited(pid_t process, int *status)
+{
+  assert(status);
+
+  lock();
+
+  struct entry *entry = find(process);
+  assert(entry && entry->kind == KIND_REGISTERED);
+
+  *status = entry->status;
+
+  unlock();
+
+  return *status != STATUS_RUNNING;
+}
+
+size_t reaper_size(void)
+{
+  lock();
+  size_t size = reaper.size;
+  unlock();
+
+  return size;
+}
+
+int reaper_pipe(void)
+{
+  return reaper.pipe.read;
+}
+
+void reaper_enter(void)
+{
+  lock();
+  reaper.waiters++;
+  collect();
+  unlock();
+}
+
+void reaper_leave(bool readable)
+{
+  lock();
+
+  assert(reaper.waiters > 0);
+  reaper.waiters--;
+
+  if (readable) {
+    // Only take a single wakeup so that other threads that woke up at the same
+    // time don't go back to sleep because we emptied the pipe.
+    char buffer = 0;
+    (void) !read(reaper.pipe.read, &buffer, 1);
+    collect();
+  }
+
+  unlock();
+}
@@ -0,0 +1,82 @@
+#include "reaper.h"
+
+#include <windows.h>
+
+// Windows doesn't have `SIGCHLD` and process handles can be waited on directly
+// so there's no reaper on Windows.
+
+int reaper_start(void)
+{
+  return -ERROR_CALL_NOT_IMPLEMENTED;
+}
+
+int reaper_stop(void)
+{
+  return 0;
+}
+
+bool reaper_acquire(void)
+{
+  return false;
+}
+
+void reaper_release(void) {}
+
+void reaper_lock(void) {}
+
+void reaper_unlock(void) {}
+
+int reaper_register(process_type process)
+{
+  (void) process;
+  return -ERROR_CALL_NOT_IMPLEMENTED;
+}
+
+void reaper_unregister(process_type process)
+{
+  (void) process;
+}
+
+void reaper_expect(void) {}
+
+int reaper_track(process_type process)
+{
+  (void) process;
+  return 0;
+}
+
+int reaper_reap(process_type process)
+{
+  return process_wait(process);
+}
+
+bool reaper_claim(process_type process, int *status)
+{
+  (void) process;
+  (void) status;
+  return false;
+}
+
+bool reaper_exited(process_type process, int *status)
+{
+  (void) process;
+  (void) status;
+  return false;
+}
+
+size_t reaper_size(void)
+{
+  return 0;
+}
+
+pipe_type reaper_pipe(void)
+{
+  return PIPE_INVALID;
+}
+
+void reaper_enter(void) {}
+
+void reaper_leave(bool readable)
+{
+  (void) readable;
+}
@@ -5,7 +5,9 @@
 static int redirect_pipe(pipe_type *parent,
                          handle_type *child,
                          REPROC_STREAM stream,
-                         bool nonblocking)
+                         size_t size,
+                         bool nonblocking,
+                         bool socket)
 {
   assert(parent);
   assert(child);
@@ -13,15 +15,37 @@ static int redirect_pipe(pipe_type *parent,
   pipe_type pipe[] = { PIPE_INVALID, PIPE_INVALID };
   int r = -1;
 
-  r = pipe_init(&pipe[0], &pipe[1]);
+  r = socket ? pipe_socket(&pipe[0], &pipe[1]) : pipe_init(&pipe[0], &pipe[1]);
   if (r < 0) {
     goto finish;
   }
 
-  r = pipe_nonblocking(stream == REPROC_STREAM_IN ? pipe[1] : pipe[0],
-                       nonblocking);
-  if (r < 0) {
-    goto finish;
+  if (size > 0) {
+    // Resize the parent's end since that's the one we query the capacity of
+    // later on (this matters on Windows where each end has its own buffers).
+    r = pipe_resize(stream == REPROC_STREAM_IN ? pipe[1] : pipe[0], size);
+    if (r < 0) {
+      goto finish;
+    }
+
+    // Each end of a socket pair has its own buffers on every platform.
+    if (socket) {
+      r = pipe_resize(stream == REPROC_STREAM_IN ? pipe[0] : pipe[1], size);
+      if (r < 0) {
+        goto finish;
+      }
+    }
+
+    r = 0;
+  }
+
+  // Pipes are created in blocking mode so we only have to change the mode if
+  // `nonblocking` is enabled.
+  if (nonblocking) {
+    r = pipe_nonblocking(stream == REPROC_STREAM_IN ? pipe[1] : pipe[0], true);
+    if (r < 0) {
+      goto finish;
+    }
   }
 
   *parent = stream == REPROC_STREAM_IN ? pipe[1] : pipe[0];
@@ -52,7 +76,13 @@ int redirect_init(pipe_type *parent,
   switch (redirect.type) {
 
     case REPROC_REDIRECT_PIPE:
-      r = redirect_pipe(parent, child, stream, nonblocking);
+      r = redirect_pipe(parent, child, stream, redirect.pipe_size,
+                        nonblocking, false);
+      break;
+
+    case REPROC_REDIRECT_SOCKET:
+      r = redirect_pipe(parent, child, stream, redirect.pipe_size,
+                        nonblocking, true);
       break;
 
     case REPROC_REDIRECT_PARENT:
@@ -102,6 +132,18 @@ int redirect_init(pipe_type *parent,
 
       break;
 
+    case REPROC_REDIRECT_MEMFD:
+      assert(stream != REPROC_STREAM_IN);
+
+      r = redirect_memfd(child);
+      if (r < 0) {
+        break;
+      }
+
+      *parent = PIPE_INVALID;
+
+      break;
+
     case REPROC_REDIRECT_STDOUT:
       assert(stream == REPROC_STREAM_ERR);
       assert(out != HANDLE_INVALID);
@@ -121,6 +163,7 @@ handle_type redirect_destroy(handle_type child, REPROC_REDIRECT type)
 {
   switch (type) {
     case REPROC_REDIRECT_PIPE:
+    case REPROC_REDIRECT_SOCKET:
       // We know `handle` is a pipe if `REDIRECT_PIPE` is used so the cast is
       // safe. This little hack prevents us from having to introduce a generic
       // handle type.
@@ -134,6 +177,10 @@ handle_type redirect_destroy(handle_type child, REPROC_REDIRECT type)
     case REPROC_REDIRECT_HANDLE:
     case REPROC_REDIRECT_STDOUT:
       break;
+    case REPROC_REDIRECT_MEMFD:
+      // `reproc_capture` needs the file after the child process exits so the
+      // process keeps it open until it's destroyed.
+      break;
   }
 
   return HANDLE_INVALID;
@@ -21,3 +21,13 @@ int redirect_parent(handle_type *child, REPROC_STREAM stream);
 int redirect_discard(handle_type *child, REPROC_STREAM stream);
 
 int redirect_file(handle_type *child, FILE *file);
+
+int redirect_memfd(handle_type *child);
+
+// Creates an anonymous file that contains a copy of `data` and can't be
+// modified afterwards (a sealed memfd on Linux).
+int redirect_memfd_input(handle_type *child, const uint8_t *data, size_t size);
+
+// Opens the file indicated by `handle` again for reading so that the result
+// has its own file offset, starting at the beginning of the file.
+int redirect_reopen(handle_type *child, handle_type handle);
@@ -1,14 +1,41 @@
 #define _POSIX_C_SOURCE 200809L
 
+#if defined(__linux__)
+  // `syscall` and `F_ADD_SEALS`
+  #define _GNU_SOURCE
+#endif
+
 #include "redirect.h"
 
 #include "error.h"
+#include "handle.h"
 #include "pipe.h"
 
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+  #include <sys/syscall.h>
+
+  #if !defined(MFD_CLOEXEC)
+    #define MFD_CLOEXEC 0x0001U
+  #endif
+
+  #if !defined(MFD_ALLOW_SEALING)
+    #define MFD_ALLOW_SEALING 0x0002U
+  #endif
+
+  #if !defined(F_ADD_SEALS)
+    #define F_ADD_SEALS 1033
+    #define F_SEAL_SEAL 0x0001
+    #define F_SEAL_SHRINK 0x0002
+    #define F_SEAL_GROW 0x0004
+    #define F_SEAL_WRITE 0x0008
+  #endif
+#endif
 
 static FILE *stream_to_file(REPROC_STREAM stream)
 {
@@ -78,3 +105,139 @@ int redirect_file(int *child, FILE *file)
 
   return 0;
 }
+
+// Creates an anonymous file with `memfd_create` and `flags` on Linux or an
+// unlinked temporary file elsewhere. Returns 1 if a memfd was created.
+static int memfd(int *fd, unsigned int flags)
+{
+  int r = -1;
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+  r = (int) syscall(SYS_memfd_create, "reproc", flags);
+  if (r >= 0) {
+    *fd = r;
+    return 1;
+  }
+
+  if (errno != ENOSYS) {
+    return error_unify(r);
+  }
+#else
+  (void) flags;
+#endif
+
+  // Fall back to an unlinked temporary file.
+  FILE *file = tmpfile();
+  if (file == NULL) {
+    return error_unify(-1);
+  }
+
+  r = fcntl(fileno(file), F_DUPFD_CLOEXEC, 0);
+  fclose(file);
+
+  if (r < 0) {
+    return error_unify(r);
+  }
+
+  *fd = r;
+
+  return 0;
+}
+
+int redirect_memfd(int *child)
+{
+  assert(child);
+
+  int r = memfd(child, MFD_CLOEXEC);
+  return r < 0 ? r : 0;
+}
+
+int redirect_memfd_input(int *child, const uint8_t *data, size_t size)
+{
+  assert(child);
+  assert(data || size == 0);
+
+  int fd = HANDLE_INVALID;
+  int r = -1;
+
+  r = memfd(&fd, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (r < 0) {
+    goto finish;
+  }
+
+  bool sealable = r > 0;
+
+  for (size_t written = 0; written < size; written += (size_t) r) {
+    r = (int) write(fd, data + written, size - written);
+    if (r < 0) {
+      goto finish;
+    }
+  }
+
+#if defined(__linux__)
+  if (sealable) {
+    // Make sure nobody can modify the input once it's been handed out.
+    r = fcntl(fd, F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    if (r < 0) {
+      goto finish;
+    }
+  }
+#else
+  (void) sealable;
+#endif
+
+  r = (int) lseek(fd, 0, SEEK_SET);
+  if (r < 0) {
+    goto finish;
+  }
+
+  *child = fd;
+  fd = HANDLE_INVALID;
+  r = 0;
+
+finish:
+  handle_destroy(fd);
+  return error_unify(r);
+}
+
+int redirect_reopen(int *child, int handle)
+{
+  assert(child);
+  assert(handle != HANDLE_INVALID);
+
+  int r = -1;
+
+#if defined(__linux__)
+  // Opening the file again through /proc gives the child process its own file
+  // offset so it reads the file from the start, no matter how many other
+  // processes read from the same file.
+  char path[sizeof("/proc/self/fd/") + 10];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", handle);
+
+  r = open(path, O_RDONLY | O_CLOEXEC);
+  if (r >= 0) {
+    *child = r;
+    return 0;
+  }
+
+  if (errno != ENOENT) {
+    return error_unify(r);
+  }
+#endif
+
+  // Without /proc, the best we can do is copying the file.
+
+  const uint8_t *data = NULL;
+  size_t size = 0;
+
+  r = handle_map(handle, &data, &size);
+  if (r < 0) {
+    return r;
+  }
+
+  r = redirect_memfd_input(child, data, size);
+  handle_unmap(data, size);
+
+  return r;
+}
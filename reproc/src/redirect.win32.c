@@ -90,3 +90,109 @@ int redirect_file(HANDLE *child, FILE *file)
 
   return error_unify(r);
 }
+
+int redirect_memfd(HANDLE *child)
+{
+  assert(child);
+
+  char directory[MAX_PATH + 1];
+  char path[MAX_PATH + 1];
+  int r = 0;
+
+  r = (int) GetTempPath(sizeof(directory), directory);
+  if (r == 0) {
+    return error_unify(r);
+  }
+
+  r = (int) GetTempFileName(directory, "rpc", 0, path);
+  if (r == 0) {
+    return error_unify(r);
+  }
+
+  // The file is deleted when the last handle to it is closed.
+  HANDLE handle = CreateFile(path, GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                 FILE_SHARE_DELETE,
+                             &INHERIT, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_TEMPORARY |
+                                 FILE_FLAG_DELETE_ON_CLOSE,
+                             (HANDLE) FILE_NO_TEMPLATE);
+  if (handle == INVALID_HANDLE_VALUE) {
+    r = 0;
+    return error_unify(r);
+  }
+
+  *child = handle;
+
+  return 0;
+}
+
+int redirect_memfd_input(HANDLE *child, const uint8_t *data, size_t size)
+{
+  assert(child);
+  assert(data || size == 0);
+
+  HANDLE handle = HANDLE_INVALID;
+  int r = 0;
+
+  // Windows doesn't have sealed files so we settle for a temporary file.
+  r = redirect_memfd(&handle);
+  if (r < 0) {
+    return r;
+  }
+
+  for (size_t written = 0; written < size;) {
+    DWORD chunk = size - written > MAXDWORD ? MAXDWORD
+                                            : (DWORD) (size - written);
+    DWORD bytes_written = 0;
+
+    r = WriteFile(handle, data + written, chunk, &bytes_written, NULL);
+    if (r == 0) {
+      goto finish;
+    }
+
+    written += bytes_written;
+  }
+
+  LARGE_INTEGER start = { 0 };
+
+  r = SetFilePointerEx(handle, start, NULL, FILE_BEGIN);
+  if (r == 0) {
+    goto finish;
+  }
+
+  *child = handle;
+  handle = HANDLE_INVALID;
+
+finish:
+  handle_destroy(handle);
+  return error_unify(r);
+}
+
+int redirect_reopen(HANDLE *child, HANDLE handle)
+{
+  assert(child);
+  assert(handle != HANDLE_INVALID);
+
+  int r = 0;
+
+  // A new handle has its own file pointer so the child process reads the file
+  // from the start, no matter how many other processes read from it.
+  HANDLE result = ReOpenFile(handle, GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                 FILE_SHARE_DELETE,
+                             0);
+  if (result == INVALID_HANDLE_VALUE) {
+    return error_unify(r);
+  }
+
+  r = SetHandleInformation(result, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
+  if (r == 0) {
+    handle_destroy(result);
+    return error_unify(r);
+  }
+
+  *child = result;
+
+  return 0;
+}
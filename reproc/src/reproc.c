@@ -1,33 +1,34 @@
 #include <reproc/reproc.h>
 
+#include "cache.h"
 #include "clock.h"
 #include "error.h"
 #include "handle.h"
+#include "helper.h"
 #include "init.h"
 #include "macro.h"
 #include "options.h"
 #include "pipe.h"
 #include "process.h"
+#include "reaper.h"
 #include "redirect.h"
+#include "state.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
-
-struct reproc_t {
-  process_type handle;
-  struct {
-    pipe_type in;
-    pipe_type out;
-    pipe_type err;
-    pipe_type exit;
-  } pipe;
-  int status;
-  reproc_stop_actions stop;
-  int64_t deadline;
+#include <string.h>
+
+struct reproc_command_t {
+  const char *const *argv;
+  // Parsed options. `environment`, `working_directory` and `input` point to
+  // copies owned by the command.
+  reproc_options options;
+  // Location of `argv[0]` if it was found in `PATH` when the command was
+  // created.
+  const char *program;
 };
 
-enum { STATUS_NOT_STARTED = -1, STATUS_IN_PROGRESS = -2, STATUS_IN_CHILD = -3 };
-
 #define SIGOFFSET 128
 
 const int REPROC_SIGKILL = SIGOFFSET + 9;
@@ -36,43 +37,247 @@ const int REPROC_SIGTERM = SIGOFFSET + 15;
 const int REPROC_INFINITE = -1;
 const int REPROC_DEADLINE = -2;
 
-static int setup_input(pipe_type *pipe, const uint8_t *data, size_t size)
+// Adaptive pipes don't grow beyond the default value of
+// /proc/sys/fs/pipe-max-size so unprivileged processes can always grow them.
+enum { ADAPTIVE_MAX = 1 << 20 };
+
+pipe_type *output_pipe(reproc_t *process, REPROC_STREAM stream)
 {
-  if (data == NULL || size == 0) {
-    assert(data == NULL);
-    assert(size == 0);
-    return 0;
+  return stream == REPROC_STREAM_OUT ? &process->pipe.out : &process->pipe.err;
+}
+
+// Returns the index of the extra stream of `process` that `stream` refers to
+// (see `REPROC_STREAM_EXTRA`) or -1 if it doesn't refer to one.
+static int extra_index(reproc_t *process, REPROC_STREAM stream)
+{
+  int index = (int) stream - REPROC_STREAM_ERR - 1;
+  return index >= 0 && (size_t) index < process->extra.size ? index : -1;
+}
+
+// Returns the parent's end of `stream` or `NULL` if `process` doesn't have
+// such a stream.
+static pipe_type *stream_pipe(reproc_t *process, REPROC_STREAM stream)
+{
+  switch (stream) {
+    case REPROC_STREAM_IN:
+      return &process->pipe.in;
+    case REPROC_STREAM_OUT:
+      return &process->pipe.out;
+    case REPROC_STREAM_ERR:
+      return &process->pipe.err;
   }
 
-  assert(pipe && *pipe != PIPE_INVALID);
+  int index = extra_index(process, stream);
+  return index >= 0 ? &process->extra.pipe[index] : NULL;
+}
 
-  // `reproc_write` only needs the child process stdin pipe to be initialized.
-  size_t written = 0;
-  int r = -1;
+// Returns true if the parent process reads from `stream`.
+static bool is_output(reproc_t *process, REPROC_STREAM stream)
+{
+  if (stream == REPROC_STREAM_OUT || stream == REPROC_STREAM_ERR) {
+    return true;
+  }
 
-  // Make sure we don't block indefinitely when `input` is bigger than the
-  // size of the pipe.
-  r = pipe_nonblocking(*pipe, true);
-  if (r < 0) {
+  int index = extra_index(process, stream);
+  return index >= 0 && !(process->extra.in & (1 << index));
+}
+
+// Returns true if the parent process writes to `stream`.
+static bool is_input(reproc_t *process, REPROC_STREAM stream)
+{
+  if (stream == REPROC_STREAM_IN) {
+    return true;
+  }
+
+  int index = extra_index(process, stream);
+  return index >= 0 && process->extra.in & (1 << index);
+}
+
+// Returns true if `stream` is a socket that we write to with `pipe_send`.
+static bool is_socket(reproc_t *process, REPROC_STREAM stream)
+{
+  if (stream == REPROC_STREAM_IN) {
+    return process->socket;
+  }
+
+  int index = extra_index(process, stream);
+  return index >= 0 && process->extra.socket & (1 << index);
+}
+
+static int init_adaptive(reproc_t *process,
+                         REPROC_STREAM stream,
+                         reproc_redirect redirect)
+{
+  if (!redirect.adaptive) {
+    return 0;
+  }
+
+  int r = pipe_capacity(*output_pipe(process, stream));
+  if (r <= 0) {
+    // We can't grow the pipe if we don't know how large it is.
     return r;
   }
 
-  while (written < size) {
-    r = pipe_write(*pipe, data + written, size - written);
+  process->adaptive[stream - REPROC_STREAM_OUT].size = (size_t) r;
+  process->adaptive[stream - REPROC_STREAM_OUT].enabled = true;
+
+  return 0;
+}
+
+void adapt(reproc_t *process, REPROC_STREAM stream, size_t size, int r)
+{
+  // Extra streams can't be adaptive.
+  if (stream != REPROC_STREAM_OUT && stream != REPROC_STREAM_ERR) {
+    return;
+  }
+
+  size_t i = (size_t) (stream - REPROC_STREAM_OUT);
+
+  if (!process->adaptive[i].enabled) {
+    return;
+  }
+
+  if (r <= 0 || (size_t) r < size) {
+    process->adaptive[i].streak = 0;
+    return;
+  }
+
+  process->adaptive[i].streak += (size_t) r;
+
+  if (process->adaptive[i].streak < 2 * process->adaptive[i].size) {
+    return;
+  }
+
+  process->adaptive[i].streak = 0;
+
+  r = pipe_resize(*output_pipe(process, stream),
+                  2 * process->adaptive[i].size);
+
+  // Stop growing when the system refuses to grow the pipe (for example, when
+  // the user exceeds /proc/sys/fs/pipe-user-pages-soft).
+  if (r <= (int) process->adaptive[i].size) {
+    process->adaptive[i].enabled = false;
+    return;
+  }
+
+  process->adaptive[i].size = (size_t) r;
+  process->adaptive[i].enabled = r < ADAPTIVE_MAX;
+}
+
+// Closes `*pipe` after removing it from the poller of `process`.
+static void release(reproc_t *process, pipe_type *pipe)
+{
+  pipe_type released = *pipe;
+  *pipe = PIPE_INVALID;
+
+  // This only removes pipes from the poller or moves a socket shared by stdin
+  // and stdout to another slot, neither of which can fail in practice.
+  watch(process);
+
+  pipe_destroy(released);
+}
+
+void close_stream(reproc_t *process, REPROC_STREAM stream)
+{
+  pipe_type *pipe = stream_pipe(process, stream);
+  assert(pipe);
+
+  // A write queued by `reproc_poller_write` can't complete anymore.
+  if (stream == REPROC_STREAM_IN) {
+    process->watch.write.data = NULL;
+    process->watch.write.size = 0;
+  }
+
+  pipe_type *other = stream == REPROC_STREAM_IN    ? &process->pipe.out
+                     : stream == REPROC_STREAM_OUT ? &process->pipe.in
+                                                   : NULL;
+
+  if (other != NULL && *pipe != PIPE_INVALID && *pipe == *other) {
+    pipe_type shared = *pipe;
+    *pipe = PIPE_INVALID;
+    watch(process);
+
+    // Errors don't matter here since the stream is closed either way.
+    pipe_shutdown(shared, stream == REPROC_STREAM_IN);
+    return;
+  }
+
+  release(process, pipe);
+}
+
+static void close_streams(reproc_t *process)
+{
+  close_stream(process, REPROC_STREAM_IN);
+  close_stream(process, REPROC_STREAM_OUT);
+  close_stream(process, REPROC_STREAM_ERR);
+
+  for (size_t i = 0; i < process->extra.size; i++) {
+    release(process, &process->extra.pipe[i]);
+  }
+}
+
+int write_input(reproc_t *process)
+{
+  if (process->input.size == 0) {
+    return 0;
+  }
+
+  while (process->input.size > 0 && process->pipe.in != PIPE_INVALID) {
+    int r = (process->socket ? pipe_send : pipe_write)(
+        process->pipe.in, process->input.data, process->input.size);
+
+    if (r == REPROC_EWOULDBLOCK) {
+      return 1;
+    }
+
+    // The child process closed stdin so it won't read the rest of the input.
+    if (r == REPROC_EPIPE) {
+      break;
+    }
+
     if (r < 0) {
       return r;
     }
 
-    assert(written + (size_t) r <= size);
-    written += (size_t) r;
+    assert((size_t) r <= process->input.size);
+    process->input.data += r;
+    process->input.size -= (size_t) r;
   }
 
-  *pipe = pipe_destroy(*pipe);
+  process->input.data = NULL;
+  process->input.size = 0;
+  close_stream(process, REPROC_STREAM_IN);
 
   return 0;
 }
 
-static int expiry(int timeout, int64_t deadline)
+static int setup_input(reproc_t *process, const uint8_t *data, size_t size)
+{
+  if (data == NULL || size == 0) {
+    assert(data == NULL);
+    assert(size == 0);
+    return 0;
+  }
+
+  assert(process->pipe.in != PIPE_INVALID);
+
+  // Make sure we don't block indefinitely when `input` is bigger than the
+  // size of the pipe. Whatever doesn't fit is written by `reproc_write_input`
+  // once the child process starts reading.
+  int r = pipe_nonblocking(process->pipe.in, true);
+  if (r < 0) {
+    return r;
+  }
+
+  process->input.data = data;
+  process->input.size = size;
+
+  r = write_input(process);
+
+  return r < 0 ? r : 0;
+}
+
+int expiry(int timeout, int64_t deadline)
 {
   if (timeout == REPROC_INFINITE && deadline == REPROC_INFINITE) {
     return REPROC_INFINITE;
@@ -99,28 +304,44 @@ static int expiry(int timeout, int64_t deadline)
   return MIN(timeout, remaining);
 }
 
-static size_t find_earliest_deadline(reproc_event_source *sources,
-                                     size_t num_sources)
+// Returns the earliest deadline of the processes in `sources` or
+// `REPROC_INFINITE` if none of them have a deadline.
+static int64_t find_earliest_deadline(reproc_event_source *sources,
+                                      size_t num_sources)
 {
   assert(sources);
   assert(num_sources > 0);
 
-  size_t earliest = 0;
-  int min = REPROC_INFINITE;
+  int64_t earliest = REPROC_INFINITE;
 
   for (size_t i = 0; i < num_sources; i++) {
-    reproc_t *process = sources[i].process;
-    int current = expiry(REPROC_INFINITE, process->deadline);
+    int64_t deadline = sources[i].process->deadline;
 
-    if (min == REPROC_INFINITE || current < min) {
-      earliest = i;
-      min = current;
+    if (deadline != REPROC_INFINITE &&
+        (earliest == REPROC_INFINITE || deadline < earliest)) {
+      earliest = deadline;
     }
   }
 
   return earliest;
 }
 
+bool expires_first(int timeout, int64_t deadline)
+{
+  if (deadline == REPROC_INFINITE) {
+    return false;
+  }
+
+  return timeout == REPROC_INFINITE ||
+         expiry(REPROC_INFINITE, deadline) <= timeout;
+}
+
+int64_t expired_at(int64_t deadline, bool expired)
+{
+  int64_t now = reproc_now();
+  return expired && now < deadline ? deadline : now;
+}
+
 reproc_t *reproc_new(void)
 {
   reproc_t *process = malloc(sizeof(reproc_t));
@@ -132,48 +353,106 @@ reproc_t *reproc_new(void)
                          .pipe = { .in = PIPE_INVALID,
                                    .out = PIPE_INVALID,
                                    .err = PIPE_INVALID,
-                                   .exit = PIPE_INVALID },
+                                   .exit = PIPE_INVALID,
+                                   .start = PIPE_INVALID },
+                         .capture = { { .handle = HANDLE_INVALID },
+                                      { .handle = HANDLE_INVALID } },
                          .status = STATUS_NOT_STARTED,
                          .deadline = REPROC_INFINITE };
 
+  for (size_t i = 0; i < WATCH_SLOTS; i++) {
+    process->watch.pipes[i].pipe = PIPE_INVALID;
+  }
+
   return process;
 }
 
-int reproc_start(reproc_t *process,
-                 const char *const *argv,
-                 reproc_options options)
+// Starts `process` with options that have already been parsed by
+// `parse_options` but doesn't wait for the child process to call `exec`. If
+// `program` is not `NULL`, it is the location of `argv[0]` that was resolved in
+// advance. If this function returns > 0, `complete` has to be called with
+// `pending` to finish starting the process.
+static int launch(reproc_t *process,
+                  const char *const *argv,
+                  reproc_options options,
+                  const char *program,
+                  handle_type *pending)
 {
-  ASSERT_EINVAL(process);
-  ASSERT_EINVAL(process->status == STATUS_NOT_STARTED);
-
   struct {
     handle_type in;
     handle_type out;
     handle_type err;
     pipe_type exit;
-  } child = { HANDLE_INVALID, HANDLE_INVALID, HANDLE_INVALID, PIPE_INVALID };
+    handle_type extra[REPROC_EXTRA_STREAMS_MAX];
+  } child = { HANDLE_INVALID, HANDLE_INVALID, HANDLE_INVALID, PIPE_INVALID,
+              { 0 } };
+  // File that the child process reads stdin from if `redirect.in` is
+  // `REPROC_REDIRECT_MEMFD`.
+  handle_type input = HANDLE_INVALID;
+  // `options.extra_streams` with their defaults filled in and the file
+  // descriptors they're redirected to in the child process.
+  reproc_extra_stream extra[REPROC_EXTRA_STREAMS_MAX];
+  int extra_fd[REPROC_EXTRA_STREAMS_MAX];
   int r = -1;
 
-  r = parse_options(&options, argv);
-  if (r < 0) {
-    goto finish;
+  for (size_t i = 0; i < options.num_extra_streams; i++) {
+    child.extra[i] = HANDLE_INVALID;
+    process->extra.pipe[i] = PIPE_INVALID;
   }
 
+  process->extra.size = options.num_extra_streams;
+  process->extra.in = 0;
+  process->extra.socket = 0;
+
+  // The reaper keeps running until the child process is registered with it.
+  bool reaper = reaper_acquire();
+
   r = init();
   if (r < 0) {
     goto finish;
   }
 
+  if (options.redirect.in.type == REPROC_REDIRECT_MEMFD) {
+    r = options.redirect.in.handle
+            ? redirect_reopen(&input, options.redirect.in.handle)
+            : redirect_memfd_input(&input, options.input.data,
+                                   options.input.size);
+    if (r < 0) {
+      goto finish;
+    }
+
+    // The input doesn't go through the stdin pipe anymore.
+    options.redirect.in = (reproc_redirect){ .type = REPROC_REDIRECT_HANDLE,
+                                             .handle = input };
+    options.input.data = NULL;
+    options.input.size = 0;
+  }
+
   r = redirect_init(&process->pipe.in, &child.in, REPROC_STREAM_IN,
                     options.redirect.in, options.nonblocking, HANDLE_INVALID);
   if (r < 0) {
     goto finish;
   }
 
-  r = redirect_init(&process->pipe.out, &child.out, REPROC_STREAM_OUT,
-                    options.redirect.out, options.nonblocking, HANDLE_INVALID);
-  if (r < 0) {
-    goto finish;
+  process->socket = options.redirect.in.type == REPROC_REDIRECT_SOCKET;
+
+  if (process->socket &&
+      options.redirect.out.type == REPROC_REDIRECT_SOCKET) {
+    // stdin and stdout share a single bidirectional socket.
+    process->pipe.out = process->pipe.in;
+    child.out = child.in;
+  } else {
+    r = redirect_init(&process->pipe.out, &child.out, REPROC_STREAM_OUT,
+                      options.redirect.out, options.nonblocking,
+                      HANDLE_INVALID);
+    if (r < 0) {
+      goto finish;
+    }
+  }
+
+  // The process owns the files of `REPROC_REDIRECT_MEMFD` from here on out.
+  if (options.redirect.out.type == REPROC_REDIRECT_MEMFD) {
+    process->capture[0].handle = child.out;
   }
 
   r = redirect_init(&process->pipe.err, &child.err, REPROC_STREAM_ERR,
@@ -182,74 +461,511 @@ int reproc_start(reproc_t *process,
     goto finish;
   }
 
-  r = pipe_init(&process->pipe.exit, &child.exit);
+  if (options.redirect.err.type == REPROC_REDIRECT_MEMFD) {
+    process->capture[1].handle = child.err;
+  }
+
+  for (size_t i = 0; i < options.num_extra_streams; i++) {
+    extra[i] = options.extra_streams[i];
+
+    r = parse_extra_stream(&extra[i]);
+    if (r < 0) {
+      goto finish;
+    }
+
+    r = redirect_init(&process->extra.pipe[i], &child.extra[i],
+                      extra[i].input ? REPROC_STREAM_IN : REPROC_STREAM_OUT,
+                      extra[i].redirect, options.nonblocking, HANDLE_INVALID);
+    if (r < 0) {
+      goto finish;
+    }
+
+    extra_fd[i] = extra[i].fd;
+
+    if (extra[i].input) {
+      process->extra.in |= 1 << i;
+    }
+
+    if (extra[i].redirect.type == REPROC_REDIRECT_SOCKET) {
+      process->extra.socket |= 1 << i;
+    }
+  }
+
+  // A pidfd tells us when the child process exits without the child process
+  // inheriting the write end of an exit pipe, which it might leak to processes
+  // that outlive it.
+  bool use_pidfd = !reaper && process_pidfd_supported();
+
+  if (!reaper && !use_pidfd) {
+    r = pipe_init(&process->pipe.exit, &child.exit);
+    if (r < 0) {
+      goto finish;
+    }
+  }
+
+  r = setup_input(process, options.input.data, options.input.size);
+  if (r < 0) {
+    goto finish;
+  }
+
+  r = init_adaptive(process, REPROC_STREAM_OUT, options.redirect.out);
   if (r < 0) {
     goto finish;
   }
 
-  r = setup_input(&process->pipe.in, options.input.data, options.input.size);
+  r = init_adaptive(process, REPROC_STREAM_ERR, options.redirect.err);
   if (r < 0) {
     goto finish;
   }
 
+  struct {
+    const char *path;
+    handle_type fd;
+  } executable = { program, HANDLE_INVALID };
+
+  if (program == NULL && options.cache != NULL && argv != NULL) {
+    r = cache_resolve(options.cache, argv[0], options.environment,
+                      options.working_directory, &executable.path,
+                      &executable.fd);
+    if (r < 0) {
+      goto finish;
+    }
+  }
+
   struct process_options process_options = {
     .environment = options.environment,
     .working_directory = options.working_directory,
     .handle = { .in = child.in,
                 .out = child.out,
                 .err = child.err,
-                .exit = (handle_type) child.exit }
+                .exit = (handle_type) child.exit },
+    .extra = { .handle = child.extra,
+               .fd = extra_fd,
+               .size = options.num_extra_streams },
+    .executable = { .path = executable.path, .fd = executable.fd },
+    .vfork = options.spawn == REPROC_SPAWN_VFORK,
+    .helper = options.spawn == REPROC_SPAWN_HELPER
   };
 
-  r = process_start(&process->handle, argv, process_options);
+  // The reaper can't reap the child process before it's registered. Only the
+  // launch itself is covered so other threads can keep waiting for and starting
+  // processes while we prepare the child process. Without the reaper, a reaper
+  // started in the meantime keeps the exit status of the child process until
+  // it's tracked.
+  if (reaper) {
+    reaper_lock();
+  } else {
+    reaper_expect();
+  }
+
+  r = process_launch(&process->handle, argv, process_options, pending);
+
+  int error = 0;
+
+  if (reaper) {
+    error = r > 0 ? reaper_register(process->handle) : 0;
+    reaper_unlock();
+  } else {
+    error = reaper_track(r > 0 ? process->handle : PROCESS_INVALID);
+  }
+
+  if (error < 0) {
+    process_kill(process->handle);
+    *pending = handle_destroy(*pending);
+    // The reaper might beat us to it, in which case it keeps the exit status
+    // until the pid is reused.
+    process_wait(process->handle);
+    r = error;
+    goto finish;
+  }
+
+  process->reaper = r > 0 && reaper;
+
+  if (r > 0 && use_pidfd) {
+    handle_type pidfd = HANDLE_INVALID;
+
+    error = process_pidfd(process->handle, &pidfd);
+    if (error < 0) {
+      // We have no way to find out when the child process exits so we get rid
+      // of it.
+      process_kill(process->handle);
+      *pending = handle_destroy(*pending);
+      reaper_reap(process->handle);
+      r = error;
+      goto finish;
+    }
+
+    process->pipe.exit = (pipe_type) pidfd;
+  }
+
+finish:
+  // Either an error has ocurred or the child pipe endpoints have been copied to
+  // the stdin/stdout/stderr streams of the child process. Either way, they can
+  // be safely closed.
+  redirect_destroy(child.in, options.redirect.in.type);
+  if (child.out != child.in) {
+    redirect_destroy(child.out, options.redirect.out.type);
+  }
+  redirect_destroy(child.err, options.redirect.err.type);
+
+  for (size_t i = 0; i < options.num_extra_streams; i++) {
+    // `extra[i]` is only parsed once its handle is created.
+    if (child.extra[i] != HANDLE_INVALID) {
+      redirect_destroy(child.extra[i], extra[i].redirect.type);
+    }
+  }
+
+  pipe_destroy(child.exit);
+  handle_destroy(input);
+
+  if (reaper) {
+    reaper_release();
+  }
+
   if (r < 0) {
+    process->handle = process_destroy(process->handle);
+    close_streams(process);
+    process->pipe.exit = pipe_destroy(process->pipe.exit);
+    process->capture[0].handle = handle_destroy(process->capture[0].handle);
+    process->capture[1].handle = handle_destroy(process->capture[1].handle);
+    deinit();
+  } else if (r == 0) {
+    process->handle = PROCESS_INVALID;
+    // `process_launch` has already taken care of closing the handles for us.
+    process->pipe.in = PIPE_INVALID;
+    process->pipe.out = PIPE_INVALID;
+    process->pipe.err = PIPE_INVALID;
+    process->pipe.exit = PIPE_INVALID;
+    process->extra.size = 0;
+    process->capture[0].handle = HANDLE_INVALID;
+    process->capture[1].handle = HANDLE_INVALID;
+    process->status = STATUS_IN_CHILD;
+  }
+
+  return r;
+}
+
+// Waits until the child process started by `launch` has called `exec`. If the
+// `async` option is enabled, `pending` is stored in `process` instead so that
+// `reproc_poll` can report when the child process calls `exec`.
+static int complete(reproc_t *process,
+                    handle_type pending,
+                    reproc_options options)
+{
+  if (options.async) {
+    if (pending != HANDLE_INVALID) {
+      process->pipe.start = (pipe_type) pending;
+    }
+  } else {
+    int r = process_finish(process->handle, pending);
+    if (r < 0) {
+      reaper_unregister(process->handle);
+      process->reaper = false;
+
+      process->handle = process_destroy(process->handle);
+      close_streams(process);
+      process->pipe.exit = pipe_destroy(process->pipe.exit);
+      deinit();
+      return r;
+    }
+  }
+
+  process->stop = options.stop;
+
+  if (options.deadline != REPROC_INFINITE) {
+    process->deadline = reproc_now() + options.deadline;
+  }
+
+  process->status = STATUS_IN_PROGRESS;
+
+  return 1;
+}
+
+static int start(reproc_t *process,
+                 const char *const *argv,
+                 reproc_options options,
+                 const char *program)
+{
+  handle_type pending = HANDLE_INVALID;
+
+  int r = launch(process, argv, options, program, &pending);
+  if (r <= 0) {
+    return r;
+  }
+
+  return complete(process, pending, options);
+}
+
+int reproc_start(reproc_t *process,
+                 const char *const *argv,
+                 reproc_options options)
+{
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status == STATUS_NOT_STARTED);
+
+  int r = parse_options(&options, argv);
+  if (r < 0) {
+    return r;
+  }
+
+  return start(process, argv, options, NULL);
+}
+
+int reproc_start_many(reproc_t *const *processes,
+                      const char *const *const *argvs,
+                      size_t num_processes,
+                      reproc_options options,
+                      int *results)
+{
+  ASSERT_EINVAL(processes);
+  ASSERT_EINVAL(argvs);
+  ASSERT_EINVAL(num_processes > 0);
+  ASSERT_EINVAL(results);
+  ASSERT_EINVAL(!options.fork);
+
+  int r = parse_options(&options, argvs[0]);
+  if (r < 0) {
+    return r;
+  }
+
+  handle_type *pending = malloc(num_processes * sizeof(handle_type));
+  if (pending == NULL) {
+    return REPROC_ENOMEM;
+  }
+
+  // Launch all child processes before waiting for any of them so they can get
+  // to `exec` in parallel.
+
+  for (size_t i = 0; i < num_processes; i++) {
+    reproc_t *process = processes[i];
+    const char *const *argv = argvs[i];
+
+    pending[i] = HANDLE_INVALID;
+
+    if (process == NULL || process->status != STATUS_NOT_STARTED ||
+        argv == NULL || argv[0] == NULL) {
+      results[i] = REPROC_EINVAL;
+      continue;
+    }
+
+    results[i] = launch(process, argv, options, NULL, &pending[i]);
+  }
+
+  int started = 0;
+
+  for (size_t i = 0; i < num_processes; i++) {
+    if (results[i] <= 0) {
+      continue;
+    }
+
+    results[i] = complete(processes[i], pending[i], options);
+
+    if (results[i] > 0) {
+      started++;
+    }
+  }
+
+  free(pending);
+
+  return started;
+}
+
+// Returns the total size of the NUL-terminated strings in the `NULL`-terminated
+// array `strings` and stores the amount of strings in `count`.
+static size_t strings_size(const char *const *strings, size_t *count)
+{
+  size_t size = 0;
+
+  for (*count = 0; strings != NULL && strings[*count] != NULL; (*count)++) {
+    size += strlen(strings[*count]) + 1;
+  }
+
+  return size;
+}
+
+// Copies the strings in the `NULL`-terminated array `strings` to `buffer` and
+// stores pointers to the copies in `copy`. Returns a pointer to the first byte
+// after the last copy.
+static char *strings_copy(char *buffer,
+                          const char **copy,
+                          const char *const *strings)
+{
+  size_t i = 0;
+
+  for (; strings[i] != NULL; i++) {
+    size_t size = strlen(strings[i]) + 1;
+    memcpy(buffer, strings[i], size);
+    copy[i] = buffer;
+    buffer += size;
+  }
+
+  copy[i] = NULL;
+
+  return buffer;
+}
+
+reproc_command_t *reproc_command_new(const char *const *argv,
+                                     reproc_options options)
+{
+  ASSERT_RETURN(argv != NULL, NULL);
+
+  reproc_command_t *command = NULL;
+  cache_type *cache = NULL;
+  const char *program = NULL;
+  handle_type fd = HANDLE_INVALID;
+  int r = -1;
+
+  r = parse_options(&options, argv);
+  if (r < 0) {
+    goto finish;
+  }
+
+  // Search for `argv[0]` in `PATH` once instead of every time the command is
+  // started.
+  cache = cache_new();
+  if (cache == NULL) {
+    goto finish;
+  }
+
+  r = cache_resolve(cache, argv[0], options.environment,
+                    options.working_directory, &program, &fd);
+  if (r < 0) {
+    goto finish;
+  }
+
+  size_t argc = 0;
+  size_t envc = 0;
+  size_t size = sizeof(reproc_command_t) + strings_size(argv, &argc) +
+                (argc + 1) * sizeof(char *) + options.input.size;
+
+  if (options.environment != NULL) {
+    size += strings_size(options.environment, &envc);
+    size += (envc + 1) * sizeof(char *);
+  }
+
+  if (options.working_directory != NULL) {
+    size += strlen(options.working_directory) + 1;
+  }
+
+  if (program != NULL) {
+    size += strlen(program) + 1;
+  }
+
+  // Everything is stored in a single allocation. The pointer arrays come first
+  // to keep them aligned, followed by the input and the strings.
+  command = malloc(size);
+  if (command == NULL) {
     goto finish;
   }
 
-  if (r > 0) {
-    process->stop = options.stop;
+  const char **arguments = (const char **) (command + 1);
+  const char **environment = arguments + argc + 1;
+  uint8_t *input = (uint8_t *) (environment + (options.environment != NULL
+                                                   ? envc + 1
+                                                   : 0));
+  char *strings = (char *) (input + options.input.size);
+
+  strings = strings_copy(strings, arguments, argv);
+
+  if (options.environment != NULL) {
+    strings = strings_copy(strings, environment, options.environment);
+    options.environment = environment;
+  }
+
+  if (options.working_directory != NULL) {
+    size = strlen(options.working_directory) + 1;
+    memcpy(strings, options.working_directory, size);
+    options.working_directory = strings;
+    strings += size;
+  }
+
+  if (options.input.data != NULL) {
+    memcpy(input, options.input.data, options.input.size);
+    options.input.data = input;
+  }
+
+  command->program = NULL;
+
+  if (program != NULL) {
+    size = strlen(program) + 1;
+    memcpy(strings, program, size);
+    command->program = strings;
+  }
+
+  // `argv[0]` has been resolved already and caches can't be shared between
+  // threads.
+  options.cache = NULL;
+
+  command->argv = arguments;
+  command->options = options;
+
+finish:
+  cache_destroy(cache);
+
+  return command;
+}
+
+int reproc_command_start(const reproc_command_t *command, reproc_t *process)
+{
+  ASSERT_EINVAL(command);
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status == STATUS_NOT_STARTED);
+
+  return start(process, command->argv, command->options, command->program);
+}
+
+reproc_command_t *reproc_command_destroy(reproc_command_t *command)
+{
+  free(command);
+  return NULL;
+}
+
+void collect_start(reproc_t *process)
+{
+  pipe_type start = process->pipe.start;
+  process->pipe.start = PIPE_INVALID;
+  watch(process);
+
+  int r = process_started((handle_type) start);
+
+  if (r < 0) {
+    process->error = r;
+  }
+}
+
+static bool contains_valid_pipe(pipe_set *sets, size_t num_sets)
+{
+  for (size_t i = 0; i < num_sets; i++) {
+    if (sets[i].in != PIPE_INVALID || sets[i].out != PIPE_INVALID ||
+        sets[i].err != PIPE_INVALID || sets[i].start != PIPE_INVALID) {
+      return true;
+    }
 
-    if (options.deadline != REPROC_INFINITE) {
-      process->deadline = reproc_now() + options.deadline;
+    for (size_t j = 0; j < sets[i].num_extra; j++) {
+      if (sets[i].extra[j] != PIPE_INVALID) {
+        return true;
+      }
     }
   }
 
-finish:
-  // Either an error has ocurred or the child pipe endpoints have been copied to
-  // the stdin/stdout/stderr streams of the child process. Either way, they can
-  // be safely closed.
-  redirect_destroy(child.in, options.redirect.in.type);
-  redirect_destroy(child.out, options.redirect.out.type);
-  redirect_destroy(child.err, options.redirect.err.type);
-  pipe_destroy(child.exit);
+  return false;
+}
 
-  if (r < 0) {
-    process->handle = process_destroy(process->handle);
-    process->pipe.in = pipe_destroy(process->pipe.in);
-    process->pipe.out = pipe_destroy(process->pipe.out);
-    process->pipe.err = pipe_destroy(process->pipe.err);
-    process->pipe.exit = pipe_destroy(process->pipe.exit);
-    deinit();
-  } else if (r == 0) {
-    process->handle = PROCESS_INVALID;
-    // `process_start` has already taken care of closing the handles for us.
-    process->pipe.in = PIPE_INVALID;
-    process->pipe.out = PIPE_INVALID;
-    process->pipe.err = PIPE_INVALID;
-    process->pipe.exit = PIPE_INVALID;
-    process->status = STATUS_IN_CHILD;
-  } else {
-    process->status = STATUS_IN_PROGRESS;
+int remaining(int64_t end)
+{
+  if (end == REPROC_INFINITE) {
+    return REPROC_INFINITE;
   }
 
-  return r;
+  int64_t now = reproc_now();
+
+  return now >= end ? 0 : (int) (end - now);
 }
 
-static bool contains_valid_pipe(pipe_set *sets, size_t num_sets)
+static bool contains_events(pipe_set *sets, size_t num_sets)
 {
   for (size_t i = 0; i < num_sets; i++) {
-    if (sets[i].in != PIPE_INVALID || sets[i].out != PIPE_INVALID ||
-        sets[i].err != PIPE_INVALID) {
+    if (sets[i].events != 0) {
       return true;
     }
   }
@@ -257,23 +973,40 @@ static bool contains_valid_pipe(pipe_set *sets, size_t num_sets)
   return false;
 }
 
-int reproc_poll(reproc_event_source *sources, size_t num_sources, int timeout)
+// Adds `PIPE_EVENT_EXIT` to the sets of the processes waited for by the reaper
+// that have exited. Returns true if any of them exited.
+static bool reaped_exits(reproc_event_source *sources,
+                         pipe_set *sets,
+                         size_t num_sources)
 {
-  ASSERT_EINVAL(sources);
-  ASSERT_EINVAL(num_sources > 0);
+  bool exited = false;
+  int status = 0;
 
-  size_t earliest = find_earliest_deadline(sources, num_sources);
-  int64_t deadline = sources[earliest].process->deadline;
+  for (size_t i = 0; i < num_sources; i++) {
+    reproc_t *process = sources[i].process;
 
-  if (deadline == 0) {
-    sources[earliest].events = REPROC_EVENT_DEADLINE;
-    return 0;
+    if (sources[i].interests & REPROC_EVENT_EXIT && process->reaper &&
+        process->status < 0 && reaper_exited(process->handle, &status)) {
+      sets[i].events |= PIPE_EVENT_EXIT;
+      exited = true;
+    }
   }
 
+  return exited;
+}
+
+int reproc_poll(reproc_event_source *sources, size_t num_sources, int timeout)
+{
+  ASSERT_EINVAL(sources);
+  ASSERT_EINVAL(num_sources > 0);
+
+  int64_t deadline = find_earliest_deadline(sources, num_sources);
+  bool expires = expires_first(timeout, deadline);
   int first = expiry(timeout, deadline);
   int r = REPROC_ENOMEM;
 
-  pipe_set *sets = calloc(sizeof(pipe_set), num_sources);
+  // Leave room for the self-pipe of the reaper.
+  pipe_set *sets = calloc(sizeof(pipe_set), num_sources + 1);
   if (sets == NULL) {
     return r;
   }
@@ -288,6 +1021,16 @@ int reproc_poll(reproc_event_source *sources, size_t num_sources, int timeout)
     set->err = interests & REPROC_EVENT_ERR ? process->pipe.err : PIPE_INVALID;
     set->exit = interests & REPROC_EVENT_EXIT ? process->pipe.exit
                                               : PIPE_INVALID;
+    set->start = interests & REPROC_EVENT_START ? process->pipe.start
+                                                : PIPE_INVALID;
+
+    for (size_t j = 0; j < process->extra.size; j++) {
+      set->extra[j] = interests & REPROC_EVENT_EXTRA(j) ? process->extra.pipe[j]
+                                                        : PIPE_INVALID;
+    }
+
+    set->num_extra = process->extra.size;
+    set->extra_in = process->extra.in;
   }
 
   if (!contains_valid_pipe(sets, num_sources)) {
@@ -295,13 +1038,75 @@ int reproc_poll(reproc_event_source *sources, size_t num_sources, int timeout)
     goto finish;
   }
 
-  r = pipe_wait(sets, num_sources, first);
+  // Processes waited for by the reaper don't have an exit handle. Instead, we
+  // poll the self-pipe of the reaper in an extra set and check which of them
+  // exited whenever it becomes readable.
+  bool reaped = false;
+
+  for (size_t i = 0; i < num_sources; i++) {
+    reproc_t *process = sources[i].process;
+
+    if (sources[i].interests & REPROC_EVENT_EXIT && process->reaper &&
+        process->status < 0) {
+      reaped = true;
+    }
+  }
+
+  sets[num_sources] = (pipe_set){ .in = PIPE_INVALID,
+                                  .out = PIPE_INVALID,
+                                  .err = PIPE_INVALID,
+                                  .exit = reaper_pipe(),
+                                  .start = PIPE_INVALID };
+
+  size_t num_sets = reaped ? num_sources + 1 : num_sources;
+  int64_t end = first == REPROC_INFINITE ? REPROC_INFINITE
+                                         : reproc_now() + first;
+
+  while (true) {
+    if (reaped) {
+      reaper_enter();
+
+      if (reaped_exits(sources, sets, num_sources)) {
+        reaper_leave(false);
+        r = 0;
+        break;
+      }
+    }
+
+    r = pipe_wait(sets, num_sets, remaining(end));
+
+    if (!reaped) {
+      break;
+    }
+
+    reaper_leave(r == 0 && sets[num_sources].events != 0);
+
+    if (r == 0 && (reaped_exits(sources, sets, num_sources) ||
+                   contains_events(sets, num_sources))) {
+      break;
+    }
+
+    // The `SIGCHLD` handler of the reaper interrupts `poll`.
+    if (r < 0 && r != -EINTR) {
+      break;
+    }
+  }
 
   if (r == REPROC_ETIMEDOUT) {
     // Differentiate between timeout and deadline expiry. Deadline expiry is an
-    // event, timeout is an error.
-    sources[earliest].events = first == deadline ? REPROC_EVENT_DEADLINE : 0;
-    r = first == deadline ? 0 : REPROC_ETIMEDOUT;
+    // event, timeout is an error. All deadlines that expired are reported at
+    // once.
+    int64_t now = expired_at(deadline, expires);
+    r = REPROC_ETIMEDOUT;
+
+    for (size_t i = 0; i < num_sources; i++) {
+      int64_t current = sources[i].process->deadline;
+      bool expired = current != REPROC_INFINITE && current <= now;
+
+      sources[i].events = expired ? REPROC_EVENT_DEADLINE : 0;
+      r = expired ? 0 : r;
+    }
+
     goto finish;
   }
 
@@ -311,6 +1116,14 @@ int reproc_poll(reproc_event_source *sources, size_t num_sources, int timeout)
 
   for (size_t i = 0; i < num_sources; i++) {
     sources[i].events = sets[i].events;
+
+    if (sets[i].events & PIPE_EVENT_START) {
+      collect_start(sources[i].process);
+
+      if (sources[i].process->error < 0) {
+        sources[i].events |= REPROC_EVENT_EXIT;
+      }
+    }
   }
 
 finish:
@@ -326,11 +1139,10 @@ int reproc_read(reproc_t *process,
 {
   ASSERT_EINVAL(process);
   ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
-  ASSERT_EINVAL(stream == REPROC_STREAM_OUT || stream == REPROC_STREAM_ERR);
+  ASSERT_EINVAL(is_output(process, stream));
   ASSERT_EINVAL(buffer);
 
-  pipe_type *pipe = stream == REPROC_STREAM_OUT ? &process->pipe.out
-                                                : &process->pipe.err;
+  pipe_type *pipe = stream_pipe(process, stream);
   if (*pipe == PIPE_INVALID) {
     return REPROC_EPIPE;
   }
@@ -338,16 +1150,56 @@ int reproc_read(reproc_t *process,
   int r = pipe_read(*pipe, buffer, size);
 
   if (r == REPROC_EPIPE) {
-    *pipe = pipe_destroy(*pipe);
+    close_stream(process, stream);
   }
 
+  adapt(process, stream, size, r);
+
   return r;
 }
 
-int reproc_write(reproc_t *process, const uint8_t *buffer, size_t size)
+int reproc_readv(reproc_t *process,
+                 REPROC_STREAM stream,
+                 const reproc_iovec *buffers,
+                 size_t num_buffers)
+{
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+  ASSERT_EINVAL(is_output(process, stream));
+  ASSERT_EINVAL(buffers);
+  ASSERT_EINVAL(num_buffers > 0);
+
+  pipe_type *pipe = stream_pipe(process, stream);
+  if (*pipe == PIPE_INVALID) {
+    return REPROC_EPIPE;
+  }
+
+  int r = pipe_readv(*pipe, buffers, num_buffers);
+
+  if (r == REPROC_EPIPE) {
+    close_stream(process, stream);
+  }
+
+  size_t size = 0;
+
+  for (size_t i = 0; i < num_buffers && i < PIPE_IOV_MAX; i++) {
+    size += buffers[i].size;
+  }
+
+  adapt(process, stream, size, r);
+
+  return r;
+}
+
+static int write_pipe(reproc_t *process,
+                      REPROC_STREAM stream,
+                      const uint8_t *buffer,
+                      size_t size,
+                      int (*function)(pipe_type, const uint8_t *, size_t))
 {
   ASSERT_EINVAL(process);
   ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+  ASSERT_EINVAL(is_input(process, stream));
 
   if (buffer == NULL) {
     // Allow `NULL` buffers but only if `size == 0`.
@@ -355,37 +1207,214 @@ int reproc_write(reproc_t *process, const uint8_t *buffer, size_t size)
     return 0;
   }
 
+  pipe_type *pipe = stream_pipe(process, stream);
+  if (*pipe == PIPE_INVALID) {
+    return REPROC_EPIPE;
+  }
+
+  // `vmsplice` only works with pipes and `send` keeps sockets from raising
+  // `SIGPIPE`.
+  if (is_socket(process, stream)) {
+    function = pipe_send;
+  }
+
+  int r = function(*pipe, buffer, size);
+
+  if (r == REPROC_EPIPE) {
+    close_stream(process, stream);
+  }
+
+  return r;
+}
+
+int reproc_write(reproc_t *process, const uint8_t *buffer, size_t size)
+{
+  return write_pipe(process, REPROC_STREAM_IN, buffer, size, pipe_write);
+}
+
+int reproc_write_to(reproc_t *process,
+                    REPROC_STREAM stream,
+                    const uint8_t *buffer,
+                    size_t size)
+{
+  return write_pipe(process, stream, buffer, size, pipe_write);
+}
+
+int reproc_write_gift(reproc_t *process, const uint8_t *buffer, size_t size)
+{
+  return write_pipe(process, REPROC_STREAM_IN, buffer, size, pipe_write_gift);
+}
+
+int reproc_writev(reproc_t *process,
+                  const reproc_iovec *buffers,
+                  size_t num_buffers)
+{
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+  ASSERT_EINVAL(buffers);
+  ASSERT_EINVAL(num_buffers > 0);
+
   if (process->pipe.in == PIPE_INVALID) {
     return REPROC_EPIPE;
   }
 
-  int r = pipe_write(process->pipe.in, buffer, size);
+  int r = (process->socket ? pipe_sendv : pipe_writev)(process->pipe.in,
+                                                       buffers, num_buffers);
 
   if (r == REPROC_EPIPE) {
-    process->pipe.in = pipe_destroy(process->pipe.in);
+    close_stream(process, REPROC_STREAM_IN);
   }
 
   return r;
 }
 
+int reproc_write_input(reproc_t *process)
+{
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+
+  return write_input(process);
+}
+
+int reproc_pipe_size(reproc_t *process, REPROC_STREAM stream)
+{
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+
+  pipe_type *pipe = stream_pipe(process, stream);
+  ASSERT_EINVAL(pipe);
+
+  if (*pipe == PIPE_INVALID) {
+    return REPROC_EPIPE;
+  }
+
+  return pipe_capacity(*pipe);
+}
+
+int reproc_handle_of(reproc_t *process,
+                     REPROC_STREAM stream,
+                     reproc_handle *handle)
+{
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+  ASSERT_EINVAL(handle);
+
+  pipe_type *pipe = stream == REPROC_STREAM_EXIT ? &process->pipe.exit
+                                                 : stream_pipe(process, stream);
+  ASSERT_EINVAL(pipe);
+
+  if (*pipe == PIPE_INVALID) {
+    return REPROC_EPIPE;
+  }
+
+  *handle = (reproc_handle) *pipe;
+
+  return 0;
+}
+
+int reproc_memfd_new(const uint8_t *data, size_t size, reproc_handle *handle)
+{
+  ASSERT_EINVAL(data || size == 0);
+  ASSERT_EINVAL(handle);
+
+  return redirect_memfd_input(handle, data, size);
+}
+
+int reproc_capture(reproc_t *process,
+                   REPROC_STREAM stream,
+                   const uint8_t **data,
+                   size_t *size)
+{
+  ASSERT_EINVAL(process);
+  ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
+  ASSERT_EINVAL(stream == REPROC_STREAM_OUT || stream == REPROC_STREAM_ERR);
+  ASSERT_EINVAL(data);
+  ASSERT_EINVAL(size);
+
+  size_t i = (size_t) (stream - REPROC_STREAM_OUT);
+
+  ASSERT_EINVAL(process->capture[i].handle != HANDLE_INVALID);
+  // The child process might still be writing to the file if it hasn't exited.
+  ASSERT_EINVAL(process->status >= 0);
+
+  if (process->capture[i].data == NULL) {
+    int r = handle_map(process->capture[i].handle, &process->capture[i].data,
+                       &process->capture[i].size);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  *data = process->capture[i].data;
+  *size = process->capture[i].size;
+
+  return 0;
+}
+
 int reproc_close(reproc_t *process, REPROC_STREAM stream)
 {
   ASSERT_EINVAL(process);
   ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
 
-  switch (stream) {
-    case REPROC_STREAM_IN:
-      process->pipe.in = pipe_destroy(process->pipe.in);
-      return 0;
-    case REPROC_STREAM_OUT:
-      process->pipe.out = pipe_destroy(process->pipe.out);
-      return 0;
-    case REPROC_STREAM_ERR:
-      process->pipe.err = pipe_destroy(process->pipe.err);
-      return 0;
+  ASSERT_EINVAL(stream_pipe(process, stream));
+
+  close_stream(process, stream);
+
+  if (stream == REPROC_STREAM_IN) {
+    process->input.data = NULL;
+    process->input.size = 0;
+  }
+
+  return 0;
+}
+
+// Stores the exit status of `process` once it has been waited for.
+static void finish_wait(reproc_t *process, int status)
+{
+  release(process, &process->pipe.exit);
+
+  process->status = status;
+  // The poller of `process` doesn't have to watch its exit handle or the
+  // self-pipe of the reaper for it anymore.
+  watch(process);
+
+  if (process->pipe.start != PIPE_INVALID) {
+    // The child process has exited so it has either called `exec` or reported
+    // why it couldn't.
+    collect_start(process);
   }
+}
+
+// Waits until the reaper has collected the exit status of `process`.
+static int wait_reaped(reproc_t *process, int timeout)
+{
+  int64_t end = timeout == REPROC_INFINITE ? REPROC_INFINITE
+                                           : reproc_now() + timeout;
+  int status = 0;
+  int r = -1;
+
+  while (true) {
+    reaper_enter();
+
+    if (reaper_exited(process->handle, &status)) {
+      reaper_leave(false);
+      return status;
+    }
+
+    pipe_set set = { .in = PIPE_INVALID,
+                     .out = PIPE_INVALID,
+                     .err = PIPE_INVALID,
+                     .exit = reaper_pipe(),
+                     .start = PIPE_INVALID };
 
-  return REPROC_EINVAL;
+    r = pipe_wait(&set, 1, remaining(end));
+    reaper_leave(r == 0);
+
+    // The `SIGCHLD` handler of the reaper interrupts `poll`.
+    if (r < 0 && r != -EINTR) {
+      return r;
+    }
+  }
 }
 
 int reproc_wait(reproc_t *process, int timeout)
@@ -397,7 +1426,7 @@ int reproc_wait(reproc_t *process, int timeout)
   int r = -1;
 
   if (process->status >= 0) {
-    return process->status;
+    return process->error < 0 ? process->error : process->status;
   }
 
   if (timeout == REPROC_DEADLINE) {
@@ -406,26 +1435,63 @@ int reproc_wait(reproc_t *process, int timeout)
     timeout = expiry(REPROC_INFINITE, process->deadline);
   }
 
-  pipe_set set = { .in = PIPE_INVALID,
-                   .out = PIPE_INVALID,
-                   .err = PIPE_INVALID,
-                   .exit = process->pipe.exit };
+  if (process->reaper) {
+    r = wait_reaped(process, timeout);
+    if (r < 0) {
+      return r;
+    }
+
+    reaper_unregister(process->handle);
+  } else {
+    pipe_set set = { .in = PIPE_INVALID,
+                     .out = PIPE_INVALID,
+                     .err = PIPE_INVALID,
+                     .exit = process->pipe.exit,
+                     .start = PIPE_INVALID };
 
-  r = pipe_wait(&set, 1, timeout);
-  if (r < 0) {
-    return r;
+    r = pipe_wait(&set, 1, timeout);
+    if (r < 0) {
+      return r;
+    }
+
+    assert(set.events & PIPE_EVENT_EXIT);
+
+    // A reaper started after `process` reaps it as well. It keeps the exit
+    // status for us.
+    r = reaper_reap(process->handle);
+
+    // The exit handle said `process` exited so it can't be waited for anymore
+    // either way. Remember the error so we never signal its pid, which might
+    // have been reused.
+    if (r < 0) {
+      process->error = r;
+      r = 0;
+    }
   }
 
-  assert(set.events & PIPE_EVENT_EXIT);
+  finish_wait(process, r);
 
-  r = process_wait(process->handle);
-  if (r < 0) {
-    return r;
+  return process->error < 0 ? process->error : process->status;
+}
+
+// Returns true if a reaper has reaped `process` already, in which case its pid
+// might have been reused. This includes a reaper started after `process`, whose
+// exit status we take over right away.
+static bool reaped(reproc_t *process)
+{
+  int status = 0;
+
+  if (process->reaper) {
+    return reaper_exited(process->handle, &status);
+  }
+
+  if (!reaper_claim(process->handle, &status)) {
+    return false;
   }
 
-  process->pipe.exit = pipe_destroy(process->pipe.exit);
+  finish_wait(process, status);
 
-  return process->status = r;
+  return true;
 }
 
 int reproc_terminate(reproc_t *process)
@@ -434,7 +1500,7 @@ int reproc_terminate(reproc_t *process)
   ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
   ASSERT_EINVAL(process->status != STATUS_NOT_STARTED);
 
-  if (process->status >= 0) {
+  if (process->status >= 0 || reaped(process)) {
     return 0;
   }
 
@@ -447,7 +1513,7 @@ int reproc_kill(reproc_t *process)
   ASSERT_EINVAL(process->status != STATUS_IN_CHILD);
   ASSERT_EINVAL(process->status != STATUS_NOT_STARTED);
 
-  if (process->status >= 0) {
+  if (process->status >= 0 || reaped(process)) {
     return 0;
   }
 
@@ -499,15 +1565,29 @@ reproc_t *reproc_destroy(reproc_t *process)
 {
   ASSERT_RETURN(process, NULL);
 
+  if (process->watch.poller != NULL) {
+    reproc_poller_remove(process->watch.poller, process);
+  }
+
   if (process->status == STATUS_IN_PROGRESS) {
     reproc_stop(process, process->stop);
   }
 
   process_destroy(process->handle);
-  pipe_destroy(process->pipe.in);
-  pipe_destroy(process->pipe.out);
-  pipe_destroy(process->pipe.err);
+  close_streams(process);
   pipe_destroy(process->pipe.exit);
+  pipe_destroy(process->pipe.start);
+
+  for (size_t i = 0; i < ARRAY_SIZE(process->capture); i++) {
+    handle_unmap(process->capture[i].data, process->capture[i].size);
+    handle_destroy(process->capture[i].handle);
+  }
+
+  if (process->status == STATUS_IN_PROGRESS) {
+    // If the process is still running, the reaper (if running) takes care of
+    // it.
+    reaper_unregister(process->handle);
+  }
 
   if (process->status != STATUS_NOT_STARTED) {
     deinit();
@@ -518,6 +1598,36 @@ reproc_t *reproc_destroy(reproc_t *process)
   return NULL;
 }
 
+int reproc_helper_start(void)
+{
+  return helper_start();
+}
+
+int reproc_helper_stop(void)
+{
+  return helper_stop();
+}
+
+int reproc_reaper_start(void)
+{
+  return reaper_start();
+}
+
+int reproc_reaper_stop(void)
+{
+  return reaper_stop();
+}
+
+reproc_cache_t *reproc_cache_new(void)
+{
+  return cache_new();
+}
+
+reproc_cache_t *reproc_cache_destroy(reproc_cache_t *cache)
+{
+  return cache_destroy(cache);
+}
+
 const char *reproc_strerror(int error)
 {
   return error_string(error);
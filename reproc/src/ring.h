@@ -0,0 +1,65 @@
+#pragma once
+
+#include "pipe.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// An io_uring instance that reads from and writes to pipes on behalf of a
+// poller. Reads pick one of the buffers registered with the ring so a single
+// submission keeps reading (multishot, if the kernel supports it) without a
+// `read` syscall for each chunk of output. Only available on Linux when reproc
+// is built with `REPROC_IO_URING`.
+typedef struct ring ring_type;
+
+typedef struct {
+  uint64_t data;
+  // Amount of bytes transferred or a negative error. A read fails with
+  // `REPROC_EPIPE` once the other end of the pipe is closed. A read that ran
+  // out of buffers completes with 0 and has to be submitted again.
+  int result;
+  // Set if the operation keeps completing. Otherwise, this was its last
+  // completion.
+  bool more;
+  // Output stored by a read or `NULL`. Has to be passed to `ring_recycle` once
+  // it isn't needed anymore.
+  const uint8_t *buffer;
+} ring_completion;
+
+int ring_init(ring_type **ring);
+
+// Returns a handle that is readable while the ring has completions to reap.
+pipe_type ring_handle(ring_type *ring);
+
+// Keeps reading from `pipe` until it fails or runs out of buffers. `data` is
+// reported with every completion.
+int ring_read(ring_type *ring, pipe_type pipe, uint64_t data);
+
+// Writes up to `size` bytes from `buffer` to `pipe`. `buffer` has to stay valid
+// until the write completes or is cancelled. Sockets are written to with
+// `MSG_NOSIGNAL`.
+int ring_write(ring_type *ring,
+               pipe_type pipe,
+               const uint8_t *buffer,
+               size_t size,
+               bool socket,
+               uint64_t data);
+
+// Cancels the operation that reports `data`. Its last completion, if any, is
+// still reaped by `ring_reap`. Once this returns, a cancelled write doesn't
+// access its buffer anymore.
+void ring_cancel(ring_type *ring, uint64_t data);
+
+// Hands the operations queued by `ring_read` and `ring_write` to the kernel.
+int ring_submit(ring_type *ring);
+
+// Stores up to `size` completions in `completions` without waiting and returns
+// the amount stored.
+size_t ring_reap(ring_type *ring, ring_completion *completions, size_t size);
+
+// Makes a buffer returned by `ring_reap` available to reads again.
+void ring_recycle(ring_type *ring, const uint8_t *buffer);
+
+// Cancels all operations and waits until the kernel is done with them.
+ring_type *ring_destroy(ring_type *ring);
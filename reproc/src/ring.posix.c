@@ -0,0 +1,585 @@
+#define _POSIX_C_SOURCE 200809L
+
+#if defined(REPROC_IO_URING)
+  // `syscall` and `MAP_ANONYMOUS`.
+  #define _GNU_SOURCE
+#endif
+
+#include "ring.h"
+
+#include "error.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#if defined(REPROC_IO_URING)
+
+  #include <limits.h>
+  #include <linux/io_uring.h>
+  #include <string.h>
+  #include <sys/mman.h>
+  #include <sys/socket.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+
+  #if !defined(SYS_io_uring_setup)
+    #define SYS_io_uring_setup 425
+    #define SYS_io_uring_enter 426
+    #define SYS_io_uring_register 427
+  #endif
+
+enum {
+  RING_ENTRIES = 256,
+  // Reads store output in one of `RING_BUFFERS` buffers of `RING_BUFFER_SIZE`
+  // bytes. The amount of buffers has to be a power of two.
+  RING_BUFFERS = 128,
+  RING_BUFFER_SIZE = 8192,
+  // Kernel headers older than Linux 6.7 don't define
+  // `IORING_OP_READ_MULTISHOT`.
+  RING_OP_READ_MULTISHOT = 49
+};
+
+// Reported by the requests that cancel other operations.
+  #define RING_CANCEL UINT64_MAX
+
+struct ring {
+  int fd;
+  // The submission and completion queues share a single mapping
+  // (`IORING_FEAT_SINGLE_MMAP`).
+  uint8_t *queues;
+  size_t queues_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  struct {
+    unsigned *head;
+    unsigned *tail;
+    unsigned *flags;
+    unsigned *array;
+    unsigned mask;
+    unsigned entries;
+    // Tail including the operations that haven't been handed to the kernel
+    // yet.
+    unsigned queued;
+  } sq;
+  struct {
+    unsigned *head;
+    unsigned *tail;
+    unsigned mask;
+    struct io_uring_cqe *cqes;
+  } cq;
+  // Ring of buffers that reads pick from and the memory backing them.
+  struct io_uring_buf_ring *buffers;
+  uint8_t *memory;
+  uint16_t tail;
+  bool multishot;
+  // Amount of operations whose last completion hasn't been reaped yet.
+  size_t pending;
+};
+
+static int enter(struct ring *ring,
+                 unsigned submit,
+                 unsigned wait,
+                 unsigned flags)
+{
+  int r = -1;
+
+  do {
+    r = (int) syscall(SYS_io_uring_enter, ring->fd, submit, wait, flags, NULL,
+                      0);
+  } while (r < 0 && errno == EINTR);
+
+  return error_unify_or_else(r, r);
+}
+
+static int control(struct ring *ring, unsigned opcode, void *arg, unsigned size)
+{
+  int r = (int) syscall(SYS_io_uring_register, ring->fd, opcode, arg, size);
+  return error_unify(r);
+}
+
+static void *map(size_t size, int fd, off_t offset)
+{
+  int flags = fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED | MAP_POPULATE;
+  void *result = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, offset);
+  return result == MAP_FAILED ? NULL : result;
+}
+
+static bool supports(struct ring *ring, unsigned opcode)
+{
+  enum { OPS = 256 };
+
+  size_t size = sizeof(struct io_uring_probe) +
+                OPS * sizeof(struct io_uring_probe_op);
+
+  struct io_uring_probe *probe = calloc(1, size);
+  if (probe == NULL) {
+    return false;
+  }
+
+  int r = control(ring, IORING_REGISTER_PROBE, probe, OPS);
+  bool supported = r == 0 && opcode < probe->ops_len &&
+                   probe->ops[opcode].flags & IO_URING_OP_SUPPORTED;
+
+  free(probe);
+
+  return supported;
+}
+
+int ring_init(struct ring **ring)
+{
+  assert(ring);
+
+  struct ring *result = calloc(1, sizeof(struct ring));
+  if (result == NULL) {
+    return -ENOMEM;
+  }
+
+  struct io_uring_params params = { 0 };
+  int r = -1;
+
+  result->fd = (int) syscall(SYS_io_uring_setup, RING_ENTRIES, &params);
+  if (result->fd < 0) {
+    r = error_unify(result->fd);
+    goto finish;
+  }
+
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    r = -ENOSYS;
+    goto finish;
+  }
+
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_size = params.cq_off.cqes +
+                   params.cq_entries * sizeof(struct io_uring_cqe);
+
+  result->queues_size = sq_size > cq_size ? sq_size : cq_size;
+  result->queues = map(result->queues_size, result->fd, IORING_OFF_SQ_RING);
+  if (result->queues == NULL) {
+    r = -errno;
+    goto finish;
+  }
+
+  result->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  result->sqes = map(result->sqes_size, result->fd, IORING_OFF_SQES);
+  if (result->sqes == NULL) {
+    r = -errno;
+    goto finish;
+  }
+
+  uint8_t *queues = result->queues;
+
+  result->sq.head = (unsigned *) (queues + params.sq_off.head);
+  result->sq.tail = (unsigned *) (queues + params.sq_off.tail);
+  result->sq.flags = (unsigned *) (queues + params.sq_off.flags);
+  result->sq.array = (unsigned *) (queues + params.sq_off.array);
+  result->sq.mask = *(unsigned *) (queues + params.sq_off.ring_mask);
+  result->sq.entries = params.sq_entries;
+  result->sq.queued = *result->sq.tail;
+
+  result->cq.head = (unsigned *) (queues + params.cq_off.head);
+  result->cq.tail = (unsigned *) (queues + params.cq_off.tail);
+  result->cq.mask = *(unsigned *) (queues + params.cq_off.ring_mask);
+  result->cq.cqes = (struct io_uring_cqe *) (queues + params.cq_off.cqes);
+
+  // `mmap` returns page aligned memory, which the kernel requires for the ring
+  // of buffers.
+  result->buffers = map(RING_BUFFERS * sizeof(struct io_uring_buf), -1, 0);
+  if (result->buffers == NULL) {
+    r = -errno;
+    goto finish;
+  }
+
+  result->memory = map(RING_BUFFERS * RING_BUFFER_SIZE, -1, 0);
+  if (result->memory == NULL) {
+    r = -errno;
+    goto finish;
+  }
+
+  // Rings of buffers were added in Linux 5.19. Without them, we fall back to
+  // waiting for the pipes to become ready.
+  struct io_uring_buf_reg buffers = {
+    .ring_addr = (uint64_t) (uintptr_t) result->buffers,
+    .ring_entries = RING_BUFFERS,
+    .bgid = 0
+  };
+
+  r = control(result, IORING_REGISTER_PBUF_RING, &buffers, 1);
+  if (r < 0) {
+    goto finish;
+  }
+
+  for (size_t i = 0; i < RING_BUFFERS; i++) {
+    ring_recycle(result, result->memory + i * RING_BUFFER_SIZE);
+  }
+
+  // Writes are cancelled synchronously (Linux 6.0) so their buffers can be
+  // reused right away. Cancelling an operation that doesn't exist tells us
+  // whether that's supported.
+  struct io_uring_sync_cancel_reg cancel = { .addr = RING_CANCEL,
+                                             .fd = -1 };
+
+  r = control(result, IORING_REGISTER_SYNC_CANCEL, &cancel, 1);
+  if (r != -ENOENT) {
+    r = r < 0 ? r : -ENOENT;
+    goto finish;
+  }
+
+  r = 0;
+
+  result->multishot = supports(result, RING_OP_READ_MULTISHOT);
+
+  *ring = result;
+
+finish:
+  if (r < 0) {
+    ring_destroy(result);
+  }
+
+  return r;
+}
+
+int ring_handle(struct ring *ring)
+{
+  assert(ring);
+  return ring->fd;
+}
+
+// Stores the next free submission queue entry in `sqe`. If the queue is full,
+// the queued operations are submitted first.
+static int prepare(struct ring *ring,
+                   int opcode,
+                   int fd,
+                   uint64_t data,
+                   struct io_uring_sqe **sqe)
+{
+  unsigned head = __atomic_load_n(ring->sq.head, __ATOMIC_ACQUIRE);
+
+  if (ring->sq.queued - head == ring->sq.entries) {
+    int r = ring_submit(ring);
+    if (r < 0) {
+      return r;
+    }
+
+    head = __atomic_load_n(ring->sq.head, __ATOMIC_ACQUIRE);
+    if (ring->sq.queued - head == ring->sq.entries) {
+      return -EBUSY;
+    }
+  }
+
+  unsigned index = ring->sq.queued & ring->sq.mask;
+
+  *sqe = &ring->sqes[index];
+  memset(*sqe, 0, sizeof(struct io_uring_sqe));
+  (*sqe)->opcode = (uint8_t) opcode;
+  (*sqe)->fd = fd;
+  (*sqe)->user_data = data;
+
+  ring->sq.array[index] = index;
+  ring->sq.queued++;
+
+  return 0;
+}
+
+int ring_read(struct ring *ring, int pipe, uint64_t data)
+{
+  assert(ring);
+  assert(pipe != PIPE_INVALID);
+
+  struct io_uring_sqe *sqe = NULL;
+  int opcode = ring->multishot ? RING_OP_READ_MULTISHOT : IORING_OP_READ;
+
+  int r = prepare(ring, opcode, pipe, data, &sqe);
+  if (r < 0) {
+    return r;
+  }
+
+  // Pipes don't have a file position so we read from the current one.
+  sqe->off = (uint64_t) -1;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = 0;
+  // Multishot reads fill the entire buffer they pick.
+  sqe->len = ring->multishot ? 0 : RING_BUFFER_SIZE;
+
+  ring->pending++;
+
+  return 0;
+}
+
+int ring_write(struct ring *ring,
+               int pipe,
+               const uint8_t *buffer,
+               size_t size,
+               bool socket,
+               uint64_t data)
+{
+  assert(ring);
+  assert(pipe != PIPE_INVALID);
+  assert(buffer);
+
+  struct io_uring_sqe *sqe = NULL;
+
+  int r = prepare(ring, socket ? IORING_OP_SEND : IORING_OP_WRITE, pipe, data,
+                  &sqe);
+  if (r < 0) {
+    return r;
+  }
+
+  sqe->addr = (uint64_t) (uintptr_t) buffer;
+  sqe->len = (uint32_t) (size < INT_MAX ? size : INT_MAX);
+
+  if (socket) {
+    sqe->msg_flags = MSG_NOSIGNAL;
+  } else {
+    sqe->off = (uint64_t) -1;
+  }
+
+  ring->pending++;
+
+  return 0;
+}
+
+void ring_cancel(struct ring *ring, uint64_t data)
+{
+  assert(ring);
+
+  // The operation has to reach the kernel before it can be cancelled.
+  int r = ring_submit(ring);
+  if (r < 0) {
+    return;
+  }
+
+  // The kernel is done with the buffer of a cancelled write once this
+  // returns. Errors mean the operation already completed.
+  struct io_uring_sync_cancel_reg cancel = { .addr = data,
+                                             .fd = -1,
+                                             .timeout = { -1, -1 } };
+
+  control(ring, IORING_REGISTER_SYNC_CANCEL, &cancel, 1);
+}
+
+int ring_submit(struct ring *ring)
+{
+  assert(ring);
+
+  unsigned flags = __atomic_load_n(ring->sq.flags, __ATOMIC_RELAXED);
+  unsigned overflow = IORING_SQ_CQ_OVERFLOW | IORING_SQ_TASKRUN;
+
+  if (*ring->sq.tail == ring->sq.queued && !(flags & overflow)) {
+    return 0;
+  }
+
+  __atomic_store_n(ring->sq.tail, ring->sq.queued, __ATOMIC_RELEASE);
+
+  unsigned submit = ring->sq.queued -
+                    __atomic_load_n(ring->sq.head, __ATOMIC_ACQUIRE);
+
+  // Asking for completions also moves completions that overflowed the
+  // completion queue back into it.
+  int r = enter(ring, submit, 0, IORING_ENTER_GETEVENTS);
+
+  return r < 0 ? r : 0;
+}
+
+size_t ring_reap(struct ring *ring, ring_completion *completions, size_t size)
+{
+  assert(ring);
+  assert(completions);
+
+  unsigned head = *ring->cq.head;
+  unsigned tail = __atomic_load_n(ring->cq.tail, __ATOMIC_ACQUIRE);
+  size_t count = 0;
+
+  while (head != tail && count < size) {
+    struct io_uring_cqe cqe = ring->cq.cqes[head & ring->cq.mask];
+    head++;
+
+    if (cqe.user_data == RING_CANCEL) {
+      continue;
+    }
+
+    ring_completion *completion = &completions[count++];
+
+    completion->data = cqe.user_data;
+    completion->more = cqe.flags & IORING_CQE_F_MORE;
+    completion->buffer = NULL;
+
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      size_t id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+      completion->buffer = ring->memory + id * RING_BUFFER_SIZE;
+    }
+
+    switch (cqe.res) {
+      // Reads return 0 once the other end of the pipe is closed.
+      case 0:
+      case -ECONNRESET:
+        completion->result = -EPIPE;
+        break;
+      case -ENOBUFS:
+        completion->result = 0;
+        break;
+      default:
+        completion->result = cqe.res;
+    }
+
+    if (!completion->more) {
+      ring->pending--;
+    }
+  }
+
+  __atomic_store_n(ring->cq.head, head, __ATOMIC_RELEASE);
+
+  return count;
+}
+
+void ring_recycle(struct ring *ring, const uint8_t *buffer)
+{
+  assert(ring);
+
+  if (buffer == NULL) {
+    return;
+  }
+
+  size_t id = (size_t) (buffer - ring->memory) / RING_BUFFER_SIZE;
+  struct io_uring_buf *entry =
+      &ring->buffers->bufs[ring->tail & (RING_BUFFERS - 1)];
+
+  // Only these fields may be written since the tail of the ring overlaps the
+  // reserved field of the first entry.
+  entry->addr = (uint64_t) (uintptr_t) (ring->memory + id * RING_BUFFER_SIZE);
+  entry->len = RING_BUFFER_SIZE;
+  entry->bid = (uint16_t) id;
+
+  ring->tail++;
+  __atomic_store_n(&ring->buffers->tail, ring->tail, __ATOMIC_RELEASE);
+}
+
+struct ring *ring_destroy(struct ring *ring)
+{
+  if (ring == NULL) {
+    return NULL;
+  }
+
+  if (ring->pending > 0) {
+    struct io_uring_sqe *sqe = NULL;
+
+    int r = prepare(ring, IORING_OP_ASYNC_CANCEL, -1, RING_CANCEL, &sqe);
+    if (r == 0) {
+      sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+      r = ring_submit(ring);
+    }
+
+    // Reads store output in `memory` until their last completion so we can't
+    // unmap it before then.
+    while (r == 0 && ring->pending > 0) {
+      ring_completion completions[16];
+      size_t count = ring_reap(ring, completions, 16);
+
+      if (count == 0) {
+        r = enter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+        r = r < 0 ? r : 0;
+      }
+    }
+  }
+
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+
+  if (ring->memory != NULL) {
+    munmap(ring->memory, RING_BUFFERS * RING_BUFFER_SIZE);
+  }
+
+  if (ring->buffers != NULL) {
+    munmap(ring->buffers, RING_BUFFERS * sizeof(struct io_uring_buf));
+  }
+
+  if (ring->sqes != NULL) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+
+  if (ring->queues != NULL) {
+    munmap(ring->queues, ring->queues_size);
+  }
+
+  free(ring);
+
+  return NULL;
+}
+
+#else
+
+int ring_init(struct ring **ring)
+{
+  assert(ring);
+  (void) ring;
+
+  return -ENOSYS;
+}
+
+int ring_handle(struct ring *ring)
+{
+  (void) ring;
+  return PIPE_INVALID;
+}
+
+int ring_read(struct ring *ring, int pipe, uint64_t data)
+{
+  (void) ring;
+  (void) pipe;
+  (void) data;
+
+  return -ENOSYS;
+}
+
+int ring_write(struct ring *ring,
+               int pipe,
+               const uint8_t *buffer,
+               size_t size,
+               bool socket,
+               uint64_t data)
+{
+  (void) ring;
+  (void) pipe;
+  (void) buffer;
+  (void) size;
+  (void) socket;
+  (void) data;
+
+  return -ENOSYS;
+}
+
+void ring_cancel(struct ring *ring, uint64_t data)
+{
+  (void) ring;
+  (void) data;
+}
+
+int ring_submit(struct ring *ring)
+{
+  (void) ring;
+  return -ENOSYS;
+}
+
+size_t ring_reap(struct ring *ring, ring_completion *completions, size_t size)
+{
+  (void) ring;
+  (void) completions;
+  (void) size;
+
+  return 0;
+}
+
+void ring_recycle(struct ring *ring, const uint8_t *buffer)
+{
+  (void) ring;
+  (void) buffer;
+}
+
+struct ring *ring_destroy(struct ring *ring)
+{
+  (void) ring;
+  return NULL;
+}
+
+#endif
@@ -0,0 +1,83 @@
+#define _WIN32_WINNT _WIN32_WINNT_VISTA
+
+#include "ring.h"
+
+#include <assert.h>
+#include <windows.h>
+#include <winsock2.h>
+
+// The I/O rings of Windows 11 don't support sockets so pollers always wait for
+// the pipes to become ready instead.
+
+int ring_init(struct ring **ring)
+{
+  assert(ring);
+  (void) ring;
+
+  return -ERROR_NOT_SUPPORTED;
+}
+
+SOCKET ring_handle(struct ring *ring)
+{
+  (void) ring;
+  return PIPE_INVALID;
+}
+
+int ring_read(struct ring *ring, SOCKET pipe, uint64_t data)
+{
+  (void) ring;
+  (void) pipe;
+  (void) data;
+
+  return -ERROR_NOT_SUPPORTED;
+}
+
+int ring_write(struct ring *ring,
+               SOCKET pipe,
+               const uint8_t *buffer,
+               size_t size,
+               bool socket,
+               uint64_t data)
+{
+  (void) ring;
+  (void) pipe;
+  (void) buffer;
+  (void) size;
+  (void) socket;
+  (void) data;
+
+  return -ERROR_NOT_SUPPORTED;
+}
+
+void ring_cancel(struct ring *ring, uint64_t data)
+{
+  (void) ring;
+  (void) data;
+}
+
+int ring_submit(struct ring *ring)
+{
+  (void) ring;
+  return -ERROR_NOT_SUPPORTED;
+}
+
+size_t ring_reap(struct ring *ring, ring_completion *completions, size_t size)
+{
+  (void) ring;
+  (void) completions;
+  (void) size;
+
+  return 0;
+}
+
+void ring_recycle(struct ring *ring, const uint8_t *buffer)
+{
+  (void) ring;
+  (void) buffer;
+}
+
+struct ring *ring_destroy(struct ring *ring)
+{
+  (void) ring;
+  return NULL;
+}
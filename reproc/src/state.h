@@ -0,0 +1,160 @@
+#pragma once
+
+#include <reproc/reproc.h>
+
+#include "handle.h"
+#include "pipe.h"
+#include "process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The internals of `reproc_t` that are shared between reproc.c, drain.c and
+// poller.c (which implements `reproc_poller_t`).
+
+// Each pipe of a process that a poller watches occupies a slot (see
+// `watched_pipe`).
+enum {
+  WATCH_IN,
+  WATCH_OUT,
+  WATCH_ERR,
+  WATCH_EXIT,
+  WATCH_START,
+  WATCH_EXTRA,
+  WATCH_SLOTS = WATCH_EXTRA + REPROC_EXTRA_STREAMS_MAX
+};
+
+struct reproc_t {
+  process_type handle;
+  struct {
+    pipe_type in;
+    pipe_type out;
+    pipe_type err;
+    pipe_type exit;
+    // Reports whether the child process managed to call `exec` if it was
+    // started asynchronously.
+    pipe_type start;
+  } pipe;
+  // The part of the `input` option that didn't fit in the stdin pipe when the
+  // child process was started.
+  struct {
+    const uint8_t *data;
+    size_t size;
+  } input;
+  int status;
+  // Set if an asynchronously started child process failed to call `exec` or if
+  // its exit status couldn't be collected.
+  int error;
+  // Set if the reaper tells us when the child process exits (see reaper.h).
+  bool reaper;
+  // Set if stdin is a socket. We write to it with `pipe_send` so writing to it
+  // after the child process closed its end doesn't raise `SIGPIPE`.
+  bool socket;
+  // Files that stdout and stderr write to if they are redirected to
+  // `REPROC_REDIRECT_MEMFD` and their contents once mapped by
+  // `reproc_capture`.
+  struct {
+    handle_type handle;
+    const uint8_t *data;
+    size_t size;
+  } capture[2];
+  // Parent ends of the first `size` extra streams (see `reproc_extra_stream`).
+  // Bit `i` of `in` is set if we write to `pipe[i]` and bit `i` of `socket` is
+  // set if `pipe[i]` is a socket.
+  struct {
+    pipe_type pipe[REPROC_EXTRA_STREAMS_MAX];
+    size_t size;
+    int in;
+    int socket;
+  } extra;
+  // Capacity of the stdout and stderr pipes if they are `adaptive` (see
+  // `adapt`).
+  struct {
+    size_t size;
+    // Bytes returned by consecutive reads that filled the caller's buffers.
+    size_t streak;
+    bool enabled;
+  } adaptive[2];
+  reproc_stop_actions stop;
+  int64_t deadline;
+  // Set if the process was added to a poller (see `reproc_poller_add`).
+  struct {
+    reproc_poller_t *poller;
+    // Position of the process in `poller->processes`.
+    size_t index;
+    int interests;
+    void *context;
+    // Pipes registered with the poller, by slot.
+    struct {
+      pipe_type pipe;
+      int events;
+    } pipes[WATCH_SLOTS];
+    // Set if the poller watches the self-pipe of the reaper for the process.
+    bool reaped;
+    // Set if the process is in the deadline heap of the poller at position
+    // `heap`.
+    bool timed;
+    size_t heap;
+    // One-based position of the process in the events reported by the ongoing
+    // call to `reproc_poller_wait` or 0 if it hasn't been reported yet.
+    size_t ready;
+    // Write queued by `reproc_poller_write`.
+    struct {
+      const uint8_t *data;
+      size_t size;
+    } write;
+    // One-based positions of the operations submitted to the ring of the
+    // poller for stdin, stdout and stderr, by slot, or 0 if there's none.
+    size_t ops[WATCH_EXIT];
+  } watch;
+};
+
+enum { STATUS_NOT_STARTED = -1, STATUS_IN_PROGRESS = -2, STATUS_IN_CHILD = -3 };
+
+// Returns the parent's end of `stream`, which is either stdout or stderr.
+pipe_type *output_pipe(reproc_t *process, REPROC_STREAM stream);
+
+// Called after every read from an adaptive pipe with the combined size of the
+// buffers that were read into and the result of the read. Doubles the capacity
+// of the pipe once reads keep filling their buffers until twice its capacity
+// has been read since that means the child process writes faster than we read.
+void adapt(reproc_t *process, REPROC_STREAM stream, size_t size, int r);
+
+// Brings the pipes that the poller of `process` watches in line with the pipes
+// and interests of `process`. Has to be called before any of the pipes of
+// `process` are closed, after setting them to `PIPE_INVALID`. Only adding
+// pipes to the poller or submitting operations to its ring can fail. Defined
+// in poller.c.
+int watch(reproc_t *process);
+
+// Closes the parent's end of the pipe of `stream`. If stdin and stdout share a
+// socket (see `REPROC_REDIRECT_SOCKET`), closing one of them only shuts down
+// its direction of the socket until the other one is closed as well.
+void close_stream(reproc_t *process, REPROC_STREAM stream);
+
+// Writes as much of the remaining input to the stdin pipe as it can take
+// without blocking. Returns 1 if input remains to be written. Closes the stdin
+// pipe once all remaining input has been written.
+int write_input(reproc_t *process);
+
+// Reads whether an asynchronously started child process managed to call
+// `exec`. Only blocks if the child process hasn't called `exec` yet.
+void collect_start(reproc_t *process);
+
+// Returns the time in milliseconds until either `timeout` or `deadline` (see
+// `reproc_now`) expires, whichever comes first.
+int expiry(int timeout, int64_t deadline);
+
+// Returns true if a wait of at most `timeout` milliseconds ends when `deadline`
+// expires instead of when `timeout` expires.
+bool expires_first(int timeout, int64_t deadline);
+
+// Returns the time to check deadlines against after a wait that ended when
+// `deadline` expired if `expired` is true. Polling can return slightly before
+// the deadline that ended it, which should still count as expired.
+int64_t expired_at(int64_t deadline, bool expired);
+
+// Returns the remaining time until `end` (see `reproc_now`) or
+// `REPROC_INFINITE` if `end` is `REPROC_INFINITE`.
+int remaining(int64_t end);
@@ -0,0 +1,96 @@
+#include "assert.h"
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+
+#include <errno.h>
+#include <string.h>
+
+static void started(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/async", NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ .async = true });
+  ASSERT(r > 0);
+
+  reproc_event_source source = { process, REPROC_EVENT_START, 0 };
+
+  r = reproc_poll(&source, 1, REPROC_INFINITE);
+  ASSERT(r == 0);
+  ASSERT(source.events == REPROC_EVENT_START);
+
+  // The start event is only reported once.
+  source.interests = REPROC_EVENT_START;
+  r = reproc_poll(&source, 1, 0);
+  ASSERT(r == REPROC_EPIPE);
+
+  char *output = NULL;
+  r = reproc_drain(process, reproc_sink_string(&output), REPROC_SINK_NULL);
+  ASSERT(r == 0);
+  ASSERT(output != NULL);
+  ASSERT(strcmp(output, "async") == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+  reproc_free(output);
+}
+
+static void failed(bool poll)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/non-existent", NULL };
+
+  // The error is only reported once the child process fails to call `exec`.
+  r = reproc_start(process, argv, (reproc_options){ .async = true });
+  ASSERT(r > 0);
+
+  if (poll) {
+    reproc_event_source source = { process, REPROC_EVENT_START, 0 };
+
+    r = reproc_poll(&source, 1, REPROC_INFINITE);
+    ASSERT(r == 0);
+    ASSERT(source.events == (REPROC_EVENT_START | REPROC_EVENT_EXIT));
+  }
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == -ENOENT);
+
+  // The error keeps being reported.
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == -ENOENT);
+
+  reproc_destroy(process);
+}
+
+int main(void)
+{
+  started();
+  failed(true);
+  failed(false);
+
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/async", NULL };
+
+  // Only `REPROC_SPAWN_FORK` starts processes asynchronously.
+  r = reproc_start(process, argv,
+                   (reproc_options){ .async = true,
+                                     .spawn = REPROC_SPAWN_VFORK });
+  ASSERT(r == REPROC_EINVAL);
+
+  reproc_destroy(process);
+}
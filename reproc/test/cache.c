@@ -0,0 +1,170 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "assert.h"
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Runs `program` and returns its output. The caller is responsible for freeing
+// the output with `reproc_free`.
+static char *run(reproc_cache_t *cache,
+                 const char *program,
+                 const char *path,
+                 const char *working_directory,
+                 REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { program, NULL };
+  const char *envp[] = { path, NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .environment = envp,
+                                     .working_directory = working_directory,
+                                     .spawn = spawn,
+                                     .cache = cache });
+  ASSERT(r >= 0);
+
+  char *output = NULL;
+  reproc_sink sink = reproc_sink_string(&output);
+  r = reproc_drain(process, sink, REPROC_SINK_NULL);
+  ASSERT(r == 0);
+  ASSERT(output != NULL);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+
+  return output;
+}
+
+static void lookup(REPROC_SPAWN spawn)
+{
+  reproc_cache_t *cache = reproc_cache_new();
+  int r = -1;
+
+  ASSERT(cache);
+
+  // The second iteration uses the cached location.
+  for (int i = 0; i < 2; i++) {
+    char *output = run(cache, "cache", "PATH=/non-existent:" RESOURCE_DIRECTORY,
+                       NULL, spawn);
+    ASSERT(strcmp(output, "cache") == 0);
+    reproc_free(output);
+  }
+
+  // Relative `PATH` entries are resolved against the working directory of the
+  // child process.
+  for (int i = 0; i < 2; i++) {
+    char *output = run(cache, "cache", "PATH=.", RESOURCE_DIRECTORY, spawn);
+    ASSERT(strcmp(output, "cache") == 0);
+    reproc_free(output);
+  }
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { "non-existent", NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .spawn = spawn, .cache = cache });
+  ASSERT(r == -ENOENT);
+
+  reproc_destroy(process);
+  reproc_cache_destroy(cache);
+}
+
+static void script(const char *directory, const char *name, const char *text)
+{
+  char path[256];
+  char temporary[256];
+  int r = -1;
+
+  snprintf(path, sizeof(path), "%s/%s", directory, name);
+  snprintf(temporary, sizeof(temporary), "%s/%s.tmp", directory, name);
+
+  FILE *file = fopen(temporary, "w");
+  ASSERT(file);
+
+  r = fprintf(file, "#!/bin/sh\nprintf %s\n", text);
+  ASSERT(r > 0);
+
+  r = fclose(file);
+  ASSERT(r == 0);
+
+  r = chmod(temporary, 0700);
+  ASSERT(r == 0);
+
+  // Replace the script atomically like package managers do.
+  r = rename(temporary, path);
+  ASSERT(r == 0);
+}
+
+static void invalidate(REPROC_SPAWN spawn)
+{
+  reproc_cache_t *cache = reproc_cache_new();
+  char first[] = "/tmp/reproc-cache-XXXXXX";
+  char second[] = "/tmp/reproc-cache-XXXXXX";
+  char path[64];
+  char *output = NULL;
+  int r = -1;
+
+  ASSERT(cache);
+  ASSERT(mkdtemp(first) != NULL);
+  ASSERT(mkdtemp(second) != NULL);
+
+  script(first, "program", "one");
+  script(second, "program", "three");
+
+  snprintf(path, sizeof(path), "PATH=%s", first);
+
+  output = run(cache, "program", path, NULL, spawn);
+  ASSERT(strcmp(output, "one") == 0);
+  reproc_free(output);
+
+  script(first, "program", "two");
+
+  output = run(cache, "program", path, NULL, spawn);
+  ASSERT(strcmp(output, "two") == 0);
+  reproc_free(output);
+
+  snprintf(path, sizeof(path), "PATH=%s", second);
+
+  output = run(cache, "program", path, NULL, spawn);
+  ASSERT(strcmp(output, "three") == 0);
+  reproc_free(output);
+
+  reproc_cache_destroy(cache);
+
+  const char *directories[] = { first, second };
+
+  for (size_t i = 0; i < 2; i++) {
+    snprintf(path, sizeof(path), "%s/program", directories[i]);
+
+    r = unlink(path);
+    ASSERT(r == 0);
+
+    r = rmdir(directories[i]);
+    ASSERT(r == 0);
+  }
+}
+
+int main(void)
+{
+  REPROC_SPAWN spawn[] = { REPROC_SPAWN_FORK, REPROC_SPAWN_VFORK };
+
+  for (size_t i = 0; i < sizeof(spawn) / sizeof(spawn[0]); i++) {
+    lookup(spawn[i]);
+    invalidate(spawn[i]);
+  }
+}
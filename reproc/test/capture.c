@@ -0,0 +1,134 @@
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <string.h>
+
+// Larger than the default pipe capacity so the child process would block if
+// its output went to a pipe that nobody reads from.
+#define SIZE "1048576"
+
+static void capture(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/capture", SIZE, NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){
+                       .redirect.out.type = REPROC_REDIRECT_MEMFD,
+                       .redirect.err.type = REPROC_REDIRECT_MEMFD });
+  ASSERT(r >= 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  const uint8_t *data = NULL;
+  size_t size = 0;
+
+  r = reproc_capture(process, REPROC_STREAM_OUT, &data, &size);
+  ASSERT(r == 0);
+
+  ASSERT(size == (size_t) atol(SIZE));
+
+  for (size_t i = 0; i < size; i++) {
+    ASSERT(data[i] == 'a' + i % 26);
+  }
+
+  // Capturing again returns the same mapping.
+  const uint8_t *again = NULL;
+
+  r = reproc_capture(process, REPROC_STREAM_OUT, &again, &size);
+  ASSERT(r == 0);
+  ASSERT(again == data);
+
+  r = reproc_capture(process, REPROC_STREAM_ERR, &data, &size);
+  ASSERT(r == 0);
+
+  ASSERT(size == strlen("capture"));
+  ASSERT(memcmp(data, "capture", size) == 0);
+
+  reproc_destroy(process);
+}
+
+static void empty(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/capture", "0", NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){
+                       .redirect.out.type = REPROC_REDIRECT_MEMFD,
+                       .redirect.err.type = REPROC_REDIRECT_DISCARD });
+  ASSERT(r >= 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  const uint8_t *data = (const uint8_t *) "";
+  size_t size = 1;
+
+  r = reproc_capture(process, REPROC_STREAM_OUT, &data, &size);
+  ASSERT(r == 0);
+
+  ASSERT(data == NULL);
+  ASSERT(size == 0);
+
+  reproc_destroy(process);
+}
+
+static void invalid(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/capture", "0", NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){
+                       .redirect.in.type = REPROC_REDIRECT_MEMFD });
+  ASSERT(r == REPROC_EINVAL);
+
+  const char *wait[] = { RESOURCE_DIRECTORY "/capture", "0", "wait", NULL };
+
+  r = reproc_start(process, wait,
+                   (reproc_options){
+                       .redirect.out.type = REPROC_REDIRECT_MEMFD,
+                       .redirect.err.type = REPROC_REDIRECT_DISCARD });
+  ASSERT(r >= 0);
+
+  const uint8_t *data = NULL;
+  size_t size = 0;
+
+  // The child process waits for stdin to close so it can't have exited yet.
+  r = reproc_capture(process, REPROC_STREAM_OUT, &data, &size);
+  ASSERT(r == REPROC_EINVAL);
+
+  r = reproc_close(process, REPROC_STREAM_IN);
+  ASSERT(r == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  // stderr isn't redirected to a memfd.
+  r = reproc_capture(process, REPROC_STREAM_ERR, &data, &size);
+  ASSERT(r == REPROC_EINVAL);
+
+  reproc_destroy(process);
+}
+
+int main(void)
+{
+  capture();
+  empty();
+  invalid();
+}
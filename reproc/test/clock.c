@@ -0,0 +1,122 @@
+#define _GNU_SOURCE
+
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Seconds that the system time is stepped by.
+static time_t step = 0;
+
+// Overrides `clock_gettime` for the entire test process, reproc included, to
+// simulate the system time being stepped (for example by NTP) without needing
+// the privileges to actually change it.
+int clock_gettime(clockid_t clock, struct timespec *timespec)
+{
+  int r = (int) syscall(SYS_clock_gettime, clock, timespec);
+
+  if (r == 0 && clock == CLOCK_REALTIME) {
+    timespec->tv_sec += step;
+  }
+
+  return r;
+}
+
+static reproc_t *start(int deadline)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/clock", NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ .deadline = deadline });
+  ASSERT(r >= 0);
+
+  return process;
+}
+
+static void stop(reproc_t *process)
+{
+  int r = -1;
+
+  r = reproc_close(process, REPROC_STREAM_IN);
+  ASSERT(r == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+// Stepping the system time forward doesn't make deadlines expire early.
+static void forward(void)
+{
+  int r = -1;
+
+  reproc_t *process = start(60000);
+  step = 3600;
+
+  reproc_event_source source = { process, REPROC_EVENT_OUT, 0 };
+
+  r = reproc_poll(&source, 1, 0);
+  ASSERT(r == REPROC_ETIMEDOUT);
+
+  reproc_poller_t *poller = reproc_poller_new();
+  ASSERT(poller);
+
+  r = reproc_poller_add(poller, process, REPROC_EVENT_OUT, NULL);
+  ASSERT(r == 0);
+
+  reproc_poller_event event = { 0 };
+
+  r = reproc_poller_wait(poller, &event, 1, 0);
+  ASSERT(r == REPROC_ETIMEDOUT);
+
+  reproc_poller_destroy(poller);
+
+  step = 0;
+  stop(process);
+}
+
+// Stepping the system time backward doesn't make deadlines expire late.
+static void backward(void)
+{
+  int r = -1;
+
+  reproc_t *process = start(100);
+  step = -3600;
+
+  reproc_poller_t *poller = reproc_poller_new();
+  ASSERT(poller);
+
+  r = reproc_poller_add(poller, process, REPROC_EVENT_OUT, NULL);
+  ASSERT(r == 0);
+
+  reproc_poller_event event = { 0 };
+
+  r = reproc_poller_wait(poller, &event, 1, 5000);
+  ASSERT(r == 1);
+  ASSERT(event.events == REPROC_EVENT_DEADLINE);
+
+  reproc_poller_destroy(poller);
+
+  reproc_event_source source = { process, REPROC_EVENT_OUT, 0 };
+
+  r = reproc_poll(&source, 1, 5000);
+  ASSERT(r == 0);
+  ASSERT(source.events == REPROC_EVENT_DEADLINE);
+
+  step = 0;
+  stop(process);
+}
+
+int main(void)
+{
+  forward();
+  backward();
+}
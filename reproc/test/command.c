@@ -0,0 +1,61 @@
+#include "assert.h"
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+
+#include <string.h>
+
+int main(void)
+{
+  int r = -1;
+
+  char program[] = RESOURCE_DIRECTORY "/command";
+  char argument[] = "argument";
+  char variable[] = "REPROC=command";
+  char input[] = "input";
+
+  const char *argv[] = { program, argument, NULL };
+  const char *envp[] = { variable, NULL };
+
+  reproc_options options = {
+    .environment = envp,
+    .input = { (const uint8_t *) input, strlen(input) }
+  };
+
+  reproc_command_t *command = reproc_command_new(argv, options);
+  ASSERT(command);
+
+  // The command should have made its own copies.
+  memset(program, 0, sizeof(program));
+  memset(argument, 0, sizeof(argument));
+  memset(variable, 0, sizeof(variable));
+  memset(input, 0, sizeof(input));
+
+  for (int i = 0; i < 3; i++) {
+    reproc_t *process = reproc_new();
+    ASSERT(process);
+
+    r = reproc_command_start(command, process);
+    ASSERT(r >= 0);
+
+    char *output = NULL;
+    reproc_sink sink = reproc_sink_string(&output);
+    r = reproc_drain(process, sink, REPROC_SINK_NULL);
+    ASSERT(r == 0);
+    ASSERT(output != NULL);
+
+    ASSERT(strcmp(output, "argument command input") == 0);
+
+    r = reproc_wait(process, REPROC_INFINITE);
+    ASSERT(r == 0);
+
+    reproc_destroy(process);
+    reproc_free(output);
+  }
+
+  reproc_command_destroy(command);
+
+  // Invalid options are reported when the command is created.
+  command = reproc_command_new(argv, (reproc_options){ .fork = true });
+  ASSERT(command == NULL);
+}
@@ -0,0 +1,144 @@
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <stdio.h>
+#include <string.h>
+
+enum { NUM_PROCESSES = 8 };
+
+int main(void)
+{
+  int r = -1;
+
+  reproc_poller_t *poller = reproc_poller_new();
+  ASSERT(poller);
+
+  reproc_t *processes[NUM_PROCESSES] = { 0 };
+  size_t indices[NUM_PROCESSES] = { 0 };
+  char input[NUM_PROCESSES][16] = { { 0 } };
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    processes[i] = reproc_new();
+    ASSERT(processes[i]);
+
+    char argument[16];
+    snprintf(argument, sizeof(argument), "%u", (unsigned int) i);
+
+    const char *argv[] = { RESOURCE_DIRECTORY "/complete", argument, NULL };
+
+    r = reproc_start(processes[i], argv,
+                     (reproc_options){ .redirect.err.type =
+                                           REPROC_REDIRECT_PIPE });
+    ASSERT(r >= 0);
+
+    indices[i] = i;
+
+    r = reproc_poller_add(poller, processes[i],
+                          REPROC_EVENT_OUT | REPROC_EVENT_ERR |
+                              REPROC_EVENT_EXIT,
+                          &indices[i]);
+    ASSERT(r == 0);
+
+    snprintf(input[i], sizeof(input[i]), "input %u", (unsigned int) i);
+
+    r = reproc_poller_write(poller, processes[i], (uint8_t *) input[i],
+                            strlen(input[i]));
+    ASSERT(r == 0);
+
+    // Only one write can be queued at a time.
+    r = reproc_poller_write(poller, processes[i], (uint8_t *) input[i], 1);
+    ASSERT(r == REPROC_EINVAL);
+  }
+
+  char output[NUM_PROCESSES][16] = { { 0 } };
+  char error[NUM_PROCESSES][16] = { { 0 } };
+  size_t written[NUM_PROCESSES] = { 0 };
+  int status[NUM_PROCESSES] = { 0 };
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    status[i] = -1;
+  }
+
+  // A single completion at a time makes sure completions that don't fit are
+  // reported by the next call.
+  reproc_completion completions[NUM_PROCESSES];
+  size_t num_completions = 1;
+
+  while (true) {
+    r = reproc_poller_complete(poller, completions, num_completions, 5000);
+    if (r == REPROC_EPIPE) {
+      break;
+    }
+
+    ASSERT(r > 0);
+
+    int count = r;
+    num_completions = NUM_PROCESSES;
+
+    for (int i = 0; i < count; i++) {
+      reproc_completion completion = completions[i];
+      size_t index = *(size_t *) completion.context;
+      reproc_t *process = processes[index];
+
+      ASSERT(completion.process == process);
+
+      switch (completion.events) {
+        case REPROC_EVENT_IN:
+          ASSERT(completion.result > 0);
+          written[index] += (size_t) completion.result;
+
+          // Queue the rest if the write was partial, close stdin otherwise.
+          if (written[index] < strlen(input[index])) {
+            r = reproc_poller_write(poller, process,
+                                    (uint8_t *) input[index] + written[index],
+                                    strlen(input[index]) - written[index]);
+            ASSERT(r == 0);
+          } else {
+            r = reproc_close(process, REPROC_STREAM_IN);
+            ASSERT(r == 0);
+          }
+          break;
+        case REPROC_EVENT_OUT:
+        case REPROC_EVENT_ERR: {
+          if (completion.result == REPROC_EPIPE) {
+            break;
+          }
+
+          ASSERT(completion.result > 0);
+          ASSERT(completion.data);
+
+          char *stream = completion.events == REPROC_EVENT_OUT ? output[index]
+                                                               : error[index];
+          size_t size = strlen(stream);
+          ASSERT(size + (size_t) completion.result < 16);
+
+          memcpy(stream + size, completion.data, (size_t) completion.result);
+          break;
+        }
+        case REPROC_EVENT_EXIT:
+          ASSERT(status[index] == -1);
+          status[index] = completion.result;
+          break;
+        default:
+          ASSERT(false);
+      }
+    }
+  }
+
+  r = reproc_poller_wait(poller, (reproc_poller_event[1]){ { 0 } }, 1, 0);
+  ASSERT(r == REPROC_EINVAL);
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    char argument[16];
+    snprintf(argument, sizeof(argument), "%u", (unsigned int) i);
+
+    ASSERT(strcmp(output[i], input[i]) == 0);
+    ASSERT(strcmp(error[i], argument) == 0);
+    ASSERT(status[i] == (int) i);
+
+    reproc_destroy(processes[i]);
+  }
+
+  reproc_poller_destroy(poller);
+}
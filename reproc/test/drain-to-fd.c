@@ -0,0 +1,109 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "assert.h"
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SIZE "1000000"
+
+static void verify(int fd, size_t size)
+{
+  int r = -1;
+
+  r = (int) lseek(fd, 0, SEEK_SET);
+  ASSERT(r == 0);
+
+  uint8_t buffer[4096];
+  size_t total = 0;
+
+  while ((r = (int) read(fd, buffer, sizeof(buffer))) > 0) {
+    for (int i = 0; i < r; i++) {
+      ASSERT(buffer[i] == (total + (size_t) i) % 251);
+    }
+
+    total += (size_t) r;
+  }
+
+  ASSERT(total == size);
+}
+
+static void drain(int flags)
+{
+  int r = -1;
+
+  char out[] = "reproc-drain-to-fd-XXXXXX";
+  int fd = mkstemp(out);
+  ASSERT(fd >= 0);
+
+  r = unlink(out);
+  ASSERT(r == 0);
+
+  // Files opened with `O_APPEND` can't be spliced to.
+  r = fcntl(fd, F_SETFL, flags);
+  ASSERT(r == 0);
+
+  int err[2] = { -1, -1 };
+  r = pipe(err);
+  ASSERT(r == 0);
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/drain-to-fd", SIZE, NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .redirect.err.type =
+                                         REPROC_REDIRECT_PIPE });
+  ASSERT(r >= 0);
+
+  r = reproc_drain_to_fd(process, fd, err[1]);
+  ASSERT(r == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+
+  verify(fd, (size_t) atol(SIZE));
+
+  char message[16] = { 0 };
+  r = (int) read(err[0], message, sizeof(message) - 1);
+  ASSERT(r == (int) strlen("stderr"));
+  ASSERT(strcmp(message, "stderr") == 0);
+
+  close(err[0]);
+  close(err[1]);
+  close(fd);
+}
+
+static void deadline(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/drain-to-fd", NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ .deadline = 50 });
+  ASSERT(r >= 0);
+
+  r = reproc_drain_to_fd(process, STDOUT_FILENO, STDERR_FILENO);
+  ASSERT(r == REPROC_ETIMEDOUT);
+
+  reproc_destroy(process);
+}
+
+int main(void)
+{
+  drain(0);
+  drain(O_APPEND);
+  deadline();
+}
@@ -0,0 +1,227 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MESSAGE "reproc stands for REdirected PROCess"
+
+static void read_all(reproc_t *process,
+                     REPROC_STREAM stream,
+                     char *output,
+                     size_t size)
+{
+  int r = -1;
+  size_t total = 0;
+
+  memset(output, 0, size);
+
+  while (true) {
+    r = reproc_read(process, stream, (uint8_t *) output + total,
+                    size - 1 - total);
+    if (r == REPROC_EPIPE) {
+      break;
+    }
+
+    ASSERT(r > 0);
+    total += (size_t) r;
+  }
+}
+
+// Sends `MESSAGE` to the child process over fd 3 and reads it back from fd 4
+// while its logs go to stdout.
+static void copy(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/extra-streams", "copy", "3", "4",
+                         NULL };
+
+  reproc_extra_stream extra[] = { { .fd = 3, .input = true },
+                                  { .fd = 4, .input = false } };
+
+  reproc_options options = { 0 };
+  options.spawn = spawn;
+  options.extra_streams = extra;
+  options.num_extra_streams = 2;
+
+  r = reproc_start(process, argv, options);
+  ASSERT(r >= 0);
+
+  reproc_event_source source = { process, REPROC_EVENT_EXTRA(0), 0 };
+
+  r = reproc_poll(&source, 1, REPROC_INFINITE);
+  ASSERT(r == 0);
+  ASSERT(source.events == REPROC_EVENT_EXTRA(0));
+
+  r = reproc_write_to(process, REPROC_STREAM_EXTRA(0),
+                      (const uint8_t *) MESSAGE, strlen(MESSAGE));
+  ASSERT(r == (int) strlen(MESSAGE));
+
+  r = reproc_close(process, REPROC_STREAM_EXTRA(0));
+  ASSERT(r == 0);
+
+  source = (reproc_event_source){ process, REPROC_EVENT_EXTRA(1), 0 };
+
+  r = reproc_poll(&source, 1, REPROC_INFINITE);
+  ASSERT(r == 0);
+  ASSERT(source.events == REPROC_EVENT_EXTRA(1));
+
+  char output[sizeof(MESSAGE)];
+
+  read_all(process, REPROC_STREAM_EXTRA(1), output, sizeof(output));
+  ASSERT(strcmp(output, MESSAGE) == 0);
+
+  read_all(process, REPROC_STREAM_OUT, output, sizeof(output));
+  ASSERT(strcmp(output, "log") == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+// Redirects two extra streams to the file descriptors that their handles
+// occupy in the parent process in reverse order, which only works if the child
+// process moves them out of each other's way.
+static void swap(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  int a[2] = { -1, -1 };
+  int b[2] = { -1, -1 };
+
+  r = pipe(a);
+  ASSERT(r == 0);
+
+  r = pipe(b);
+  ASSERT(r == 0);
+
+  char fd_a[16];
+  char fd_b[16];
+  snprintf(fd_a, sizeof(fd_a), "%d", a[1]);
+  snprintf(fd_b, sizeof(fd_b), "%d", b[1]);
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/extra-streams",
+                         "write",
+                         fd_a,
+                         "a",
+                         fd_b,
+                         "b",
+                         NULL };
+
+  reproc_extra_stream extra[] = {
+    { .fd = b[1], .redirect = { .handle = a[1] } },
+    { .fd = a[1], .redirect = { .handle = b[1] } }
+  };
+
+  reproc_options options = { 0 };
+  options.spawn = spawn;
+  options.redirect.out.type = REPROC_REDIRECT_DISCARD;
+  options.extra_streams = extra;
+  options.num_extra_streams = 2;
+
+  r = reproc_start(process, argv, options);
+  ASSERT(r >= 0);
+
+  close(a[1]);
+  close(b[1]);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  char output[2] = { 0 };
+
+  r = (int) read(a[0], output, 1);
+  ASSERT(r == 1);
+  ASSERT(output[0] == 'b');
+
+  r = (int) read(b[0], output, 1);
+  ASSERT(r == 1);
+  ASSERT(output[0] == 'a');
+
+  close(a[0]);
+  close(b[0]);
+
+  reproc_destroy(process);
+}
+
+static void invalid(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/extra-streams", "copy", "3", "4",
+                         NULL };
+
+  reproc_extra_stream extra[] = { { .fd = 3, .input = true },
+                                  { .fd = 4, .input = false } };
+
+  reproc_options options = { 0 };
+  options.extra_streams = extra;
+  options.num_extra_streams = 2;
+
+  extra[0].fd = 2;
+  r = reproc_start(process, argv, options);
+  ASSERT(r == REPROC_EINVAL);
+
+  extra[0].fd = 4;
+  r = reproc_start(process, argv, options);
+  ASSERT(r == REPROC_EINVAL);
+
+  extra[0].fd = 3;
+  extra[1].redirect.adaptive = true;
+  r = reproc_start(process, argv, options);
+  ASSERT(r == REPROC_EINVAL);
+
+  extra[1].redirect.adaptive = false;
+  options.num_extra_streams = REPROC_EXTRA_STREAMS_MAX + 1;
+  r = reproc_start(process, argv, options);
+  ASSERT(r == REPROC_EINVAL);
+
+  options.num_extra_streams = 2;
+  r = reproc_start(process, argv, options);
+  ASSERT(r >= 0);
+
+  uint8_t buffer[1] = { 0 };
+
+  // Streams can only be used in their direction.
+  r = reproc_read(process, REPROC_STREAM_EXTRA(0), buffer, sizeof(buffer));
+  ASSERT(r == REPROC_EINVAL);
+
+  r = reproc_write_to(process, REPROC_STREAM_EXTRA(1), buffer, sizeof(buffer));
+  ASSERT(r == REPROC_EINVAL);
+
+  r = reproc_close(process, REPROC_STREAM_EXTRA(2));
+  ASSERT(r == REPROC_EINVAL);
+
+  r = reproc_close(process, REPROC_STREAM_EXTRA(0));
+  ASSERT(r == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+int main(void)
+{
+  copy(REPROC_SPAWN_FORK);
+  copy(REPROC_SPAWN_VFORK);
+  copy(REPROC_SPAWN_HELPER);
+  swap(REPROC_SPAWN_FORK);
+  swap(REPROC_SPAWN_VFORK);
+  invalid();
+}
@@ -0,0 +1,81 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "assert.h"
+
+#include <poll.h>
+
+#include <reproc/reproc.h>
+
+int main(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/handle", NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .redirect.err.type =
+                                         REPROC_REDIRECT_DISCARD,
+                                     .nonblocking = true });
+  ASSERT(r >= 0);
+
+  reproc_handle out = -1;
+  r = reproc_handle_of(process, REPROC_STREAM_OUT, &out);
+  ASSERT(r == 0);
+
+  reproc_handle exited = -1;
+  r = reproc_handle_of(process, REPROC_STREAM_EXIT, &exited);
+  ASSERT(r == 0);
+  ASSERT(exited != out);
+
+  // stderr is discarded and the exit handle isn't a stream.
+  reproc_handle handle = -1;
+  r = reproc_handle_of(process, REPROC_STREAM_ERR, &handle);
+  ASSERT(r == REPROC_EPIPE);
+
+  uint8_t buffer[4096];
+  r = reproc_read(process, REPROC_STREAM_EXIT, buffer, sizeof(buffer));
+  ASSERT(r == REPROC_EINVAL);
+
+  size_t size = 0;
+  struct pollfd fds[] = { { .fd = out, .events = POLLIN },
+                          { .fd = exited, .events = POLLIN } };
+
+  while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+    r = poll(fds, 2, 5000);
+    ASSERT(r > 0);
+
+    if (fds[0].revents) {
+      // Drain the pipe like an edge-triggered event loop would.
+      while ((r = reproc_read(process, REPROC_STREAM_OUT, buffer,
+                              sizeof(buffer))) > 0) {
+        size += (size_t) r;
+      }
+
+      ASSERT(r == REPROC_EWOULDBLOCK || r == REPROC_EPIPE);
+
+      if (r == REPROC_EPIPE) {
+        // `reproc_read` closed stdout when it reached the end of the output.
+        fds[0].fd = -1;
+        r = reproc_handle_of(process, REPROC_STREAM_OUT, &handle);
+        ASSERT(r == REPROC_EPIPE);
+      }
+    }
+
+    if (fds[1].revents) {
+      fds[1].fd = -1;
+    }
+  }
+
+  ASSERT(size == 1 << 20);
+
+  r = reproc_wait(process, 0);
+  ASSERT(r == 0);
+
+  r = reproc_handle_of(process, REPROC_STREAM_EXIT, &handle);
+  ASSERT(r == REPROC_EPIPE);
+
+  reproc_destroy(process);
+}
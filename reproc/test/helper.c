@@ -0,0 +1,195 @@
+#define _POSIX_C_SOURCE 200809L
+
+#if defined(__linux__)
+  // `prlimit`
+  #define _GNU_SOURCE
+#endif
+
+#include "assert.h"
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static const reproc_options options = { .spawn = REPROC_SPAWN_HELPER };
+
+static char *run(const char *const *argv, reproc_options options)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  r = reproc_start(process, argv, options);
+  ASSERT(r >= 0);
+
+  char *output = NULL;
+  reproc_sink sink = reproc_sink_string(&output);
+  r = reproc_drain(process, sink, REPROC_SINK_NULL);
+  ASSERT(r == 0);
+  ASSERT(output != NULL);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+
+  return output;
+}
+
+static void parent(void)
+{
+  int r = -1;
+
+  // Child processes started by the helper should be our children.
+  const char *argv[] = { RESOURCE_DIRECTORY "/helper", "ppid", NULL };
+  char *output = run(argv, options);
+
+  r = (int) strtol(output, NULL, 10);
+  ASSERT(r == (int) getpid());
+
+  reproc_free(output);
+}
+
+static void setup(void)
+{
+  int r = -1;
+
+  // The helper was started in a different working directory so this checks
+  // that `program` and `working_directory` are resolved against ours.
+  r = chdir(RESOURCE_DIRECTORY);
+  ASSERT(r == 0);
+
+  const char *argv[] = { "./helper", NULL };
+  const char *envp[] = { "REPROC=helper", NULL };
+
+  reproc_options copy = options;
+  copy.environment = envp;
+  copy.working_directory = ".";
+
+  char *output = run(argv, copy);
+  ASSERT(strcmp(output, RESOURCE_DIRECTORY "helper") == 0);
+  reproc_free(output);
+
+  // When no environment is given, the child process should see the current
+  // environment of the parent process, not the helper's.
+  r = setenv("REPROC", "current", 1);
+  ASSERT(r == 0);
+
+  output = run(argv, options);
+  ASSERT(strcmp(output, RESOURCE_DIRECTORY "current") == 0);
+  reproc_free(output);
+
+  r = unsetenv("REPROC");
+  ASSERT(r == 0);
+}
+
+static void error(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/non-existent", NULL };
+
+  r = reproc_start(process, argv, options);
+  ASSERT(r == -ENOENT);
+
+  reproc_destroy(process);
+}
+
+static void terminate(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/helper", "block", NULL };
+
+  r = reproc_start(process, argv, options);
+  ASSERT(r >= 0);
+
+  r = reproc_terminate(process);
+  ASSERT(r == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == REPROC_SIGTERM);
+
+  reproc_destroy(process);
+}
+
+static void truncated(void)
+{
+#if defined(__linux__)
+  int r = -1;
+
+  r = reproc_helper_start();
+  ASSERT(r == 0);
+
+  // The helper is our only child process at this point.
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/task/%d/children", (int) getpid());
+
+  FILE *children = fopen(path, "r");
+  if (children == NULL) {
+    return;
+  }
+
+  int helper = 0;
+  r = fscanf(children, "%d", &helper);
+  fclose(children);
+  ASSERT(r == 1);
+
+  // With a low file descriptor limit, the helper can't receive the pipes of the
+  // child process. It should report that instead of exiting.
+  struct rlimit limit = { .rlim_cur = 5, .rlim_max = 5 };
+  r = prlimit(helper, RLIMIT_NOFILE, &limit, NULL);
+  ASSERT(r == 0);
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/helper", "ppid", NULL };
+
+  for (int i = 0; i < 2; i++) {
+    r = reproc_start(process, argv, options);
+    ASSERT(r == -EMFILE);
+  }
+
+  reproc_destroy(process);
+
+  r = reproc_helper_stop();
+  ASSERT(r == 0);
+#endif
+}
+
+int main(void)
+{
+  int r = -1;
+
+  r = reproc_helper_start();
+  ASSERT(r == 0);
+
+  parent();
+  setup();
+  error();
+  terminate();
+
+  r = reproc_helper_stop();
+  ASSERT(r == 0);
+
+  // Without the helper, child processes are started directly but should still
+  // be our children.
+  parent();
+  error();
+
+  truncated();
+}
@@ -0,0 +1,55 @@
+#include "assert.h"
+
+#include <reproc/run.h>
+
+#include <stdlib.h>
+
+// Much bigger than the default size of a pipe so most of the input has to be
+// written while the child process runs.
+#define SIZE (4 * 1024 * 1024)
+
+static int sink(REPROC_STREAM stream,
+                const uint8_t *buffer,
+                size_t size,
+                void *context)
+{
+  (void) stream;
+
+  size_t *received = (size_t *) context;
+
+  for (size_t i = 0; i < size; i++) {
+    if (buffer[i] != 'a' + (*received + i) % 26) {
+      return -1;
+    }
+  }
+
+  *received += size;
+
+  return 0;
+}
+
+int main(void)
+{
+  int r = -1;
+
+  uint8_t *input = malloc(SIZE);
+  ASSERT(input);
+
+  for (size_t i = 0; i < SIZE; i++) {
+    input[i] = (uint8_t) ('a' + i % 26);
+  }
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/input", NULL };
+  size_t received = 0;
+
+  // The child process writes its input back to stdout while reading it so this
+  // only finishes if `reproc_drain` reads stdout while writing the input.
+  r = reproc_run_ex(argv,
+                    (reproc_options){ .input = { input, SIZE },
+                                      .deadline = 10000 },
+                    (reproc_sink){ sink, &received }, REPROC_SINK_NULL);
+  ASSERT(r == 0);
+  ASSERT(received == SIZE);
+
+  free(input);
+}
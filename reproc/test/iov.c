@@ -0,0 +1,74 @@
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <string.h>
+
+#define HEAD "reproc stands for "
+#define BODY "REdirected "
+#define TAIL "PROCess"
+#define MESSAGE HEAD BODY TAIL
+
+int main(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/iov", NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ 0 });
+  ASSERT(r >= 0);
+
+  reproc_iovec in[] = { { (uint8_t *) HEAD, strlen(HEAD) },
+                        { NULL, 0 },
+                        { (uint8_t *) BODY, strlen(BODY) },
+                        { (uint8_t *) TAIL, strlen(TAIL) } };
+
+  r = reproc_writev(process, in, sizeof(in) / sizeof(in[0]));
+  ASSERT(r == (int) strlen(MESSAGE));
+
+  r = reproc_close(process, REPROC_STREAM_IN);
+  ASSERT(r == 0);
+
+  r = reproc_writev(process, in, sizeof(in) / sizeof(in[0]));
+  ASSERT(r == REPROC_EPIPE);
+
+  // Read into buffers that are too small to hold the full message to make sure
+  // each read fills them in order.
+  char output[sizeof(MESSAGE)] = { 0 };
+  size_t size = 0;
+
+  while (true) {
+    char first[5] = { 0 };
+    char second[3] = { 0 };
+    reproc_iovec out[] = { { (uint8_t *) first, sizeof(first) },
+                           { (uint8_t *) second, sizeof(second) } };
+
+    r = reproc_readv(process, REPROC_STREAM_OUT, out, 2);
+    if (r == REPROC_EPIPE) {
+      break;
+    }
+
+    ASSERT(r > 0);
+    ASSERT(size + (size_t) r < sizeof(output));
+
+    size_t from_first = (size_t) r < sizeof(first) ? (size_t) r : sizeof(first);
+    memcpy(output + size, first, from_first);
+    memcpy(output + size + from_first, second, (size_t) r - from_first);
+    size += (size_t) r;
+  }
+
+  ASSERT(size == strlen(MESSAGE));
+  ASSERT(strcmp(output, MESSAGE) == 0);
+
+  reproc_iovec out = { (uint8_t *) output, sizeof(output) };
+  r = reproc_readv(process, REPROC_STREAM_OUT, &out, 1);
+  ASSERT(r == REPROC_EPIPE);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
@@ -0,0 +1,158 @@
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+#define SIZE "4194304"
+
+enum { NUM_CHILDREN = 4 };
+
+static void memfd_close(reproc_handle memfd)
+{
+#if defined(_WIN32)
+  CloseHandle(memfd);
+#else
+  close(memfd);
+#endif
+}
+
+static uint8_t *generate(size_t size)
+{
+  int r = -1;
+
+  uint8_t *input = malloc(size);
+  ASSERT(input);
+
+  for (size_t i = 0; i < size; i++) {
+    input[i] = (uint8_t) ('a' + i % 26);
+  }
+
+  return input;
+}
+
+static void input(void)
+{
+  int r = -1;
+
+  size_t size = (size_t) atol(SIZE);
+  uint8_t *input = generate(size);
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/memfd-input", SIZE, NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){
+                       .redirect.in.type = REPROC_REDIRECT_MEMFD,
+                       .input = { input, size } });
+  ASSERT(r >= 0);
+
+  // The input has been copied so we don't have to keep it around.
+  free(input);
+
+  // stdin isn't a pipe.
+  r = reproc_write(process, (const uint8_t *) "a", 1);
+  ASSERT(r == REPROC_EPIPE);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+static void fan_out(void)
+{
+  int r = -1;
+
+  size_t size = (size_t) atol(SIZE);
+  uint8_t *input = generate(size);
+
+  reproc_handle memfd = { 0 };
+
+  r = reproc_memfd_new(input, size, &memfd);
+  ASSERT(r == 0);
+
+  free(input);
+
+  reproc_t *children[NUM_CHILDREN] = { 0 };
+  const char *argv[] = { RESOURCE_DIRECTORY "/memfd-input", SIZE, NULL };
+
+  for (size_t i = 0; i < NUM_CHILDREN; i++) {
+    children[i] = reproc_new();
+    ASSERT(children[i]);
+
+    r = reproc_start(children[i], argv,
+                     (reproc_options){
+                         .redirect.in = { .type = REPROC_REDIRECT_MEMFD,
+                                          .handle = memfd } });
+    ASSERT(r >= 0);
+  }
+
+  // Every child process reads the full input, even though they all run at the
+  // same time.
+  for (size_t i = 0; i < NUM_CHILDREN; i++) {
+    r = reproc_wait(children[i], REPROC_INFINITE);
+    ASSERT(r == 0);
+
+    reproc_destroy(children[i]);
+  }
+
+  memfd_close(memfd);
+}
+
+static void invalid(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/memfd-input", "1", NULL };
+  reproc_handle memfd = { 0 };
+
+  r = reproc_memfd_new((const uint8_t *) "a", 1, &memfd);
+  ASSERT(r == 0);
+
+  // Both `input` and a memfd.
+  r = reproc_start(process, argv,
+                   (reproc_options){
+                       .redirect.in = { .type = REPROC_REDIRECT_MEMFD,
+                                        .handle = memfd },
+                       .input = { (const uint8_t *) "a", 1 } });
+  ASSERT(r == REPROC_EINVAL);
+
+  // Only stdin accepts an existing memfd.
+  r = reproc_start(process, argv,
+                   (reproc_options){
+                       .redirect.out = { .type = REPROC_REDIRECT_MEMFD,
+                                         .handle = memfd } });
+  ASSERT(r == REPROC_EINVAL);
+
+  r = reproc_start(process, argv,
+                   (reproc_options){
+                       .redirect.in = { .type = REPROC_REDIRECT_MEMFD,
+                                        .handle = memfd } });
+  ASSERT(r >= 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+
+  memfd_close(memfd);
+}
+
+int main(void)
+{
+  input();
+  fan_out();
+  invalid();
+}
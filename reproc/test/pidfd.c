@@ -0,0 +1,42 @@
+#define _GNU_SOURCE
+
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if !defined(SYS_pidfd_open)
+  #define SYS_pidfd_open 434
+#endif
+
+int main(void)
+{
+  int r = -1;
+
+  // Without pidfds (Linux 5.3+), reproc falls back to an exit pipe which the
+  // grandchild process inherits.
+  r = (int) syscall(SYS_pidfd_open, getpid(), 0);
+  if (r < 0) {
+    return 0;
+  }
+
+  close(r);
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/pidfd", NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .redirect.discard = true });
+  ASSERT(r >= 0);
+
+  // The grandchild process doesn't inherit anything that keeps us from noticing
+  // that the child process exited.
+  r = reproc_wait(process, 1000);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
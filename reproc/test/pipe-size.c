@@ -0,0 +1,129 @@
+#include "assert.h"
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+
+#define SIZE "16777216"
+
+static void fixed(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/pipe-size", "0", NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .redirect.in.pipe_size = 1 << 12,
+                                     .redirect.out.pipe_size = 1 << 18,
+                                     .redirect.err.pipe_size = 1 << 13 });
+  ASSERT(r >= 0);
+
+  r = reproc_pipe_size(process, REPROC_STREAM_IN);
+  ASSERT(r == 1 << 12);
+
+  r = reproc_pipe_size(process, REPROC_STREAM_OUT);
+  ASSERT(r == 1 << 18);
+
+  // Setting `pipe_size` redirects stderr to a pipe instead of the parent.
+  r = reproc_pipe_size(process, REPROC_STREAM_ERR);
+  ASSERT(r == 1 << 13);
+
+  r = reproc_close(process, REPROC_STREAM_OUT);
+  ASSERT(r == 0);
+
+  r = reproc_pipe_size(process, REPROC_STREAM_OUT);
+  ASSERT(r == REPROC_EPIPE);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+typedef struct {
+  reproc_t *process;
+  int size;
+} largest;
+
+static int sink_largest(REPROC_STREAM stream,
+                        const uint8_t *buffer,
+                        size_t size,
+                        void *context)
+{
+  (void) buffer;
+
+  largest *l = context;
+
+  if (stream != REPROC_STREAM_OUT || size == 0) {
+    return 0;
+  }
+
+  int r = reproc_pipe_size(l->process, REPROC_STREAM_OUT);
+  ASSERT(r > 0);
+
+  l->size = r > l->size ? r : l->size;
+
+  return 0;
+}
+
+static void adaptive(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/pipe-size", SIZE, NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .redirect.out.adaptive = true });
+  ASSERT(r >= 0);
+
+  int initial = reproc_pipe_size(process, REPROC_STREAM_OUT);
+  ASSERT(initial > 0);
+
+  largest l = { process, initial };
+  reproc_sink sink = { sink_largest, &l };
+
+  r = reproc_drain(process, sink, REPROC_SINK_NULL);
+  ASSERT(r == 0);
+
+  ASSERT(l.size > initial);
+  ASSERT(l.size <= 1 << 20);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+static void invalid(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/pipe-size", "0", NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .redirect.out.type =
+                                         REPROC_REDIRECT_DISCARD,
+                                     .redirect.out.pipe_size = 1 << 16 });
+  ASSERT(r == REPROC_EINVAL);
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .redirect.in.adaptive = true });
+  ASSERT(r == REPROC_EINVAL);
+
+  reproc_destroy(process);
+}
+
+int main(void)
+{
+  fixed();
+  adaptive();
+  invalid();
+}
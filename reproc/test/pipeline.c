@@ -0,0 +1,109 @@
+#include "assert.h"
+
+#include <reproc/drain.h>
+#include <reproc/pipeline.h>
+
+#include <string.h>
+
+#define MESSAGE "reproc stands for REdirected PROCess"
+#define NUM_STAGES 3
+
+static void pipeline(const char *last)
+{
+  int r = -1;
+
+  reproc_t *stages[NUM_STAGES] = { 0 };
+
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    stages[i] = reproc_new();
+    ASSERT(stages[i]);
+  }
+
+  const char *upper[] = { RESOURCE_DIRECTORY "/pipeline", NULL };
+  const char *end[] = { RESOURCE_DIRECTORY "/pipeline", last, NULL };
+  const char *const *argvs[NUM_STAGES] = { upper, upper, end };
+
+  r = reproc_pipeline_start(stages, argvs, NUM_STAGES,
+                            (reproc_options){
+                                .input = { (uint8_t *) MESSAGE,
+                                           strlen(MESSAGE) } });
+  ASSERT(r == 0);
+
+  char *out = NULL;
+  r = reproc_drain(stages[NUM_STAGES - 1], reproc_sink_string(&out),
+                   REPROC_SINK_NULL);
+  ASSERT(r == 0);
+  ASSERT(out != NULL);
+
+  int statuses[NUM_STAGES] = { 0 };
+  r = reproc_pipeline_wait(stages, NUM_STAGES, REPROC_INFINITE, statuses);
+
+  int length = (int) strlen(MESSAGE);
+
+  if (last == NULL) {
+    ASSERT(strcmp(out, "REPROC STANDS FOR REDIRECTED PROCESS") == 0);
+  } else {
+    ASSERT(strlen(out) == 0);
+  }
+
+  // Every stage exits with the amount of bytes it read.
+  ASSERT(r == length);
+
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    ASSERT(statuses[i] == length);
+  }
+
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    reproc_destroy(stages[i]);
+  }
+
+  reproc_free(out);
+}
+
+static void stop(void)
+{
+  int r = -1;
+
+  reproc_t *stages[NUM_STAGES] = { 0 };
+
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    stages[i] = reproc_new();
+    ASSERT(stages[i]);
+  }
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/pipeline", NULL };
+  const char *const *argvs[NUM_STAGES] = { argv, argv, argv };
+
+  r = reproc_pipeline_start(stages, argvs, NUM_STAGES, (reproc_options){ 0 });
+  ASSERT(r == 0);
+
+  // The first stage waits for us to close its stdin.
+  int statuses[NUM_STAGES] = { 0 };
+  r = reproc_pipeline_wait(stages, NUM_STAGES, 50, statuses);
+  ASSERT(r == REPROC_ETIMEDOUT);
+
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    ASSERT(statuses[i] == REPROC_ETIMEDOUT);
+  }
+
+  reproc_stop_actions stop = { { REPROC_STOP_KILL, REPROC_INFINITE },
+                               { REPROC_STOP_NOOP, 0 },
+                               { REPROC_STOP_NOOP, 0 } };
+
+  r = reproc_pipeline_stop(stages, NUM_STAGES, stop, statuses);
+  ASSERT(r >= 0);
+
+  // The other stages might see the end of their input before they're killed.
+  ASSERT(statuses[0] == REPROC_SIGKILL);
+
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    reproc_destroy(stages[i]);
+  }
+}
+
+int main(void)
+{
+  pipeline(NULL);
+  pipeline("count");
+  stop();
+}
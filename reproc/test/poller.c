@@ -0,0 +1,315 @@
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <stdio.h>
+#include <string.h>
+
+enum { NUM_PROCESSES = 8 };
+
+static reproc_t *start(size_t index, int deadline)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  char argument[16];
+  snprintf(argument, sizeof(argument), "%u", (unsigned int) index);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/poller", argument, NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ .deadline = deadline });
+  ASSERT(r >= 0);
+
+  return process;
+}
+
+// Reads the output of the processes that the poller reports until all of
+// `expected` have closed stdout. Only processes in `expected` may be reported.
+static void drain(reproc_poller_t *poller,
+                  reproc_t **processes,
+                  const bool *expected)
+{
+  int r = -1;
+
+  char output[NUM_PROCESSES][16] = { { 0 } };
+  size_t remaining = 0;
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    remaining += expected[i];
+  }
+
+  while (remaining > 0) {
+    reproc_poller_event events[NUM_PROCESSES];
+
+    r = reproc_poller_wait(poller, events, NUM_PROCESSES, 5000);
+    ASSERT(r > 0);
+
+    int count = r;
+
+    for (int i = 0; i < count; i++) {
+      size_t index = *(size_t *) events[i].context;
+
+      ASSERT(expected[index]);
+      ASSERT(events[i].process == processes[index]);
+      ASSERT(events[i].events == REPROC_EVENT_OUT);
+
+      size_t size = strlen(output[index]);
+
+      r = reproc_read(processes[index], REPROC_STREAM_OUT,
+                      (uint8_t *) output[index] + size,
+                      sizeof(output[index]) - 1 - size);
+      if (r == REPROC_EPIPE) {
+        remaining--;
+        continue;
+      }
+
+      ASSERT(r > 0);
+    }
+  }
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    if (!expected[i]) {
+      continue;
+    }
+
+    char argument[16];
+    snprintf(argument, sizeof(argument), "%u", (unsigned int) i);
+
+    ASSERT(strcmp(output[i], argument) == 0);
+  }
+}
+
+static void ready(void)
+{
+  int r = -1;
+
+  reproc_poller_t *poller = reproc_poller_new();
+  ASSERT(poller);
+
+  reproc_t *processes[NUM_PROCESSES] = { 0 };
+  size_t indices[NUM_PROCESSES] = { 0 };
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    processes[i] = start(i, 0);
+    indices[i] = i;
+
+    r = reproc_poller_add(poller, processes[i], REPROC_EVENT_OUT, &indices[i]);
+    ASSERT(r == 0);
+  }
+
+  r = reproc_poller_add(poller, processes[0], REPROC_EVENT_OUT, NULL);
+  ASSERT(r == REPROC_EINVAL);
+
+  // Only the processes whose stdin is closed write to stdout.
+  bool odd[NUM_PROCESSES] = { 0 };
+
+  for (size_t i = 1; i < NUM_PROCESSES; i += 2) {
+    r = reproc_close(processes[i], REPROC_STREAM_IN);
+    ASSERT(r == 0);
+
+    odd[i] = true;
+  }
+
+  drain(poller, processes, odd);
+
+  r = reproc_poller_wait(poller, (reproc_poller_event[1]){ { 0 } }, 1, 50);
+  ASSERT(r == REPROC_ETIMEDOUT);
+
+  // Removing a process moves another one into its place in the poller.
+  r = reproc_poller_remove(poller, processes[0]);
+  ASSERT(r == 0);
+
+  r = reproc_poller_remove(poller, processes[0]);
+  ASSERT(r == REPROC_EINVAL);
+
+  bool even[NUM_PROCESSES] = { 0 };
+
+  for (size_t i = 0; i < NUM_PROCESSES; i += 2) {
+    r = reproc_close(processes[i], REPROC_STREAM_IN);
+    ASSERT(r == 0);
+
+    even[i] = i != 0;
+  }
+
+  drain(poller, processes, even);
+
+  r = reproc_poller_wait(poller, (reproc_poller_event[1]){ { 0 } }, 1, 50);
+  ASSERT(r == REPROC_EPIPE);
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    r = reproc_wait(processes[i], REPROC_INFINITE);
+    ASSERT(r == 0);
+
+    reproc_destroy(processes[i]);
+  }
+
+  reproc_poller_destroy(poller);
+}
+
+static void exited(void)
+{
+  int r = -1;
+
+  reproc_poller_t *poller = reproc_poller_new();
+  ASSERT(poller);
+
+  reproc_t *process = start(0, 0);
+
+  r = reproc_poller_add(poller, process, REPROC_EVENT_IN, NULL);
+  ASSERT(r == 0);
+
+  reproc_poller_event event = { 0 };
+
+  r = reproc_poller_wait(poller, &event, 1, 5000);
+  ASSERT(r == 1);
+  ASSERT(event.process == process);
+  ASSERT(event.events == REPROC_EVENT_IN);
+
+  r = reproc_poller_modify(poller, process, REPROC_EVENT_EXIT);
+  ASSERT(r == 0);
+
+  r = reproc_poller_wait(poller, &event, 1, 50);
+  ASSERT(r == REPROC_ETIMEDOUT);
+
+  r = reproc_close(process, REPROC_STREAM_IN);
+  ASSERT(r == 0);
+
+  r = reproc_poller_wait(poller, &event, 1, 5000);
+  ASSERT(r == 1);
+  ASSERT(event.events == REPROC_EVENT_EXIT);
+
+  r = reproc_wait(process, 0);
+  ASSERT(r == 0);
+
+  r = reproc_poller_wait(poller, &event, 1, 0);
+  ASSERT(r == REPROC_EPIPE);
+
+  // Processes are removed from their poller when they're destroyed.
+  reproc_destroy(process);
+
+  process = start(1, 0);
+
+  r = reproc_poller_add(poller, process, REPROC_EVENT_OUT, NULL);
+  ASSERT(r == 0);
+
+  reproc_poller_destroy(poller);
+
+  r = reproc_close(process, REPROC_STREAM_IN);
+  ASSERT(r == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+static void deadlines(void)
+{
+  int r = -1;
+
+  reproc_poller_t *poller = reproc_poller_new();
+  ASSERT(poller);
+
+  reproc_t *processes[NUM_PROCESSES] = { 0 };
+  size_t indices[NUM_PROCESSES] = { 0 };
+  reproc_event_source sources[NUM_PROCESSES];
+
+  // Only the deadlines of the even processes expire during the test.
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    processes[i] = start(i, i % 2 == 0 ? 50 : 60000);
+    indices[i] = i;
+    sources[i] = (reproc_event_source){ processes[i], REPROC_EVENT_OUT, 0 };
+
+    r = reproc_poller_add(poller, processes[i], REPROC_EVENT_OUT, &indices[i]);
+    ASSERT(r == 0);
+  }
+
+  // Let the deadlines expire.
+  r = reproc_wait(processes[1], 200);
+  ASSERT(r == REPROC_ETIMEDOUT);
+
+  // All expired deadlines are reported at once.
+  r = reproc_poll(sources, NUM_PROCESSES, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    ASSERT(sources[i].events == (i % 2 == 0 ? REPROC_EVENT_DEADLINE : 0));
+  }
+
+  reproc_poller_event events[NUM_PROCESSES];
+
+  r = reproc_poller_wait(poller, events, NUM_PROCESSES, REPROC_INFINITE);
+  ASSERT(r == NUM_PROCESSES / 2);
+
+  for (int i = 0; i < r; i++) {
+    size_t index = *(size_t *) events[i].context;
+
+    ASSERT(index % 2 == 0);
+    ASSERT(events[i].events == REPROC_EVENT_DEADLINE);
+  }
+
+  // Removed processes and processes that have been waited for aren't reported
+  // anymore.
+  r = reproc_poller_remove(poller, processes[0]);
+  ASSERT(r == 0);
+
+  r = reproc_close(processes[2], REPROC_STREAM_IN);
+  ASSERT(r == 0);
+
+  r = reproc_wait(processes[2], REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  r = reproc_poller_wait(poller, events, NUM_PROCESSES, REPROC_INFINITE);
+  ASSERT(r == NUM_PROCESSES / 2 - 1);
+
+  for (int i = 0; i < r; i++) {
+    size_t index = *(size_t *) events[i].context;
+
+    // The output of the process that exited is still there to be read.
+    ASSERT(index != 0);
+    ASSERT(events[i].events == (index == 2 ? REPROC_EVENT_OUT
+                                           : REPROC_EVENT_DEADLINE));
+  }
+
+  for (size_t i = 0; i < NUM_PROCESSES; i++) {
+    r = reproc_close(processes[i], REPROC_STREAM_IN);
+    ASSERT(r == 0);
+
+    r = reproc_wait(processes[i], REPROC_INFINITE);
+    ASSERT(r == 0);
+
+    reproc_destroy(processes[i]);
+  }
+
+  reproc_poller_destroy(poller);
+}
+
+static void invalid(void)
+{
+  int r = -1;
+
+  reproc_poller_t *poller = reproc_poller_new();
+  ASSERT(poller);
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  r = reproc_poller_add(poller, process, REPROC_EVENT_OUT, NULL);
+  ASSERT(r == REPROC_EINVAL);
+
+  r = reproc_poller_wait(poller, (reproc_poller_event[1]){ { 0 } }, 1, 0);
+  ASSERT(r == REPROC_EPIPE);
+
+  reproc_destroy(process);
+  reproc_poller_destroy(poller);
+}
+
+int main(void)
+{
+  ready();
+  exited();
+  deadlines();
+  invalid();
+}
@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#if defined(REPROC_INTERNAL)
+  #include "reaper.h"
+#endif
+
+#if defined(REPROC_MULTITHREADED)
+  #include <pthread.h>
+#endif
+
+static reproc_t *start(int status)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  char argument[16];
+  snprintf(argument, sizeof(argument), "%d", status);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/reaper", argument, NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ .deadline = 5000 });
+  ASSERT(r >= 0);
+
+  return process;
+}
+
+static void wait(void)
+{
+  int r = -1;
+
+  enum { NUM_PROCESSES = 8 };
+  reproc_t *processes[NUM_PROCESSES] = { 0 };
+
+  for (int i = 0; i < NUM_PROCESSES; i++) {
+    processes[i] = start(i);
+  }
+
+  // Wait in reverse so the reaper has to hold on to the exit statuses of the
+  // processes we're not waiting for yet.
+  for (int i = NUM_PROCESSES - 1; i >= 0; i--) {
+    r = reproc_wait(processes[i], REPROC_INFINITE);
+    ASSERT(r == i);
+
+    reproc_destroy(processes[i]);
+  }
+}
+
+static void poll(void)
+{
+  int r = -1;
+
+  reproc_t *process = start(3);
+
+  // We don't read from stdout so the pipe stays valid until we're told the
+  // child process exited.
+  while (true) {
+    reproc_event_source source = { process,
+                                   REPROC_EVENT_OUT | REPROC_EVENT_EXIT, 0 };
+
+    r = reproc_poll(&source, 1, REPROC_INFINITE);
+    ASSERT(r == 0);
+
+    if (source.events & REPROC_EVENT_EXIT) {
+      break;
+    }
+  }
+
+  r = reproc_wait(process, 0);
+  ASSERT(r == 3);
+
+  reproc_destroy(process);
+}
+
+// Polls the exit handle of `process` until the child process exits without
+// waiting for it. Same as in `poll`, we don't read from stdout so the pipe
+// stays valid.
+static void exited(reproc_t *process)
+{
+  int r = -1;
+
+  while (true) {
+    reproc_event_source source = { process,
+                                   REPROC_EVENT_OUT | REPROC_EVENT_EXIT, 0 };
+
+    r = reproc_poll(&source, 1, REPROC_INFINITE);
+    ASSERT(r == 0);
+
+    if (source.events & REPROC_EVENT_EXIT) {
+      break;
+    }
+  }
+}
+
+// `waited` and `stopped` were started before the reaper and have exited.
+static void before(reproc_t *waited, reproc_t *stopped)
+{
+  int r = -1;
+
+  // Waiting for a process started by the reaper collects exit statuses, which
+  // reaps `waited` and `stopped` as well.
+  reproc_t *process = start(0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+
+  // The reaper keeps the exit statuses for us.
+  r = reproc_wait(waited, REPROC_INFINITE);
+  ASSERT(r == 5);
+
+  reproc_destroy(waited);
+
+  // Terminating or killing a reaped process mustn't signal its pid, which
+  // might have been reused already.
+  r = reproc_stop(stopped, (reproc_stop_actions){
+                               .first = { REPROC_STOP_TERMINATE, 5000 },
+                               .second = { REPROC_STOP_KILL, 5000 } });
+  ASSERT(r == 6);
+
+  r = reproc_kill(stopped);
+  ASSERT(r == 0);
+
+  reproc_destroy(stopped);
+}
+
+#if defined(REPROC_INTERNAL)
+
+// Child processes not started by reproc are reaped as well but the reaper
+// shouldn't hold on to their exit status.
+static void foreign(void)
+{
+  int r = -1;
+
+  size_t size = reaper_size();
+
+  enum { NUM_CHILDREN = 64 };
+  pid_t children[NUM_CHILDREN];
+
+  for (int i = 0; i < NUM_CHILDREN; i++) {
+    children[i] = fork();
+    ASSERT(children[i] >= 0);
+
+    if (children[i] == 0) {
+      _exit(0);
+    }
+  }
+
+  // Waiting for a process started by the reaper collects the exit statuses of
+  // all other exited child processes as well.
+  for (int i = 0; i < NUM_CHILDREN; i++) {
+    while (kill(children[i], 0) == 0) {
+      reproc_t *process = start(0);
+
+      r = reproc_wait(process, REPROC_INFINITE);
+      ASSERT(r == 0);
+
+      reproc_destroy(process);
+    }
+
+    ASSERT(errno == ESRCH);
+  }
+
+  ASSERT(reaper_size() == size);
+}
+
+#endif
+
+static void poller(void)
+{
+  int r = -1;
+
+  reproc_poller_t *poller = reproc_poller_new();
+  ASSERT(poller);
+
+  enum { NUM_PROCESSES = 4 };
+  reproc_t *processes[NUM_PROCESSES] = { 0 };
+
+  for (int i = 0; i < NUM_PROCESSES; i++) {
+    processes[i] = start(i);
+
+    r = reproc_poller_add(poller, processes[i], REPROC_EVENT_EXIT, NULL);
+    ASSERT(r == 0);
+  }
+
+  // The poller watches the self-pipe of the reaper until every process it
+  // reported the exit of has been waited for.
+  int remaining = NUM_PROCESSES;
+
+  while (remaining > 0) {
+    reproc_poller_event events[NUM_PROCESSES];
+
+    r = reproc_poller_wait(poller, events, NUM_PROCESSES, REPROC_INFINITE);
+    ASSERT(r > 0);
+
+    int count = r;
+
+    for (int i = 0; i < count; i++) {
+      ASSERT(events[i].events == REPROC_EVENT_EXIT);
+
+      r = reproc_wait(events[i].process, 0);
+      ASSERT(r >= 0 && r < NUM_PROCESSES);
+
+      remaining--;
+    }
+  }
+
+  r = reproc_poller_wait(poller, (reproc_poller_event[1]){ { 0 } }, 1, 0);
+  ASSERT(r == REPROC_EPIPE);
+
+  for (int i = 0; i < NUM_PROCESSES; i++) {
+    reproc_destroy(processes[i]);
+  }
+
+  reproc_poller_destroy(poller);
+}
+
+#if defined(REPROC_MULTITHREADED)
+
+static void *work(void *context)
+{
+  (void) context;
+
+  for (int i = 0; i < 16; i++) {
+    wait();
+  }
+
+  return NULL;
+}
+
+static void threads(void)
+{
+  enum { NUM_THREADS = 4 };
+  pthread_t threads[NUM_THREADS];
+  int r = -1;
+
+  for (int i = 0; i < NUM_THREADS; i++) {
+    r = pthread_create(&threads[i], NULL, work, NULL);
+    ASSERT(r == 0);
+  }
+
+  for (int i = 0; i < NUM_THREADS; i++) {
+    r = pthread_join(threads[i], NULL);
+    ASSERT(r == 0);
+  }
+}
+
+#endif
+
+int main(void)
+{
+  reproc_t *waited = start(5);
+  reproc_t *stopped = start(6);
+
+  exited(waited);
+  exited(stopped);
+
+  int r = reproc_reaper_start();
+  ASSERT(r == 0);
+
+  before(waited, stopped);
+#if defined(REPROC_INTERNAL)
+  foreign();
+#endif
+  wait();
+  poll();
+  poller();
+
+#if defined(REPROC_MULTITHREADED)
+  // Threads wake each other up when they collect exit statuses of processes
+  // waited on by other threads.
+  threads();
+#endif
+
+  reproc_t *process = start(0);
+
+  // The reaper can't be stopped while it is responsible for a process.
+  r = reproc_reaper_stop();
+  ASSERT(r == -EBUSY);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+
+  r = reproc_reaper_stop();
+  ASSERT(r == 0);
+}
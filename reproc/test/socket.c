@@ -0,0 +1,125 @@
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <signal.h>
+#include <string.h>
+
+#define MESSAGE "reproc stands for REdirected PROCess"
+
+static void echo(void)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/socket", NULL };
+
+  reproc_options options = { 0 };
+  options.redirect.in.type = REPROC_REDIRECT_SOCKET;
+  options.redirect.in.pipe_size = 1 << 16;
+  options.redirect.out.type = REPROC_REDIRECT_SOCKET;
+
+  r = reproc_start(process, argv, options);
+  ASSERT(r >= 0);
+
+  r = reproc_pipe_size(process, REPROC_STREAM_IN);
+  ASSERT(r >= 1 << 16);
+
+  r = reproc_write(process, (const uint8_t *) MESSAGE, strlen(MESSAGE));
+  ASSERT(r == (int) strlen(MESSAGE));
+
+  // stdin and stdout share a socket so this only shuts down stdin.
+  r = reproc_close(process, REPROC_STREAM_IN);
+  ASSERT(r == 0);
+
+  char output[sizeof(MESSAGE)] = { 0 };
+  size_t size = 0;
+
+  while (true) {
+    r = reproc_read(process, REPROC_STREAM_OUT, (uint8_t *) output + size,
+                    sizeof(output) - 1 - size);
+    if (r == REPROC_EPIPE) {
+      break;
+    }
+
+    ASSERT(r > 0);
+    size += (size_t) r;
+  }
+
+  ASSERT(strcmp(output, MESSAGE) == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+enum { WRITE, WRITE_GIFT, WRITEV };
+
+// Writes to a child process that closed stdin. With `SIGPIPE` set to its
+// default action, the test process would be killed if the write raised it.
+static void closed(int method)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/socket", "close", NULL };
+
+  reproc_options options = { 0 };
+  options.redirect.in.type = REPROC_REDIRECT_SOCKET;
+
+  r = reproc_start(process, argv, options);
+  ASSERT(r >= 0);
+
+  uint8_t output[16] = { 0 };
+  size_t size = 0;
+
+  while (true) {
+    r = reproc_read(process, REPROC_STREAM_OUT, output + size,
+                    sizeof(output) - 1 - size);
+    if (r == REPROC_EPIPE) {
+      break;
+    }
+
+    ASSERT(r > 0);
+    size += (size_t) r;
+  }
+
+  ASSERT(strcmp((const char *) output, "closed") == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  uint8_t buffer[] = MESSAGE;
+  reproc_iovec iov = { buffer, sizeof(buffer) };
+
+  switch (method) {
+    case WRITE:
+      r = reproc_write(process, buffer, sizeof(buffer));
+      break;
+    case WRITE_GIFT:
+      r = reproc_write_gift(process, buffer, sizeof(buffer));
+      break;
+    case WRITEV:
+      r = reproc_writev(process, &iov, 1);
+      break;
+  }
+
+  ASSERT(r == REPROC_EPIPE);
+
+  reproc_destroy(process);
+}
+
+int main(void)
+{
+  signal(SIGPIPE, SIG_DFL);
+
+  echo();
+  closed(WRITE);
+  closed(WRITE_GIFT);
+  closed(WRITEV);
+}
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "assert.h"
+
+#include <reproc/drain.h>
+#include <reproc/reproc.h>
+#include <reproc/run.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+static void error(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/non-existent", NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ .spawn = spawn });
+  ASSERT(r == -ENOENT);
+
+  reproc_destroy(process);
+}
+
+static void setup(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  // Make sure `spawn` is searched for in the PATH of the child environment.
+  const char *argv[] = { "spawn", NULL };
+  const char *envp[] = { "PATH=/non-existent:" RESOURCE_DIRECTORY,
+                         "REPROC=spawn", NULL };
+
+  r = reproc_start(process, argv,
+                   (reproc_options){ .environment = envp,
+                                     .working_directory = RESOURCE_DIRECTORY,
+                                     .spawn = spawn });
+  ASSERT(r >= 0);
+
+  char *output = NULL;
+  reproc_sink sink = reproc_sink_string(&output);
+  r = reproc_drain(process, sink, sink);
+  ASSERT(r == 0);
+  ASSERT(output != NULL);
+
+  ASSERT(strcmp(output, RESOURCE_DIRECTORY "spawn") == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+  reproc_free(output);
+}
+
+static void signals(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  // Ignored signals are inherited over `exec` unless reproc resets them.
+  void (*previous)(int) = signal(SIGTERM, SIG_IGN);
+  ASSERT(previous != SIG_ERR);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/spawn", "block", NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ .spawn = spawn });
+  ASSERT(r >= 0);
+
+  previous = signal(SIGTERM, previous);
+  ASSERT(previous != SIG_ERR);
+
+  r = reproc_terminate(process);
+  ASSERT(r == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == REPROC_SIGTERM);
+
+  reproc_destroy(process);
+}
+
+static void leak(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  // `dup` does not set `FD_CLOEXEC` on the new file descriptor.
+  int fd = dup(STDERR_FILENO);
+  ASSERT(fd >= 0);
+
+  char number[16];
+  snprintf(number, sizeof(number), "%d", fd);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/spawn", "fd", number, NULL };
+
+  r = reproc_run(argv, (reproc_options){ .spawn = spawn });
+  ASSERT(r == 0);
+
+  r = close(fd);
+  ASSERT(r == 0);
+}
+
+int main(void)
+{
+  REPROC_SPAWN spawn[] = { REPROC_SPAWN_FORK, REPROC_SPAWN_VFORK };
+
+  for (size_t i = 0; i < sizeof(spawn) / sizeof(spawn[0]); i++) {
+    error(spawn[i]);
+    setup(spawn[i]);
+    signals(spawn[i]);
+    leak(spawn[i]);
+  }
+}
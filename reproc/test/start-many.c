@@ -0,0 +1,75 @@
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#define NUM_PROCESSES 5
+
+static void start_many(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  const char *argv[][3] = {
+    { RESOURCE_DIRECTORY "/start-many", "0", NULL },
+    { RESOURCE_DIRECTORY "/start-many", "1", NULL },
+    { RESOURCE_DIRECTORY "/non-existent", "2", NULL },
+    { NULL },
+    { RESOURCE_DIRECTORY "/start-many", "4", NULL },
+  };
+
+  const char *const *argvs[NUM_PROCESSES] = { 0 };
+  reproc_t *processes[NUM_PROCESSES] = { 0 };
+  int results[NUM_PROCESSES] = { 0 };
+
+  for (int i = 0; i < NUM_PROCESSES; i++) {
+    argvs[i] = argv[i];
+    processes[i] = reproc_new();
+    ASSERT(processes[i]);
+  }
+
+  reproc_options options = { .spawn = spawn,
+                             .redirect.discard = true,
+                             .deadline = 5000 };
+
+  r = reproc_start_many(processes, argvs, NUM_PROCESSES, options, results);
+  ASSERT(r == 3);
+
+  ASSERT(results[0] == 1);
+  ASSERT(results[1] == 1);
+  ASSERT(results[2] < 0);
+  ASSERT(results[3] == REPROC_EINVAL);
+  ASSERT(results[4] == 1);
+
+  for (int i = 0; i < NUM_PROCESSES; i++) {
+    if (results[i] < 0) {
+      // Processes that failed to start can't be waited on.
+      r = reproc_wait(processes[i], REPROC_INFINITE);
+      ASSERT(r == REPROC_EINVAL);
+    } else {
+      r = reproc_wait(processes[i], REPROC_INFINITE);
+      ASSERT(r == i);
+    }
+
+    reproc_destroy(processes[i]);
+  }
+}
+
+int main(void)
+{
+  start_many(REPROC_SPAWN_FORK);
+  start_many(REPROC_SPAWN_VFORK);
+  start_many(REPROC_SPAWN_HELPER);
+
+  int r = -1;
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  reproc_t *processes[] = { process };
+  const char *const *argvs[] = { NULL };
+  int results[] = { 0 };
+
+  // Invalid options are reported for the whole batch.
+  r = reproc_start_many(processes, argvs, 1, (reproc_options){ 0 }, results);
+  ASSERT(r == REPROC_EINVAL);
+
+  reproc_destroy(process);
+}
@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Counts the system calls made by `reproc_start` in the parent process to catch
+// regressions in the amount of system calls it takes to start a child process.
+// The system calls made by the child process itself are not counted.
+
+// Start with the default options:
+//
+// - `pipe2` x 2 (stdin, stdout)
+// - `close` x 2 (child endpoints of the pipes)
+// - `pidfd_open` (+ `pidfd_open` and `close` the first time to check whether
+//   it's supported)
+//
+// `REPROC_SPAWN_VFORK`:
+//
+// - `mmap` + `munmap` (child stack)
+// - `rt_sigprocmask` x 2
+// - `clone`
+//
+// `REPROC_SPAWN_FORK`:
+//
+// - `pipe2` + `close` x 2 + `read` (error pipe)
+// - `rt_sigprocmask` x 2
+// - `clone`
+//
+// We allow a few extra system calls for memory allocations.
+static const int MAX_SYSCALLS_VFORK = 11 + 3;
+static const int MAX_SYSCALLS_FORK = 13 + 3;
+
+// `PTRACE_GET_SYSCALL_INFO` was added in Linux 5.3. Older headers don't define
+// it and glibc spells the struct differently than linux/ptrace.h so we declare
+// the part of `struct ptrace_syscall_info` that we need ourselves.
+#if !defined(PTRACE_GET_SYSCALL_INFO)
+  #define PTRACE_GET_SYSCALL_INFO 0x420e
+  #define PTRACE_SYSCALL_INFO_ENTRY 1
+#endif
+
+struct syscall_info {
+  uint8_t op;
+  uint8_t pad[3];
+  uint32_t arch;
+  uint64_t instruction_pointer;
+  uint64_t stack_pointer;
+  struct {
+    uint64_t nr;
+    uint64_t args[6];
+  } entry;
+};
+
+// We use `getppid` to mark the start and the end of the system calls we want to
+// count.
+static void traced(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/syscalls", NULL };
+
+  getppid();
+  r = reproc_start(process, argv, (reproc_options){ .spawn = spawn });
+  getppid();
+
+  ASSERT(r >= 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}
+
+// Returns the amount of system calls made by `reproc_start` or -1 if we're not
+// allowed to trace child processes or the kernel is too old to tell us which
+// system calls they make.
+static int count(REPROC_SPAWN spawn)
+{
+  int r = -1;
+
+  pid_t tracee = fork();
+  ASSERT(tracee >= 0);
+
+  if (tracee == 0) {
+    r = (int) ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+    if (r < 0) {
+      _exit(EXIT_FAILURE);
+    }
+
+    raise(SIGSTOP);
+    traced(spawn);
+
+    // Don't run any exit handlers (e.g. LeakSanitizer) while being traced.
+    _exit(EXIT_SUCCESS);
+  }
+
+  int status = 0;
+  r = waitpid(tracee, &status, 0);
+  ASSERT(r == tracee);
+
+  if (!WIFSTOPPED(status)) {
+    return -1;
+  }
+
+  r = (int) ptrace(PTRACE_SETOPTIONS, tracee, NULL,
+                   PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL);
+  ASSERT(r == 0);
+
+  int markers = 0;
+  int syscalls = 0;
+  int signal = 0;
+
+  while (true) {
+    r = (int) ptrace(PTRACE_SYSCALL, tracee, NULL, signal);
+    ASSERT(r == 0);
+
+    signal = 0;
+
+    r = waitpid(tracee, &status, 0);
+    ASSERT(r == tracee);
+
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+      break;
+    }
+
+    if (WSTOPSIG(status) != (SIGTRAP | 0x80)) {
+      // Forward any other signals to the tracee.
+      signal = WSTOPSIG(status);
+      continue;
+    }
+
+    struct syscall_info info;
+
+    r = (int) ptrace(PTRACE_GET_SYSCALL_INFO, tracee, sizeof(info), &info);
+    if (r < 0 && (errno == EIO || errno == EINVAL)) {
+      kill(tracee, SIGKILL);
+      waitpid(tracee, &status, 0);
+      return -1;
+    }
+
+    ASSERT(r > 0);
+
+    if (info.op != PTRACE_SYSCALL_INFO_ENTRY) {
+      continue;
+    }
+
+    if (info.entry.nr == SYS_getppid) {
+      markers++;
+    } else if (markers == 1) {
+      syscalls++;
+    }
+  }
+
+  r = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  ASSERT(r == EXIT_SUCCESS);
+  ASSERT(markers == 2);
+
+  return syscalls;
+}
+
+int main(void)
+{
+  int r = -1;
+
+  r = count(REPROC_SPAWN_VFORK);
+  if (r < 0) {
+    // Tracing is not permitted or not supported.
+    return 0;
+  }
+
+  ASSERT(r <= MAX_SYSCALLS_VFORK);
+
+  r = count(REPROC_SPAWN_FORK);
+  ASSERT(r >= 0);
+  ASSERT(r <= MAX_SYSCALLS_FORK);
+}
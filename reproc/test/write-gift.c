@@ -0,0 +1,55 @@
+#define _DEFAULT_SOURCE
+
+#include "assert.h"
+
+#include <reproc/reproc.h>
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define SIZE "8388608"
+
+int main(void)
+{
+  int r = -1;
+
+  size_t size = (size_t) atol(SIZE);
+
+  uint8_t *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT(buffer != MAP_FAILED);
+
+  for (size_t i = 0; i < size; i++) {
+    buffer[i] = (uint8_t) (i % 251);
+  }
+
+  reproc_t *process = reproc_new();
+  ASSERT(process);
+
+  const char *argv[] = { RESOURCE_DIRECTORY "/write-gift", SIZE, NULL };
+
+  r = reproc_start(process, argv, (reproc_options){ 0 });
+  ASSERT(r >= 0);
+
+  size_t written = 0;
+
+  while (written < size) {
+    r = reproc_write_gift(process, buffer + written, size - written);
+    ASSERT(r > 0);
+
+    written += (size_t) r;
+  }
+
+  // The pipe holds its own references to the pages that haven't been read yet
+  // so we can unmap the buffer before the child process has read all of it.
+  r = munmap(buffer, size);
+  ASSERT(r == 0);
+
+  r = reproc_close(process, REPROC_STREAM_IN);
+  ASSERT(r == 0);
+
+  r = reproc_wait(process, REPROC_INFINITE);
+  ASSERT(r == 0);
+
+  reproc_destroy(process);
+}